@@ -5,25 +5,30 @@ SRC_FILE="clicker.c"
 LINUX_OUT="foxholetool"
 WIN_OUT="foxholetool.exe"
 WIN_OUT_CONSOLE="foxholetool_console.exe"
+BENCH_OUT="bench_output.txt"
 
-LINUX_CFLAGS="${CFLAGS:- -O2}"
-LINUX_LDFLAGS="${LDFLAGS:-} -lX11 -lXtst -lpthread"
+#Xft.h includes FreeType's headers, which live in a directory of their own
+XFT_CFLAGS="$(pkg-config --cflags xft 2>/dev/null || echo -I/usr/include/freetype2)"
+LINUX_CFLAGS="${CFLAGS:- -O2} ${XFT_CFLAGS}"
+LINUX_LDFLAGS="${LDFLAGS:-} -lX11 -lX11-xcb -lxcb -lxcb-xtest -lXtst -lXrender -lXft -lfreetype -lXext -lpthread"
 
 WIN_CFLAGS="${WIN_CFLAGS:- -O2 -mwindows}"
-WIN_LDFLAGS="${WIN_LDFLAGS:-} -luser32 -lgdi32"
+WIN_LDFLAGS="${WIN_LDFLAGS:-} -luser32 -lgdi32 -ld3d11"
 
 CC_LINUX="${CC_LINUX:-${CC:-gcc}}"
 CC_WIN="${CC_WIN:-x86_64-w64-mingw32-gcc}"
 
 usage() {
   cat <<EOF
-Usage: $0 [linux|windows|windows-console|all|clean]
+Usage: $0 [linux|windows|windows-console|all|bench [mock]|clean]
 
 Targets:
   linux           - build native Linux binary (${LINUX_OUT})
   windows         - build Windows GUI .exe via MinGW (${WIN_OUT})
   windows-console - build Windows CONSOLE .exe via MinGW (${WIN_OUT_CONSOLE})
   all             - build Linux + Windows GUI (default)
+  bench [mock]    - build Linux binary and run its benchmarks (output also in ${BENCH_OUT});
+                    'mock' runs only the headless ones (no X display needed)
   clean           - remove built binaries
 
 Env vars:
@@ -59,6 +64,12 @@ build_windows_console() {
   "${CC_WIN}" -O2 "${SRC_FILE}" -o "${WIN_OUT_CONSOLE}" ${WIN_LDFLAGS}
 }
 
+run_bench() {
+  build_linux
+  echo "==> Running benchmarks ${1:-}"
+  "./${LINUX_OUT}" --bench ${1:-} | tee "${BENCH_OUT}"
+}
+
 clean_build() {
   rm -f "${LINUX_OUT}" "${WIN_OUT}" "${WIN_OUT_CONSOLE}"
   echo "Cleaned: ${LINUX_OUT} ${WIN_OUT} ${WIN_OUT_CONSOLE}"
@@ -80,6 +91,9 @@ case "${TARGET}" in
     build_linux
     build_windows || echo "Windows build failed (Linux build succeeded)."
     ;;
+  bench)
+    run_bench "${2:-}"
+    ;;
   clean)
     clean_build
     ;;
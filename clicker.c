@@ -7,16 +7,24 @@
     F4  -> hold S
     F6  -> hold right mouse button
     F7  -> hold left mouse button
+    F5  -> record input / stop and save the recording
+    F8  -> replay the recording
     F9  -> suspend/resume all actions
     F10 -> exit
+    F1  -> print latency statistics (also SIGUSR1 on Linux)
+
+  Every input-driving action is a macro compiled from the config (see the
+  macro engine section); the ones above are built in.
 */
 
 #ifndef _WIN32
   #define _POSIX_C_SOURCE 200809L
   #define _XOPEN_SOURCE   700
+  #define _GNU_SOURCE     //cpu_set_t, pthread_setaffinity_np
 #endif
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdatomic.h>
@@ -31,32 +39,171 @@
   #ifndef PROCESS_QUERY_LIMITED_INFORMATION
     #define PROCESS_QUERY_LIMITED_INFORMATION 0x1000
   #endif
+  //desktop duplication for the screen watch; initguid.h defines the IIDs here
+  #define COBJMACROS
+  #include <initguid.h>
+  #include <d3d11.h>
+  #include <dxgi1_2.h>
 #else
   #include <unistd.h>     //usleep, readlink
   #include <strings.h>    //strcasecmp
   #include <pthread.h>
-  #include <sys/select.h>
+  #include <sched.h>
+  #include <signal.h>
+  #include <sys/resource.h> //setpriority
+  #include <sys/syscall.h>  //SYS_gettid
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <sys/ioctl.h>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+  #include <linux/uinput.h>
+  #include <sys/inotify.h>
+  #include <poll.h>
+  #include <sys/eventfd.h>
+  #include <sys/timerfd.h>
   #include <X11/Xlib.h>
+  #include <X11/Xlib-xcb.h>
+  #include <xcb/xcb.h>
+  #include <xcb/xtest.h>
   #include <X11/Xutil.h>
   #include <X11/keysym.h>
   #include <X11/Xatom.h>
+  #include <X11/Xproto.h>
   #include <X11/extensions/XTest.h>
+  #include <X11/extensions/record.h>
+  #include <X11/extensions/Xrender.h>
+  #include <X11/Xft/Xft.h>
+  #include <X11/extensions/XShm.h>
+  #include <sys/ipc.h>
+  #include <sys/shm.h>
+#endif
+
+//compare kernels of the screen watch: SSE2 is part of x86-64, AVX2 is
+//compiled per function and picked at run time, NEON is part of AArch64
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+  #include <emmintrin.h>
+  #define WATCH_HAVE_SSE2 1
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #include <immintrin.h>
+  #define WATCH_HAVE_AVX2 1
+#endif
+#if defined(__aarch64__)
+  #include <arm_neon.h>
+  #define WATCH_HAVE_NEON 1
 #endif
 
 //shared global state
 static atomic_int g_running = 1;
-static atomic_int g_suspended = 0;
-
-static atomic_int g_spam_left = 0;
-static atomic_int g_hold_w = 0;
-static atomic_int g_hold_s = 0;
-static atomic_int g_hold_lmb = 0;
-static atomic_int g_hold_rmb = 0;
 static atomic_int g_overlay_hidden = 0;   //0 = overlay visible, 1 = hidden
 
-//saved point for "spam click at location"
-static atomic_int g_saved_x = 0;
-static atomic_int g_saved_y = 0;
+//---- packed action state ----
+//all action flags live in one atomic word together with a generation that
+//is bumped on every change visible in the HUD (actions, config). readers
+//take a single load and always see a consistent combination; the word gets
+//its own cache line so hotkey/worker traffic does not share it.
+
+enum {
+  ST_SPAM      = 1u << 0,
+  ST_HOLD_W    = 1u << 1,
+  ST_HOLD_S    = 1u << 2,
+  ST_HOLD_RMB  = 1u << 3,
+  ST_HOLD_LMB  = 1u << 4,
+  ST_SUSPENDED = 1u << 5,
+  ST_RECORDING = 1u << 6,
+  ST_REPLAY    = 1u << 7,
+  ST_MACROS    = 0xFFu << 8,   //user macros, ST_MACRO(i)
+  ST_UNFOCUSED = 1u << 16,     //PauseUnfocused and the game is not focused
+  ST_PAUSED    = ST_SUSPENDED | ST_UNFOCUSED,
+  ST_ACTIONS   = ST_SPAM | ST_HOLD_W | ST_HOLD_S | ST_HOLD_RMB | ST_HOLD_LMB |
+                 ST_REPLAY | ST_MACROS
+};
+
+#define ST_MACRO(i) (1u << (8 + (i)))
+
+#define ST_GEN_ONE (1ull << 32)   //low 32 bits: ST_* flags, high 32 bits: generation
+
+static struct {
+  _Alignas(64) _Atomic uint64_t word;
+} g_state = { ST_GEN_ONE };
+
+static uint64_t state_load(void) {
+  return atomic_load_explicit(&g_state.word, memory_order_acquire);
+}
+
+static uint32_t st_flags(uint64_t st) { return (uint32_t)st; }
+static uint32_t st_gen(uint64_t st)   { return (uint32_t)(st >> 32); }
+
+//set flags to (flags & ~clear) ^ flip and bump the generation; returns the new word
+static uint64_t state_update(uint32_t clear, uint32_t flip) {
+  uint64_t old = atomic_load_explicit(&g_state.word, memory_order_relaxed);
+  uint64_t nw;
+  do {
+    uint32_t f = (st_flags(old) & ~clear) ^ flip;
+    nw = ((old & ~0xFFFFFFFFull) + ST_GEN_ONE) | f;
+  } while (!atomic_compare_exchange_weak_explicit(&g_state.word, &old, nw,
+                                                  memory_order_acq_rel,
+                                                  memory_order_relaxed));
+  return nw;
+}
+
+//something shown in the HUD changed without touching the action flags
+static void state_changed(void) {
+  state_update(0, 0);
+}
+
+//---- hotkey -> worker command queue ----
+//payloads (click point, interval) travel through a bounded lock-free
+//single-producer/single-consumer ring. the producer is the thread that
+//handles hotkeys; a command is pushed before the state word change that
+//depends on it, so a worker that sees the new state also sees the payload.
+
+enum {
+  CMD_SET_CLICK_POS = 0,   //action, x, y
+  CMD_SET_INTERVAL,        //action, ns
+  CMD_SET_LATE,            //action, x = LATE_*
+  CMD_REPLAY_LOAD,         //data, len: mapped recording, the worker unmaps it
+  CMD_MACRO_SET,           //data: a new macro_set, the worker frees it
+  CMD_TARGETS_SET          //data: a new target_set (multibox), the worker frees it
+};
+
+typedef struct {
+  int type;
+  int action;
+  int x, y;
+  uint64_t ns;
+  const void *data;
+  size_t len;
+} worker_cmd;
+
+#define CMD_RING_SIZE 64u   //power of two
+
+static struct {
+  _Alignas(64) atomic_uint head;   //next slot to write, owned by the producer
+  _Alignas(64) atomic_uint tail;   //next slot to read, owned by the worker
+  worker_cmd slots[CMD_RING_SIZE];
+} g_cmd_ring;
+
+//returns 0 when the ring is full
+static int cmd_push(const worker_cmd *c) {
+  unsigned int head = atomic_load_explicit(&g_cmd_ring.head, memory_order_relaxed);
+  unsigned int tail = atomic_load_explicit(&g_cmd_ring.tail, memory_order_acquire);
+  if (head - tail == CMD_RING_SIZE) return 0;
+  g_cmd_ring.slots[head & (CMD_RING_SIZE - 1)] = *c;
+  atomic_store_explicit(&g_cmd_ring.head, head + 1, memory_order_release);
+  return 1;
+}
+
+static int cmd_pop(worker_cmd *c) {
+  unsigned int tail = atomic_load_explicit(&g_cmd_ring.tail, memory_order_relaxed);
+  unsigned int head = atomic_load_explicit(&g_cmd_ring.head, memory_order_acquire);
+  if (head == tail) return 0;
+  *c = g_cmd_ring.slots[tail & (CMD_RING_SIZE - 1)];
+  atomic_store_explicit(&g_cmd_ring.tail, tail + 1, memory_order_release);
+  return 1;
+}
 
 //--------------- hotkey logical mapping ---------------
 
@@ -68,1185 +215,7424 @@ enum {
   ACTION_HOLD_LMB,
   ACTION_SUSPEND,
   ACTION_EXIT,
+  ACTION_RECORD,
+  ACTION_REPLAY,
+  ACTION_STATS,
   ACTION_COUNT
 };
 
-static const char* g_action_names[ACTION_COUNT] = {
+//user macros follow the built-in actions; "Macro <name>" in the config
+#define MACRO_USER_MAX   8
+#define MACRO_NAME_MAX   32
+#define ACTION_MACRO_FIRST ACTION_COUNT
+#define ACTION_MAX       (ACTION_COUNT + MACRO_USER_MAX)
+#define CONFIG_MACRO_PREFIX "Macro "
+#define CONFIG_MACRO_SUFFIX " seq"
+#define MACRO_SRC_MAX    512
+
+
+static const char* g_action_names[ACTION_MAX] = {
   "Spam LMB",
   "Hold W",
   "Hold S",
   "Hold RMB",
   "Hold LMB",
   "Suspend",
-  "Exit"
+  "Exit",
+  "Record",
+  "Replay",
+  "Stats"
 };
 
 #define CONFIG_FILE "foxtool_hotkeys.cfg"
 
-//action keys -> platform codes (VK_* / XK_*)
-static int g_action_keys[ACTION_COUNT] = {0};
+//repeat interval per action in microseconds (0 = action does not repeat)
+//written as "<action> interval_us=<n>" in the config file
+#define CONFIG_INTERVAL_SUFFIX " interval_us"
+#define SPAM_DEFAULT_INTERVAL_US 30000u
+#define SPAM_MIN_INTERVAL_US     1000u
+
+//"<action> cps=<n>" sets the rate in repetitions per second instead, down to
+//sub-millisecond intervals (burst mode); how far the injector keeps up shows
+//in the HUD and the stats. "<action> late=coalesce|catchup" picks what a late
+//repetition does: run once for all the missed ones, or run the missed ones
+//back to back (at most RATE_CATCHUP_MAX_NS worth, the rest is dropped)
+#define CONFIG_CPS_SUFFIX   " cps"
+#define CONFIG_LATE_SUFFIX  " late"
+#define SPAM_MAX_CPS        20000u
+enum { LATE_COALESCE, LATE_CATCHUP };
+static const char *const g_late_names[] = { "coalesce", "catchup" };
+
+//"Injector=uinput" injects through a virtual kernel device (Linux) instead
+//of the display server; "Injector=native" (default) uses XTest / SendInput
+#define CONFIG_INJECTOR "Injector"
+
+//"PauseUnfocused=yes" pauses all actions while the game window does not
+//have the focus, like Suspend does, and resumes them when it gets it back
+#define CONFIG_PAUSE_UNFOCUSED "PauseUnfocused"
+
+//"Multibox=yes" drives every game window found at once, each through
+//messages / events sent to the window itself instead of global input
+#define CONFIG_MULTIBOX "Multibox"
+
+//"Watch <name>=<x> <y> <w> <h> [!]#rrggbb[~<tol>] [<n>%] <action>" runs
+//<action> when the screen region starts (or with '!' stops) matching the
+//color; "Watch interval_us=<n>" sets how often the regions are captured
+#define CONFIG_WATCH_PREFIX "Watch "
+#define WATCH_MAX        8
+#define WATCH_SRC_MAX    128
+#define WATCH_DIM_MAX    256
+#define WATCH_DEFAULT_INTERVAL_US 50000u
+#define WATCH_MIN_INTERVAL_US     5000u
+
+//"Worker <option>=<value>" opts the worker thread into a higher scheduling
+//class; the default leaves it a normal thread
+#define CONFIG_WORKER_PREFIX "Worker "
+enum { WORKER_PRIO_NORMAL, WORKER_PRIO_HIGH, WORKER_PRIO_REALTIME };
+static const char *const g_worker_prio_names[] = { "normal", "high", "realtime" };
+
+typedef struct {
+  int priority;                 //WORKER_PRIO_*
+  int rt_rr;                    //Linux realtime: SCHED_RR instead of SCHED_FIFO
+  int rt_priority;              //Linux realtime: 1..99
+  int nice;                     //Linux high: -20..19
+  unsigned long long affinity;  //CPU mask, 0 = any CPU
+} worker_sched_cfg;
+
+//---- configuration snapshot ----
+//everything the config file sets. a snapshot is filled in once and then
+//only read: a reload parses the file into a fresh one on the watcher thread
+//and the main thread switches g_cfg over to it (see config_apply_pending)
+
+typedef struct {
+  int keys[ACTION_MAX];                //platform codes (VK_* / XK_*), 0 = unbound
+  int mods[ACTION_MAX];                //HK_MOD_* held with the key
+  unsigned int interval_us[ACTION_MAX];
+  unsigned int cps[ACTION_MAX];        //<action> cps, 0 = use interval_us
+  int late[ACTION_MAX];                //LATE_*
+  int macro_count;
+  char macro_names[MACRO_USER_MAX][MACRO_NAME_MAX];
+  char macro_src[MACRO_USER_MAX][MACRO_SRC_MAX];
+  int uinput;                          //Injector=uinput
+  int pause_unfocused;                 //PauseUnfocused=yes
+  int multibox;                        //Multibox=yes
+  worker_sched_cfg worker;             //Worker <option>
+  int watch_count;
+  char watch_names[WATCH_MAX][MACRO_NAME_MAX];
+  char watch_src[WATCH_MAX][WATCH_SRC_MAX];
+  unsigned int watch_interval_us;      //Watch interval_us
+} config_snap;
+
+static config_snap *g_cfg = NULL;   //current config, main thread
+
+static const worker_sched_cfg g_worker_sched_default = { WORKER_PRIO_NORMAL, 0, 10, -10, 0 };
+
+//worker scheduling, copied from the config before the worker starts
+static worker_sched_cfg g_worker_sched;
 
 //--------------- helper functions ------------------
-static void msleep(int ms) {
 #ifdef _WIN32
-  Sleep((DWORD)ms);
-#else
-  if (ms <= 0) return;
-  struct timespec ts;
-  ts.tv_sec  = ms / 1000;
-  ts.tv_nsec = (long)(ms % 1000) * 1000000L;
-  nanosleep(&ts, NULL);
+static uint64_t g_qpc_freq = 0;   //QueryPerformanceFrequency, set by time_init()
+#endif
+
+static void time_init(void) {
+#ifdef _WIN32
+  LARGE_INTEGER f;
+  QueryPerformanceFrequency(&f);
+  g_qpc_freq = (uint64_t)f.QuadPart;
 #endif
 }
 
-//monotonic-ish time for periodic loops
-static uint64_t now_ms(void) {
+//monotonic time in nanoseconds, used for all scheduling deadlines
+static uint64_t now_ns(void) {
 #ifdef _WIN32
-  return (uint64_t)GetTickCount64();
+  LARGE_INTEGER c;
+  QueryPerformanceCounter(&c);
+  uint64_t q = (uint64_t)c.QuadPart;
+  return (q / g_qpc_freq) * 1000000000ull + (q % g_qpc_freq) * 1000000000ull / g_qpc_freq;
 #else
   struct timespec ts;
   clock_gettime(CLOCK_MONOTONIC, &ts);
-  return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
 #endif
 }
 
-//--------------- small helpers ------------------
-//case-insensitive substring search
-static int strcasestr_simple(const char *haystack, const char *needle) {
-  if (!haystack || !needle || !*needle) return 0;
-  for (const char *p = haystack; *p; ++p) {
-    const char *h = p;
-    const char *n = needle;
-    while (*h && *n && tolower((unsigned char)*h) == tolower((unsigned char)*n)) {
-      ++h;
-      ++n;
-    }
-    if (!*n) return 1;
+//--------------- worker wakeup ------------------
+//the worker blocks here until a hotkey changes state or its next deadline
+//is reached, so an idle tool does not wake up at all.
+//deadlines are absolute now_ns() values, so sleeping never accumulates drift.
+
+#define WAIT_FOREVER 0ull
+
+#ifdef _WIN32
+  #ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+    #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+  #endif
+static HANDLE g_worker_event = NULL;   //auto-reset, set on every state change
+static HANDLE g_worker_timer = NULL;   //waitable timer for the next deadline
+#else
+static pthread_mutex_t g_worker_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_worker_cond;
+static int g_worker_pending = 0;       //guarded by g_worker_mtx
+#endif
+
+static int worker_wake_init(void) {
+#ifdef _WIN32
+  g_worker_event = CreateEventA(NULL, FALSE, FALSE, NULL);
+  if (!g_worker_event) return 0;
+
+  //high resolution timer (Win10 1803+) avoids the ~15.6 ms tick; plain timer otherwise
+  g_worker_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                          TIMER_ALL_ACCESS);
+  if (!g_worker_timer) {
+    g_worker_timer = CreateWaitableTimerW(NULL, FALSE, NULL);
   }
-  return 0;
+  return g_worker_timer != NULL;
+#else
+  //the condvar uses CLOCK_MONOTONIC so deadlines match now_ns()
+  pthread_condattr_t attr;
+  if (pthread_condattr_init(&attr) != 0) return 0;
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  int ok = (pthread_cond_init(&g_worker_cond, &attr) == 0);
+  pthread_condattr_destroy(&attr);
+  return ok;
+#endif
 }
 
-//overlay size in pixels
-#define OVERLAY_WIDTH_FULL    800u
-#define OVERLAY_WIDTH_COMPACT 260u
-#define OVERLAY_HEIGHT        32u
-
-//convert string to uppercase A‑Z
-static void strtoupper_simple(char *s) {
-  if (!s) return;
-  for (; *s; ++s) {
-    if (*s >= 'a' && *s <= 'z') {
-      *s = (char)(*s - 'a' + 'A');
-    }
+static void worker_wake_destroy(void) {
+#ifdef _WIN32
+  if (g_worker_timer) {
+    CloseHandle(g_worker_timer);
+    g_worker_timer = NULL;
+  }
+  if (g_worker_event) {
+    CloseHandle(g_worker_event);
+    g_worker_event = NULL;
   }
+#else
+  pthread_cond_destroy(&g_worker_cond);
+#endif
 }
 
-//---- map key code <-> readable name (e.g. VK_F2 -> "F2") ----
+//signal the worker that shared state changed
+static void worker_wake(void) {
+#ifdef _WIN32
+  if (g_worker_event) SetEvent(g_worker_event);
+#else
+  pthread_mutex_lock(&g_worker_mtx);
+  g_worker_pending = 1;
+  pthread_cond_signal(&g_worker_cond);
+  pthread_mutex_unlock(&g_worker_mtx);
+#endif
+}
 
+//block until worker_wake() or until now_ns() >= deadline (WAIT_FOREVER = no deadline)
+static void worker_wait(uint64_t deadline) {
 #ifdef _WIN32
-static const char* key_name_from_code(int vk) {
-  switch (vk) {
-    case VK_F2:  return "F2";
-    case VK_F3:  return "F3";
-    case VK_F4:  return "F4";
-    case VK_F6:  return "F6";
-    case VK_F7:  return "F7";
-    case VK_F8:  return "F8";
-    case VK_F9:  return "F9";
-    case VK_F10: return "F10";
-    case VK_F11: return "F11";
-    default:     return "?";
+  if (deadline == WAIT_FOREVER) {
+    WaitForSingleObject(g_worker_event, INFINITE);
+    return;
   }
+
+  uint64_t t = now_ns();
+  if (deadline <= t) return;
+
+  //due time is relative (negative, 100 ns units), but it is recomputed from
+  //the absolute QPC deadline on every call, so errors do not add up
+  LARGE_INTEGER due;
+  due.QuadPart = -(LONGLONG)((deadline - t) / 100ull);
+  if (due.QuadPart == 0) due.QuadPart = -1;
+  if (!SetWaitableTimer(g_worker_timer, &due, 0, NULL, NULL, FALSE)) {
+    WaitForSingleObject(g_worker_event, (DWORD)((deadline - t) / 1000000ull));
+    return;
+  }
+
+  HANDLE handles[2] = { g_worker_event, g_worker_timer };
+  WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+  CancelWaitableTimer(g_worker_timer);
+#else
+  //the absolute CLOCK_MONOTONIC deadline goes straight to the kernel as an
+  //absolute futex timeout (the same hrtimer path as clock_nanosleep TIMER_ABSTIME)
+  struct timespec ts;
+  if (deadline != WAIT_FOREVER) {
+    ts.tv_sec  = (time_t)(deadline / 1000000000ull);
+    ts.tv_nsec = (long)(deadline % 1000000000ull);
+  }
+
+  pthread_mutex_lock(&g_worker_mtx);
+  while (!g_worker_pending) {
+    int rc = (deadline == WAIT_FOREVER)
+                 ? pthread_cond_wait(&g_worker_cond, &g_worker_mtx)
+                 : pthread_cond_timedwait(&g_worker_cond, &g_worker_mtx, &ts);
+    if (rc == ETIMEDOUT) break;
+  }
+  g_worker_pending = 0;
+  pthread_mutex_unlock(&g_worker_mtx);
+#endif
 }
 
-static int key_code_from_name(const char *name) {
-  if (!name || !*name) return 0;
-  char buf[16];
-  snprintf(buf, sizeof(buf), "%s", name);
-  buf[sizeof(buf)-1] = '\0';
-  strtoupper_simple(buf);
+//---- worker -> UI notification ----
+//the worker changes the state word itself when a macro runs to its end;
+//this wakes the hotkey/UI thread so the HUD follows without polling.
+//the main loop blocks until there is input, a notification or its own
+//deadline (ui_timer_set); with no deadline it sleeps until an event.
 
-  if (strcmp(buf, "F2")  == 0) return VK_F2;
-  if (strcmp(buf, "F3")  == 0) return VK_F3;
-  if (strcmp(buf, "F4")  == 0) return VK_F4;
-  if (strcmp(buf, "F6")  == 0) return VK_F6;
-  if (strcmp(buf, "F7")  == 0) return VK_F7;
-  if (strcmp(buf, "F8")  == 0) return VK_F8;
-  if (strcmp(buf, "F9")  == 0) return VK_F9;
-  if (strcmp(buf, "F10") == 0) return VK_F10;
-  if (strcmp(buf, "F11") == 0) return VK_F11;
-  return 0;
+#ifdef _WIN32
+#define WM_APP_STATE (WM_APP + 1)
+static DWORD g_main_thread_id = 0;
+static HANDLE g_ui_timer = NULL;   //waitable timer, armed only while there is a deadline
+
+static int ui_notify_init(void) {
+  g_main_thread_id = GetCurrentThreadId();
+  g_ui_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                      TIMER_ALL_ACCESS);
+  if (!g_ui_timer) g_ui_timer = CreateWaitableTimerW(NULL, FALSE, NULL);
+  return g_ui_timer != NULL;
+}
+
+static void ui_notify(void) {
+  PostThreadMessage(g_main_thread_id, WM_APP_STATE, 0, 0);
 }
 #else
-static const char* key_name_from_code(int ks) {
-  switch (ks) {
-    case XK_F2:  return "F2";
-    case XK_F3:  return "F3";
-    case XK_F4:  return "F4";
-    case XK_F6:  return "F6";
-    case XK_F7:  return "F7";
-    case XK_F8:  return "F8";
-    case XK_F9:  return "F9";
-    case XK_F10: return "F10";
-    case XK_F11: return "F11";
-    default:     return "?";
-  }
+static int g_ui_fd = -1;         //eventfd: other threads and signal handlers wake the main loop
+static int g_ui_timer_fd = -1;   //timerfd, armed only while there is a deadline
+
+static int ui_notify_init(void) {
+  g_ui_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  g_ui_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  return g_ui_fd >= 0 && g_ui_timer_fd >= 0;
 }
 
-static int key_code_from_name(const char *name) {
-  if (!name || !*name) return 0;
-  char buf[16];
-  snprintf(buf, sizeof(buf), "%s", name);
-  buf[sizeof(buf)-1] = '\0';
-  strtoupper_simple(buf);
+static void ui_notify(void) {
+  uint64_t one = 1;
+  //only fails when the counter is about to overflow, i.e. a wakeup is pending
+  if (write(g_ui_fd, &one, sizeof(one)) < 0) { }
+}
 
-  if (strcmp(buf, "F2")  == 0) return XK_F2;
-  if (strcmp(buf, "F3")  == 0) return XK_F3;
-  if (strcmp(buf, "F4")  == 0) return XK_F4;
-  if (strcmp(buf, "F6")  == 0) return XK_F6;
-  if (strcmp(buf, "F7")  == 0) return XK_F7;
-  if (strcmp(buf, "F8")  == 0) return XK_F8;
-  if (strcmp(buf, "F9")  == 0) return XK_F9;
-  if (strcmp(buf, "F10") == 0) return XK_F10;
-  if (strcmp(buf, "F11") == 0) return XK_F11;
-  return 0;
+//SIGUSR1 asks for a stats dump; the handler only sets this and wakes the loop
+static volatile sig_atomic_t g_stats_requested = 0;
+
+static void stats_signal_handler(int sig) {
+  (void)sig;
+  int saved = errno;
+  g_stats_requested = 1;
+  ui_notify();
+  errno = saved;
+}
+
+static void ui_notify_drain(void) {
+  uint64_t n;
+  if (read(g_ui_fd, &n, sizeof(n)) < 0) { }
 }
 #endif
 
-//----set default hotkey mapping----
+static uint64_t g_ui_deadline = WAIT_FOREVER;   //main thread
 
-static void init_default_hotkeys(void) {
+//wake the main loop at deadline (a now_ns() value); WAIT_FOREVER disarms. main thread only
+static void ui_timer_set(uint64_t deadline) {
+  g_ui_deadline = deadline;
 #ifdef _WIN32
-  g_action_keys[ACTION_SPAM_LMB] = VK_F2;
-  g_action_keys[ACTION_HOLD_W]   = VK_F3;
-  g_action_keys[ACTION_HOLD_S]   = VK_F4;
-  g_action_keys[ACTION_HOLD_RMB] = VK_F6;
-  g_action_keys[ACTION_HOLD_LMB] = VK_F7;
-  g_action_keys[ACTION_SUSPEND]  = VK_F9;
-  g_action_keys[ACTION_EXIT]     = VK_F10;
+  if (deadline == WAIT_FOREVER) {
+    CancelWaitableTimer(g_ui_timer);
+    return;
+  }
+  uint64_t t = now_ns();
+  LARGE_INTEGER due;
+  due.QuadPart = -(LONGLONG)((deadline > t ? deadline - t : 0) / 100ull);
+  if (due.QuadPart == 0) due.QuadPart = -1;
+  SetWaitableTimer(g_ui_timer, &due, 0, NULL, NULL, FALSE);
 #else
-  g_action_keys[ACTION_SPAM_LMB] = XK_F2;
-  g_action_keys[ACTION_HOLD_W]   = XK_F3;
-  g_action_keys[ACTION_HOLD_S]   = XK_F4;
-  g_action_keys[ACTION_HOLD_RMB] = XK_F6;
-  g_action_keys[ACTION_HOLD_LMB] = XK_F7;
-  g_action_keys[ACTION_SUSPEND]  = XK_F9;
-  g_action_keys[ACTION_EXIT]     = XK_F10;
+  //CLOCK_MONOTONIC absolute time, exactly what now_ns() returns
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec  = (time_t)(deadline / 1000000000ull);
+  its.it_value.tv_nsec = (long)(deadline % 1000000000ull);
+  timerfd_settime(g_ui_timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
 #endif
 }
 
-//---- load/save hotkey config from file ----
-
-static void load_hotkey_config(void) {
-  FILE *f = fopen(CONFIG_FILE, "r");
-  if (!f) return;
+static void ui_notify_destroy(void) {
+#ifdef _WIN32
+  if (g_ui_timer) {
+    CloseHandle(g_ui_timer);
+    g_ui_timer = NULL;
+  }
+#else
+  if (g_ui_fd >= 0) close(g_ui_fd);
+  if (g_ui_timer_fd >= 0) close(g_ui_timer_fd);
+  g_ui_fd = g_ui_timer_fd = -1;
+#endif
+}
 
-  char line[256];
-  while (fgets(line, sizeof(line), f)) {
-    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
-      continue;
+//--------------- tracing ---------------
+//opt-in (--trace) timeline of hotkeys, handle_action, injected batches,
+//redraws, window discovery and config loads, written as Chrome trace-event
+//JSON on exit for Perfetto / chrome://tracing. every thread appends to its
+//own fixed buffer (single writer, publish by release store), so a trace
+//point costs a clock read and a store; while tracing is off it is a branch.
+//spans are stored as complete events (start + duration): a full buffer
+//drops whole events and never leaves a begin without its end.
+
+#define TRACE_FILE        "foxtool_trace.json"
+#define TRACE_THREADS_MAX 8
+#define TRACE_EVENTS_MAX  (1u << 16)   //per thread; later events are counted, not kept
+
+typedef struct {
+  uint64_t ts, dur;       //now_ns(); dur 0 = instant event
+  const char *name;       //string literals only
+  const char *arg_name;   //NULL: no argument
+  int64_t arg;
+} trace_event;
+
+typedef struct {
+  const char *thread;
+  trace_event *ev;
+  atomic_uint count;      //events published to the writer of the file
+  atomic_uint dropped;
+} trace_buf;
+
+static int g_trace_on = 0;       //set once by main before any thread starts
+static uint64_t g_trace_t0 = 0;  //timestamps in the file are relative to this
+static trace_buf g_trace_bufs[TRACE_THREADS_MAX];
+static atomic_int g_trace_threads = 0;
+static _Thread_local trace_buf *t_trace_buf = NULL;
+
+//give the calling thread its buffer; threads without one are not traced
+static void trace_thread(const char *name) {
+  if (!g_trace_on || t_trace_buf) return;
+  int i = atomic_fetch_add(&g_trace_threads, 1);
+  if (i >= TRACE_THREADS_MAX) return;
+  trace_buf *b = &g_trace_bufs[i];
+  b->ev = calloc(TRACE_EVENTS_MAX, sizeof(trace_event));
+  if (!b->ev) return;
+  b->thread = name;
+  t_trace_buf = b;
+}
 
-    char key[64], val[64];
-    if (sscanf(line, " %63[^=]=%63s", key, val) != 2)
-      continue;
+static void trace_start(void) {
+  g_trace_on = 1;
+  g_trace_t0 = now_ns();
+  trace_thread("main");
+}
 
-    int action = -1;
-    for (int i = 0; i < ACTION_COUNT; ++i) {
-      if (strcmp(key, g_action_names[i]) == 0) {
-        action = i;
-        break;
-      }
-    }
-    if (action < 0) continue;
+//span start time; 0 while tracing is off, so the clock is not read
+static uint64_t trace_now(void) {
+  return g_trace_on ? now_ns() : 0;
+}
 
-    int code = key_code_from_name(val);
-    if (code != 0) {
-      g_action_keys[action] = code;
-    }
+static void trace_emit(const char *name, uint64_t ts, uint64_t dur,
+                       const char *arg_name, int64_t arg) {
+  trace_buf *b = t_trace_buf;
+  if (!b) return;
+  unsigned int n = atomic_load_explicit(&b->count, memory_order_relaxed);
+  if (n >= TRACE_EVENTS_MAX) {
+    atomic_store_explicit(&b->dropped, atomic_load_explicit(&b->dropped, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    return;
   }
+  trace_event *e = &b->ev[n];
+  e->ts = ts;
+  e->dur = dur;
+  e->name = name;
+  e->arg_name = arg_name;
+  e->arg = arg;
+  atomic_store_explicit(&b->count, n + 1, memory_order_release);
+}
 
-  fclose(f);
+//something that happened at ts
+static void trace_instant(const char *name, uint64_t ts, const char *arg_name, int64_t arg) {
+  if (g_trace_on) trace_emit(name, ts, 0, arg_name, arg);
 }
 
-static void save_hotkey_config(void) {
-  FILE *f = fopen(CONFIG_FILE, "w");
+//a span from t0 (trace_now()) to now
+static void trace_span(const char *name, uint64_t t0, const char *arg_name, int64_t arg) {
+  if (!g_trace_on) return;
+  uint64_t t = now_ns();
+  //Perfetto draws a zero-length span as an instant
+  trace_emit(name, t0, t > t0 ? t - t0 : 1, arg_name, arg);
+}
+
+//every buffer as one JSON document, timestamps in microseconds; call after
+//the other threads have stopped. 0 if tracing is off or the file failed
+static int trace_write_file(void) {
+  if (!g_trace_on) return 0;
+  FILE *f = fopen(TRACE_FILE, "w");
   if (!f) {
-    fprintf(stderr, "Warning: cannot write config file '%s'\n", CONFIG_FILE);
-    return;
+    fprintf(stderr, "Warning: cannot write trace file '%s'\n", TRACE_FILE);
+    return 0;
   }
-
-  for (int i = 0; i < ACTION_COUNT; ++i) {
-    const char *name = g_action_names[i];
-    const char *kname = key_name_from_code(g_action_keys[i]);
-    fprintf(f, "%s=%s\n", name, kname);
+#ifdef _WIN32
+  unsigned long pid = (unsigned long)GetCurrentProcessId();
+#else
+  unsigned long pid = (unsigned long)getpid();
+#endif
+  int threads = atomic_load(&g_trace_threads);
+  if (threads > TRACE_THREADS_MAX) threads = TRACE_THREADS_MAX;
+  unsigned long long dropped = 0;
+
+  fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  fprintf(f, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%lu,\"tid\":0,"
+             "\"args\":{\"name\":\"foxholetool\"}}", pid);
+  for (int t = 0; t < threads; ++t) {
+    const trace_buf *b = &g_trace_bufs[t];
+    if (!b->ev) continue;
+    fprintf(f, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%lu,\"tid\":%d,"
+               "\"args\":{\"name\":\"%s\"}}", pid, t + 1, b->thread);
+    unsigned int n = atomic_load_explicit(&b->count, memory_order_acquire);
+    dropped += atomic_load_explicit(&b->dropped, memory_order_relaxed);
+    for (unsigned int i = 0; i < n; ++i) {
+      const trace_event *e = &b->ev[i];
+      double ts = (double)(int64_t)(e->ts - g_trace_t0) / 1e3;
+      if (e->dur)
+        fprintf(f, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%lu,\"tid\":%d,\"ts\":%.3f,"
+                   "\"dur\":%.3f", e->name, pid, t + 1, ts, (double)e->dur / 1e3);
+      else
+        fprintf(f, ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"pid\":%lu,\"tid\":%d,"
+                   "\"ts\":%.3f", e->name, pid, t + 1, ts);
+      if (e->arg_name) fprintf(f, ",\"args\":{\"%s\":%lld}", e->arg_name, (long long)e->arg);
+      fputc('}', f);
+    }
   }
-
-  fclose(f);
+  fprintf(f, "\n]}\n");
+  if (dropped)
+    fprintf(stderr, "Warning: trace buffers full, %llu events dropped\n", dropped);
+  return fclose(f) == 0;
 }
 
-//--------------- system input and overlay handling ---------------
+//--------------- latency histograms ---------------
+//always-on, log-bucketed (HDR style) histograms of nanosecond values: each
+//power of two is split into HIST_SUB linear sub-buckets, so the relative
+//error stays below 1/HIST_SUB at any magnitude. every histogram has one
+//writing thread; readers (dump) may see a sample half-way, never a torn count.
+
+#define HIST_SUB_BITS 3
+#define HIST_SUB      (1u << HIST_SUB_BITS)
+#define HIST_OCTAVES  40   //up to ~2^43 ns (~2 h); larger values land in the top bucket
+#define HIST_BUCKETS  ((HIST_OCTAVES + 1) * HIST_SUB)
+#define STATS_FILE    "foxtool_stats.txt"
+
+typedef struct {
+  const char *name;
+  _Atomic uint64_t count, sum, max;
+  _Atomic uint64_t b[HIST_BUCKETS];
+} hist;
+
+static hist g_hist_dispatch = { .name = "hotkey -> handle_action" };
+static hist g_hist_inject   = { .name = "hotkey -> first injected event" };
+static hist g_hist_late     = { .name = "macro step lateness" };
+static hist g_hist_overlay  = { .name = "overlay_draw" };
+static hist g_hist_watch    = { .name = "screen watch capture + compare" };
+
+static hist *const g_hists[] = {
+  &g_hist_dispatch, &g_hist_inject, &g_hist_late, &g_hist_overlay, &g_hist_watch
+};
+#define HIST_COUNT ((int)(sizeof(g_hists) / sizeof(g_hists[0])))
 
-#ifdef _WIN32
-//---------------- Windows input and overlay -----------------
+//repeating actions (MACRO_F_RATE): the worker counts every repetition, and
+//the ones it dropped or ran late to catch up after falling behind
+typedef struct {
+  _Atomic uint64_t ticks, dropped, caught_up;
+  _Atomic uint64_t interval_ns;   //target of the current run
+} rate_counters;
 
-//main overlay window handles on Windows
-static HWND g_overlay_hwnd = NULL;
-static HWND g_war_hwnd = NULL;
-static HFONT g_overlay_font = NULL;
+static rate_counters g_rate[ACTION_MAX];
 
-//F11 toggles overlay visibility
-#define VK_HIDE_OVERLAY   VK_F11
+//the main thread's sample of them while the action runs (rate_views_refresh)
+typedef struct {
+  int active;
+  uint64_t t, ticks;   //last sample
+  uint64_t dropped0;   //dropped count when the run was first seen
+  double per_sec;      //achieved over the last sample period, < 0 = none yet
+} rate_view;
 
-static void win_send_key(WORD vk, int down) {
-  INPUT in = {0};
-  in.type = INPUT_KEYBOARD;
-  in.ki.wVk = vk;
-  in.ki.dwFlags = down ? 0 : KEYEVENTF_KEYUP;
-  SendInput(1, &in, sizeof(in));
-}
+static rate_view g_rate_view[ACTION_MAX];
 
-static void win_send_mouse_btn(int button, int down) {
-  //button: 0=left 1=right
-  INPUT in = {0};
-  in.type = INPUT_MOUSE;
-  if (button == 0) in.mi.dwFlags = down ? MOUSEEVENTF_LEFTDOWN  : MOUSEEVENTF_LEFTUP;
-  else             in.mi.dwFlags = down ? MOUSEEVENTF_RIGHTDOWN : MOUSEEVENTF_RIGHTUP;
-  SendInput(1, &in, sizeof(in));
-}
+//scheduling the worker actually got, written once by the worker at start
+static char g_worker_sched_desc[128];
+static atomic_int g_worker_sched_ready = 0;
 
-static void win_move_mouse_abs(int x, int y) {
-  //Convert to absolute (0..65535)
-  int sx = GetSystemMetrics(SM_CXSCREEN);
-  int sy = GetSystemMetrics(SM_CYSCREEN);
-  LONG ax = (LONG)((double)x * 65535.0 / (double)(sx - 1));
-  LONG ay = (LONG)((double)y * 65535.0 / (double)(sy - 1));
+//hotkey receipt time for the worker's first injection, 0 = none pending
+static _Atomic uint64_t g_hotkey_t0 = 0;
 
-  INPUT in = {0};
-  in.type = INPUT_MOUSE;
-  in.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
-  in.mi.dx = ax;
-  in.mi.dy = ay;
-  SendInput(1, &in, sizeof(in));
+static int msb64(uint64_t v) {
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(v);
+#else
+  int n = 0;
+  while (v >>= 1) ++n;
+  return n;
+#endif
 }
 
-static void win_get_cursor(int *x, int *y) {
-  POINT p;
-  GetCursorPos(&p);
-  *x = (int)p.x;
-  *y = (int)p.y;
+static unsigned int hist_index(uint64_t v) {
+  if (v < HIST_SUB) return (unsigned int)v;
+  int msb = msb64(v);
+  unsigned int octave = (unsigned int)(msb - HIST_SUB_BITS + 1);
+  if (octave > HIST_OCTAVES) return HIST_BUCKETS - 1;
+  unsigned int sub = (unsigned int)(v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1);
+  return octave * HIST_SUB + sub;
 }
 
-//move and resize overlay to match the game window
-static void overlay_reposition_win(void) {
-  if (!g_overlay_hwnd || !g_war_hwnd) return;
+//smallest value of a bucket; bucket i covers [hist_lower(i), hist_lower(i + 1))
+static uint64_t hist_lower(unsigned int i) {
+  if (i < HIST_SUB) return i;
+  unsigned int octave = i / HIST_SUB, sub = i % HIST_SUB;
+  return (uint64_t)(HIST_SUB + sub) << (octave - 1);
+}
 
-  RECT rc;
-  if (!GetWindowRect(g_war_hwnd, &rc)) return;
+//single writer: plain load + store, no locked instruction
+static void hist_add(_Atomic uint64_t *c, uint64_t v) {
+  atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v,
+                        memory_order_relaxed);
+}
 
-  int x = rc.left;
-  int y = 0;
-  int width  = (int)OVERLAY_WIDTH_FULL;
-  int height = (int)OVERLAY_HEIGHT;
+static void hist_record(hist *h, uint64_t v) {
+  hist_add(&h->b[hist_index(v)], 1);
+  hist_add(&h->sum, v);
+  if (v > atomic_load_explicit(&h->max, memory_order_relaxed))
+    atomic_store_explicit(&h->max, v, memory_order_relaxed);
+  hist_add(&h->count, 1);
+}
 
-  MoveWindow(g_overlay_hwnd, x, y, width, height, TRUE);
+//value below which a fraction q of the samples fall (bucket upper bound)
+static uint64_t hist_percentile(const hist *h, uint64_t count, double q) {
+  uint64_t want = (uint64_t)(q * (double)count + 0.5);
+  if (want == 0) want = 1;
+  uint64_t seen = 0;
+  for (unsigned int i = 0; i < HIST_BUCKETS; ++i) {
+    seen += atomic_load_explicit(&h->b[i], memory_order_relaxed);
+    if (seen >= want) {
+      uint64_t upper = (i + 1 < HIST_BUCKETS) ? hist_lower(i + 1) - 1 : hist_lower(i);
+      uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+      return upper < max ? upper : max;
+    }
+  }
+  return atomic_load_explicit(&h->max, memory_order_relaxed);
 }
 
-#else
-//---------------- Linux (X11) input and overlay ----------------
-static Display *dpy = NULL;
+#define STATS_TEXT_MAX 8192   //stats summary (CTL_REPLY_MAX holds it too)
 
-//overlay window and target game window (Linux/X11)
-static Window g_overlay_win = 0;
-static Window g_foxhole_win = 0;
-static XFontStruct *g_overlay_font = NULL;
-static Visual *g_argb_visual = NULL;
-static int g_argb_depth = 0;
-static Colormap g_argb_colormap = 0;
-static GC g_overlay_gc = 0;
-static unsigned long g_overlay_white_pixel = 0;
+//snprintf at *used, keeping *used within the buffer (output is cut at the end)
+static void buf_printf(char *buf, size_t size, size_t *used, const char *fmt, ...) {
+  if (*used + 1 >= size) return;
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf + *used, size - *used, fmt, ap);
+  va_end(ap);
+  if (n > 0) *used += ((size_t)n < size - *used) ? (size_t)n : size - *used - 1;
+}
 
-//F11 toggles overlay visibility
-#define KS_HIDE_OVERLAY   XK_F11
+//one summary line per histogram, values in microseconds; returns the length
+static size_t stats_format(char *buf, size_t size) {
+  size_t n = 0;
+  if (size == 0) return 0;
+  buf[0] = '\0';
+  if (atomic_load_explicit(&g_worker_sched_ready, memory_order_acquire))
+    buf_printf(buf, size, &n, "worker scheduling: %s\n", g_worker_sched_desc);
+  buf_printf(buf, size, &n, "latency (us)                       count      mean       p50       p90"
+                            "       p99     p99.9       max\n");
+  for (int k = 0; k < HIST_COUNT; ++k) {
+    const hist *h = g_hists[k];
+    uint64_t c = atomic_load_explicit(&h->count, memory_order_relaxed);
+    if (c == 0) {
+      buf_printf(buf, size, &n, "%-32s %7s\n", h->name, "0");
+      continue;
+    }
+    double mean = (double)atomic_load_explicit(&h->sum, memory_order_relaxed) / (double)c;
+    buf_printf(buf, size, &n, "%-32s %7llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", h->name,
+               (unsigned long long)c, mean / 1e3,
+               (double)hist_percentile(h, c, 0.50) / 1e3,
+               (double)hist_percentile(h, c, 0.90) / 1e3,
+               (double)hist_percentile(h, c, 0.99) / 1e3,
+               (double)hist_percentile(h, c, 0.999) / 1e3,
+               (double)atomic_load_explicit(&h->max, memory_order_relaxed) / 1e3);
+  }
+  for (int a = 0; a < ACTION_MAX; ++a) {
+    const rate_counters *r = &g_rate[a];
+    uint64_t t = atomic_load_explicit(&r->ticks, memory_order_relaxed);
+    uint64_t iv = atomic_load_explicit(&r->interval_ns, memory_order_relaxed);
+    if (t == 0 || iv == 0 || !g_action_names[a]) continue;
+    buf_printf(buf, size, &n, "%s: target %.1f/s", g_action_names[a], 1e9 / (double)iv);
+    if (g_rate_view[a].active && g_rate_view[a].per_sec >= 0)
+      buf_printf(buf, size, &n, ", achieved %.1f/s", g_rate_view[a].per_sec);
+    buf_printf(buf, size, &n, ", %llu repetitions, %llu dropped, %llu caught up\n",
+               (unsigned long long)t,
+               (unsigned long long)atomic_load_explicit(&r->dropped, memory_order_relaxed),
+               (unsigned long long)atomic_load_explicit(&r->caught_up, memory_order_relaxed));
+  }
+  return n;
+}
 
-static void x11_get_cursor(int *x, int *y) {
-  Window root = DefaultRootWindow(dpy);
-  Window ret_root, ret_child;
-  int root_x, root_y, win_x, win_y;
-  unsigned int mask;
-  XQueryPointer(dpy, root, &ret_root, &ret_child, &root_x, &root_y, &win_x, &win_y, &mask);
-  *x = root_x;
-  *y = root_y;
+static void stats_dump(FILE *out) {
+  char text[STATS_TEXT_MAX];
+  fwrite(text, 1, stats_format(text, sizeof(text)), out);
+  fflush(out);
 }
 
-static void x11_move_mouse(int x, int y) {
-  XTestFakeMotionEvent(dpy, -1, x, y, CurrentTime);
-  XFlush(dpy);
+//summary plus every non-empty bucket ("lower_ns upper_ns count")
+static int stats_write_file(void) {
+  FILE *f = fopen(STATS_FILE, "w");
+  if (!f) {
+    fprintf(stderr, "Warning: cannot write stats file '%s'\n", STATS_FILE);
+    return 0;
+  }
+  stats_dump(f);
+  for (int k = 0; k < HIST_COUNT; ++k) {
+    const hist *h = g_hists[k];
+    fprintf(f, "\n[%s]\n", h->name);
+    for (unsigned int i = 0; i < HIST_BUCKETS; ++i) {
+      uint64_t c = atomic_load_explicit(&h->b[i], memory_order_relaxed);
+      if (c == 0) continue;
+      uint64_t upper = (i + 1 < HIST_BUCKETS) ? hist_lower(i + 1) : UINT64_MAX;
+      fprintf(f, "%llu %llu %llu\n", (unsigned long long)hist_lower(i),
+              (unsigned long long)upper, (unsigned long long)c);
+    }
+  }
+  return fclose(f) == 0;
 }
 
-static void x11_mouse_btn(int button, int down) {
-  //XTest buttons: 1=left 3=right
-  int b = (button == 0) ? 1 : 3;
-  XTestFakeButtonEvent(dpy, b, down ? True : False, CurrentTime);
-  XFlush(dpy);
+//called by the UI thread right before dispatching a hotkey received at t_recv
+static void stats_hotkey(uint64_t t_recv) {
+  trace_instant("hotkey", t_recv, NULL, 0);
+  hist_record(&g_hist_dispatch, now_ns() - t_recv);
+  atomic_store_explicit(&g_hotkey_t0, t_recv, memory_order_release);
 }
 
-static void x11_key(int keysym, int down) {
-  KeyCode kc = XKeysymToKeycode(dpy, (KeySym)keysym);
-  if (kc == 0) return;
-  XTestFakeKeyEvent(dpy, kc, down ? True : False, CurrentTime);
-  XFlush(dpy);
+//--------------- small helpers ------------------
+//case-insensitive substring search
+static int strcasestr_simple(const char *haystack, const char *needle) {
+  if (!haystack || !needle || !*needle) return 0;
+  for (const char *p = haystack; *p; ++p) {
+    const char *h = p;
+    const char *n = needle;
+    while (*h && *n && tolower((unsigned char)*h) == tolower((unsigned char)*n)) {
+      ++h;
+      ++n;
+    }
+    if (!*n) return 1;
+  }
+  return 0;
 }
-#endif
 
-//---------- text shown in the overlay (Windows + Linux) ----------
+//---- PID -> "is this the game" verdict cache ----
+//window discovery checks each process at most once; small open-addressing
+//table, cleared completely when it fills up
 
-static void build_overlay_text(char *buf, size_t buf_size) {
-  if (!buf || buf_size == 0) return;
+#define PID_CACHE_SIZE 256   //power of two
 
-  const char *k_spam   = key_name_from_code(g_action_keys[ACTION_SPAM_LMB]);
-  const char *k_w      = key_name_from_code(g_action_keys[ACTION_HOLD_W]);
-  const char *k_s      = key_name_from_code(g_action_keys[ACTION_HOLD_S]);
-  const char *k_rmb    = key_name_from_code(g_action_keys[ACTION_HOLD_RMB]);
-  const char *k_lmb    = key_name_from_code(g_action_keys[ACTION_HOLD_LMB]);
-  const char *k_suspend= key_name_from_code(g_action_keys[ACTION_SUSPEND]);
-  const char *k_exit   = key_name_from_code(g_action_keys[ACTION_EXIT]);
-  const char *k_hide   = key_name_from_code(
-#ifdef _WIN32
-      VK_HIDE_OVERLAY
-#else
-      KS_HIDE_OVERLAY
-#endif
-  );
+typedef struct {
+  unsigned long pid;         //0 = empty slot
+  int verdict;               //1 = game process, 0 = something else
+} pid_cache_entry;
 
-  snprintf(buf, buf_size,
-           "%s spam LMB saved position | "
-           "%s hold W | %s hold S | "
-           "%s hold RMB | %s hold LMB | "
-           "%s stop | %s exit | "
-           "%s hide HUD",
-           k_spam, k_w, k_s, k_rmb, k_lmb, k_suspend, k_exit,
-           k_hide);
-}
+static pid_cache_entry g_pid_cache[PID_CACHE_SIZE];
+static int g_pid_cache_used = 0;
 
-#ifndef _WIN32
-//--------------- overlay helpers for Linux/X11 -----------
+//returns -1 when the PID was not checked yet
+static int pid_cache_get(unsigned long pid) {
+  unsigned int i = (unsigned int)(pid * 2654435761u) & (PID_CACHE_SIZE - 1);
+  for (int n = 0; n < PID_CACHE_SIZE; ++n) {
+    if (g_pid_cache[i].pid == 0) return -1;
+    if (g_pid_cache[i].pid == pid) return g_pid_cache[i].verdict;
+    i = (i + 1) & (PID_CACHE_SIZE - 1);
+  }
+  return -1;
+}
 
-static void overlay_draw(void);
+//forget all verdicts, e.g. once the game exits and its PID may be reused
+static void pid_cache_clear(void) {
+  memset(g_pid_cache, 0, sizeof(g_pid_cache));
+  g_pid_cache_used = 0;
+}
 
-//helpers to read and compare window titles
-static int window_title_equals(Display *display, Window w, const char *exact) {
-  if (!display || !exact) return 0;
-  char *name = NULL;
-  if (XFetchName(display, w, &name) > 0 && name) {
-    int ok = (strcasecmp(name, exact) == 0);
-    XFree(name);
-    return ok;
+static void pid_cache_put(unsigned long pid, int verdict) {
+  if (pid == 0) return;
+  if (g_pid_cache_used >= PID_CACHE_SIZE * 3 / 4) {
+    pid_cache_clear();
   }
-  return 0;
+  unsigned int i = (unsigned int)(pid * 2654435761u) & (PID_CACHE_SIZE - 1);
+  while (g_pid_cache[i].pid != 0 && g_pid_cache[i].pid != pid) {
+    i = (i + 1) & (PID_CACHE_SIZE - 1);
+  }
+  if (g_pid_cache[i].pid == 0) ++g_pid_cache_used;
+  g_pid_cache[i].pid = pid;
+  g_pid_cache[i].verdict = verdict;
 }
 
-static int window_title_contains(Display *display, Window w, const char *substr) {
-  if (!display || !substr) return 0;
-  char *name = NULL;
-  if (XFetchName(display, w, &name) > 0 && name) {
-    int ok = strcasestr_simple(name, substr);
-    XFree(name);
-    return ok;
+//overlay size in pixels
+#define OVERLAY_WIDTH_FULL    800u
+#define OVERLAY_WIDTH_COMPACT 260u
+#define OVERLAY_HEIGHT        32u
+
+//convert string to uppercase A‑Z
+static void strtoupper_simple(char *s) {
+  if (!s) return;
+  for (; *s; ++s) {
+    if (*s >= 'a' && *s <= 'z') {
+      *s = (char)(*s - 'a' + 'A');
+    }
   }
-  return 0;
 }
 
-static Window find_window_title_exact_rec(Display *display, Window w, const char *exact) {
-  if (window_title_equals(display, w, exact))
-    return w;
+//---- map key code <-> readable name (e.g. VK_F2 -> "F2") ----
+//a hotkey is any key (VK_* / XK_*) plus an optional modifier mask, written
+//like "F2", "Q", "Numpad5", "KP_Add" (X11 keysym) or "Ctrl+Shift+F5"
 
-  Window root_ret, parent_ret;
-  Window *children = NULL;
-  unsigned int nchildren = 0;
-  if (!XQueryTree(display, w, &root_ret, &parent_ret, &children, &nchildren))
-    return 0;
+#ifdef _WIN32
+  #define KEY_CODE_F1      VK_F1
+  #define KEY_CODE_NUMPAD0 VK_NUMPAD0
+#else
+  #define KEY_CODE_F1      XK_F1
+  #define KEY_CODE_NUMPAD0 XK_KP_0
+#endif
+#define KEY_F_MAX 24   //VK_F1..VK_F24 and XK_F1..XK_F24 are contiguous
 
-  Window result = 0;
-  for (unsigned int i = 0; i < nchildren && !result; ++i) {
-    result = find_window_title_exact_rec(display, children[i], exact);
-  }
+//portable hotkey modifier bits; the values are the Win32 MOD_* flags
+enum {
+  HK_MOD_ALT   = 0x1,
+  HK_MOD_CTRL  = 0x2,
+  HK_MOD_SHIFT = 0x4,
+  HK_MOD_SUPER = 0x8,
+  HK_MOD_ALL   = 0xF
+};
 
-  if (children)
-    XFree(children);
+typedef struct {
+  const char *name;
+  int code;
+} key_alias;
 
-  return result;
+//first entry per bit is the name written back
+static const key_alias g_mod_names[] = {
+  { "CTRL", HK_MOD_CTRL },   { "ALT", HK_MOD_ALT },   { "SHIFT", HK_MOD_SHIFT },
+  { "SUPER", HK_MOD_SUPER }, { "CONTROL", HK_MOD_CTRL }, { "WIN", HK_MOD_SUPER }
+};
+static const char *const g_mod_out_names[] = { "Ctrl", "Alt", "Shift", "Super" };
+
+#ifdef _WIN32
+static const key_alias g_key_aliases[] = {
+  { "Space", VK_SPACE },  { "Enter", VK_RETURN }, { "Tab", VK_TAB },
+  { "Esc", VK_ESCAPE },   { "Shift", VK_SHIFT },  { "Ctrl", VK_CONTROL },
+  { "Alt", VK_MENU },     { "Backspace", VK_BACK }, { "Insert", VK_INSERT },
+  { "Delete", VK_DELETE }, { "Home", VK_HOME },   { "End", VK_END },
+  { "PageUp", VK_PRIOR }, { "PageDown", VK_NEXT }, { "Left", VK_LEFT },
+  { "Right", VK_RIGHT },  { "Up", VK_UP },        { "Down", VK_DOWN },
+  { "Pause", VK_PAUSE }
+};
+#else
+static const key_alias g_key_aliases[] = {
+  { "Space", XK_space },  { "Enter", XK_Return }, { "Tab", XK_Tab },
+  { "Esc", XK_Escape },   { "Shift", XK_Shift_L }, { "Ctrl", XK_Control_L },
+  { "Alt", XK_Alt_L },    { "Backspace", XK_BackSpace }, { "Insert", XK_Insert },
+  { "Delete", XK_Delete }, { "Home", XK_Home },   { "End", XK_End },
+  { "PageUp", XK_Prior }, { "PageDown", XK_Next }, { "Left", XK_Left },
+  { "Right", XK_Right },  { "Up", XK_Up },        { "Down", XK_Down },
+  { "Pause", XK_Pause }
+};
+#endif
+#define KEY_ALIASES ((int)(sizeof(g_key_aliases) / sizeof(g_key_aliases[0])))
+
+//name of a single key into buf; "none" for 0
+static const char *key_name(int code, char *buf, size_t size) {
+  if (code == 0) {
+    snprintf(buf, size, "none");
+  } else if (code >= KEY_CODE_F1 && code < KEY_CODE_F1 + KEY_F_MAX) {
+    snprintf(buf, size, "F%d", code - KEY_CODE_F1 + 1);
+  } else if (code >= KEY_CODE_NUMPAD0 && code <= KEY_CODE_NUMPAD0 + 9) {
+    snprintf(buf, size, "Numpad%d", code - KEY_CODE_NUMPAD0);
+#ifdef _WIN32
+  } else if ((code >= 'A' && code <= 'Z') || (code >= '0' && code <= '9')) {
+#else
+  } else if ((code >= XK_a && code <= XK_z) || (code >= XK_0 && code <= XK_9)) {
+#endif
+    snprintf(buf, size, "%c", toupper(code));
+  } else {
+    for (int i = 0; i < KEY_ALIASES; ++i) {
+      if (g_key_aliases[i].code != code) continue;
+      snprintf(buf, size, "%s", g_key_aliases[i].name);
+      return buf;
+    }
+#ifdef _WIN32
+    snprintf(buf, size, "0x%02X", (unsigned)code);
+#else
+    const char *s = XKeysymToString((KeySym)code);
+    snprintf(buf, size, "%s", s ? s : "?");
+#endif
+  }
+  return buf;
 }
 
-static Window find_window_title_contains_rec(Display *display, Window w, const char *substr) {
-  if (window_title_contains(display, w, substr))
-    return w;
+//name of a binding (modifiers + key) into buf
+static const char *hotkey_name(int code, int mods, char *buf, size_t size) {
+  buf[0] = '\0';
+  for (int b = 0; b < 4; ++b) {
+    if (!(mods & g_mod_names[b].code)) continue;
+    size_t n = strlen(buf);
+    snprintf(buf + n, size - n, "%s+", g_mod_out_names[b]);
+  }
+  size_t n = strlen(buf);
+  key_name(code, buf + n, size - n);
+  return buf;
+}
 
-  Window root_ret, parent_ret;
-  Window *children = NULL;
-  unsigned int nchildren = 0;
-  if (!XQueryTree(display, w, &root_ret, &parent_ret, &children, &nchildren))
-    return 0;
+//VK_* / XK_* code of a single key name, or 0
+static int key_code_from_name(const char *name) {
+  if (!name || !*name) return 0;
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%s", name);
+  strtoupper_simple(buf);
 
-  Window result = 0;
-  for (unsigned int i = 0; i < nchildren && !result; ++i) {
-    result = find_window_title_contains_rec(display, children[i], substr);
+  if (buf[1] == '\0' && isalnum((unsigned char)buf[0])) {
+#ifdef _WIN32
+    return (int)buf[0];   //VK codes of A-Z / 0-9 are their ASCII values
+#else
+    return (int)tolower((unsigned char)buf[0]);   //XK_a.. / XK_0.. are ASCII
+#endif
+  }
+  char *end = NULL;
+  if (buf[0] == 'F' && isdigit((unsigned char)buf[1])) {
+    long n = strtol(buf + 1, &end, 10);
+    if (*end == '\0' && n >= 1 && n <= KEY_F_MAX) return KEY_CODE_F1 + (int)(n - 1);
   }
+  if (strncmp(buf, "NUMPAD", 6) == 0 && isdigit((unsigned char)buf[6]) && buf[7] == '\0')
+    return KEY_CODE_NUMPAD0 + (buf[6] - '0');
+  for (int i = 0; i < KEY_ALIASES; ++i) {
+    char alias[16];
+    snprintf(alias, sizeof(alias), "%s", g_key_aliases[i].name);
+    strtoupper_simple(alias);
+    if (strcmp(buf, alias) == 0) return g_key_aliases[i].code;
+  }
+#ifdef _WIN32
+  //any other virtual-key code as "0x<hex>"
+  if (buf[0] == '0' && buf[1] == 'X') {
+    long vk = strtol(buf + 2, &end, 16);
+    if (end != buf + 2 && *end == '\0' && vk > 0 && vk < 0xFF) return (int)vk;
+  }
+  return 0;
+#else
+  //any other X keysym name ("Shift_R", "KP_Enter", ...)
+  KeySym ks = XStringToKeysym(name);
+  return ks != NoSymbol ? (int)ks : 0;
+#endif
+}
 
-  if (children)
-    XFree(children);
+//parse "[Mod+]...key" or "none"; returns 0 if a part is unknown
+static int hotkey_from_name(const char *name, int *code, int *mods) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%s", name);
+  int m = 0;
+  char *p = buf;
+  char *plus;
+  //everything before the last '+' is a modifier; a lone trailing '+' is a key
+  while ((plus = strchr(p, '+')) != NULL && plus[1] != '\0') {
+    *plus = '\0';
+    strtoupper_simple(p);
+    int bit = 0;
+    for (size_t i = 0; i < sizeof(g_mod_names) / sizeof(g_mod_names[0]); ++i) {
+      if (strcmp(p, g_mod_names[i].name) == 0) bit = g_mod_names[i].code;
+    }
+    if (!bit) return 0;
+    m |= bit;
+    p = plus + 1;
+  }
 
-  return result;
+  char up[8];
+  snprintf(up, sizeof(up), "%s", p);
+  strtoupper_simple(up);
+  int c = (strcmp(up, "NONE") == 0) ? 0 : key_code_from_name(p);
+  if (!c && strcmp(up, "NONE") != 0) return 0;
+  *code = c;
+  *mods = c ? m : 0;
+  return 1;
 }
 
-//return 1 if process path/cmdline contains "foxhole"
-static int process_matches_foxhole(unsigned long pid_ul) {
-  if (pid_ul == 0) return 0;
+//----set default hotkey mapping----
 
-  char pathbuf[512];
-  char procfile[64];
+static void init_default_hotkeys(config_snap *c) {
+#ifdef _WIN32
+  c->keys[ACTION_SPAM_LMB] = VK_F2;
+  c->keys[ACTION_HOLD_W]   = VK_F3;
+  c->keys[ACTION_HOLD_S]   = VK_F4;
+  c->keys[ACTION_HOLD_RMB] = VK_F6;
+  c->keys[ACTION_HOLD_LMB] = VK_F7;
+  c->keys[ACTION_SUSPEND]  = VK_F9;
+  c->keys[ACTION_EXIT]     = VK_F10;
+  c->keys[ACTION_RECORD]   = VK_F5;
+  c->keys[ACTION_REPLAY]   = VK_F8;
+  c->keys[ACTION_STATS]    = VK_F1;
+#else
+  c->keys[ACTION_SPAM_LMB] = XK_F2;
+  c->keys[ACTION_HOLD_W]   = XK_F3;
+  c->keys[ACTION_HOLD_S]   = XK_F4;
+  c->keys[ACTION_HOLD_RMB] = XK_F6;
+  c->keys[ACTION_HOLD_LMB] = XK_F7;
+  c->keys[ACTION_SUSPEND]  = XK_F9;
+  c->keys[ACTION_EXIT]     = XK_F10;
+  c->keys[ACTION_RECORD]   = XK_F5;
+  c->keys[ACTION_REPLAY]   = XK_F8;
+  c->keys[ACTION_STATS]    = XK_F1;
+#endif
 
-  //check /proc/<pid>/exe symlink
-  snprintf(procfile, sizeof(procfile), "/proc/%lu/exe", pid_ul);
-  ssize_t len = readlink(procfile, pathbuf, sizeof(pathbuf) - 1);
-  if (len > 0) {
-    pathbuf[len] = '\0';
-    if (strcasestr_simple(pathbuf, "foxhole")) {
-      return 1;
-    }
+  c->interval_us[ACTION_SPAM_LMB] = SPAM_DEFAULT_INTERVAL_US;
+  c->worker = g_worker_sched_default;
+  c->watch_interval_us = WATCH_DEFAULT_INTERVAL_US;
+}
+
+//return the index of a built-in action by its config name, or -1
+static int action_from_name(const char *name, size_t len) {
+  for (int i = 0; i < ACTION_COUNT; ++i) {
+    if (strlen(g_action_names[i]) == len && strncmp(name, g_action_names[i], len) == 0)
+      return i;
   }
+  return -1;
+}
 
-  //check first argument in /proc/<pid>/cmdline
-  snprintf(procfile, sizeof(procfile), "/proc/%lu/cmdline", pid_ul);
-  FILE *f = fopen(procfile, "r");
-  if (f) {
-    size_t n = fread(pathbuf, 1, sizeof(pathbuf) - 1, f);
-    fclose(f);
-    if (n > 0) {
-      //cmdline is NUL‑separated; first string is enough
-      pathbuf[n] = '\0';
-      if (strcasestr_simple(pathbuf, "foxhole")) {
-        return 1;
-      }
-    }
+//find a user macro by name, creating it when asked; returns its action or -1
+static int macro_user_action(config_snap *c, const char *name, size_t len, int create) {
+  if (len == 0 || len >= MACRO_NAME_MAX) return -1;
+  for (int i = 0; i < c->macro_count; ++i) {
+    if (strlen(c->macro_names[i]) == len && strncmp(name, c->macro_names[i], len) == 0)
+      return ACTION_MACRO_FIRST + i;
   }
+  if (!create) return -1;
+  if (c->macro_count == MACRO_USER_MAX) {
+    fprintf(stderr, "Warning: more than %d macros, '%.*s' ignored\n",
+            MACRO_USER_MAX, (int)len, name);
+    return -1;
+  }
+  int i = c->macro_count++;
+  memcpy(c->macro_names[i], name, len);
+  c->macro_names[i][len] = '\0';
+  c->macro_src[i][0] = '\0';
+  return ACTION_MACRO_FIRST + i;
+}
 
-  return 0;
+//point the action names of the user macros at the current config
+static void config_bind_names(void) {
+  for (int i = 0; i < MACRO_USER_MAX; ++i) {
+    g_action_names[ACTION_MACRO_FIRST + i] = (i < g_cfg->macro_count) ? g_cfg->macro_names[i] : NULL;
+  }
 }
 
-static Window find_target_window(Display *display) {
-  if (!display) return 0;
+//true if s (of length len) ends with sfx; *stem gets the length before it
+static int ends_with(const char *s, size_t len, const char *sfx, size_t *stem) {
+  size_t n = strlen(sfx);
+  if (len <= n || strncmp(s + len - n, sfx, n) != 0) return 0;
+  *stem = len - n;
+  return 1;
+}
 
-  Atom pid_atom = XInternAtom(display, "_NET_WM_PID", True);
-  if (pid_atom == None) {
-    return 0;
+//trim whitespace in place
+static char *trim(char *s) {
+  while (isspace((unsigned char)*s)) ++s;
+  size_t n = strlen(s);
+  while (n > 0 && isspace((unsigned char)s[n - 1])) s[--n] = '\0';
+  return s;
+}
+
+//"<key>=yes/no" (also on/off, true/false, 1/0); anything else keeps *out
+static void load_yes_no(const char *key, char *val, int *out) {
+  strtoupper_simple(val);
+  if (!strcmp(val, "YES") || !strcmp(val, "ON") || !strcmp(val, "TRUE") || !strcmp(val, "1"))
+    *out = 1;
+  else if (!strcmp(val, "NO") || !strcmp(val, "OFF") || !strcmp(val, "FALSE") || !strcmp(val, "0"))
+    *out = 0;
+  else
+    fprintf(stderr, "Warning: %s expects yes or no, got '%s'\n", key, val);
+}
+
+//"Worker <name>=<val>": scheduling options of the worker thread
+static void load_worker_option(worker_sched_cfg *w, const char *name, char *val) {
+  char *end = NULL;
+  if (strcmp(name, "priority") == 0) {
+    strtoupper_simple(val);
+    if (strcmp(val, "NORMAL") == 0) w->priority = WORKER_PRIO_NORMAL;
+    else if (strcmp(val, "HIGH") == 0) w->priority = WORKER_PRIO_HIGH;
+    else if (strcmp(val, "REALTIME") == 0) w->priority = WORKER_PRIO_REALTIME;
+    else fprintf(stderr, "Warning: unknown worker priority '%s', using normal\n", val);
+  } else if (strcmp(name, "policy") == 0) {
+    strtoupper_simple(val);
+    if (strcmp(val, "FIFO") == 0) w->rt_rr = 0;
+    else if (strcmp(val, "RR") == 0) w->rt_rr = 1;
+    else fprintf(stderr, "Warning: unknown worker policy '%s', using fifo\n", val);
+  } else if (strcmp(name, "rt_priority") == 0) {
+    long v = strtol(val, &end, 10);
+    if (end == val) return;
+    w->rt_priority = (int)(v < 1 ? 1 : v > 99 ? 99 : v);
+  } else if (strcmp(name, "nice") == 0) {
+    long v = strtol(val, &end, 10);
+    if (end == val) return;
+    w->nice = (int)(v < -20 ? -20 : v > 19 ? 19 : v);
+  } else if (strcmp(name, "affinity") == 0) {
+    unsigned long long v = strtoull(val, &end, 0);
+    if (end == val) return;
+    w->affinity = v;
+  } else {
+    fprintf(stderr, "Warning: unknown worker option '%s'\n", name);
   }
+}
 
-  Window root = DefaultRootWindow(display);
+//"Watch <name>=<region>": a later line with the same name replaces it
+static void load_watch(config_snap *c, const char *name, const char *val) {
+  size_t len = strlen(name);
+  if (strcmp(name, "interval_us") == 0) {
+    char *end = NULL;
+    unsigned long us = strtoul(val, &end, 10);
+    if (end == val) return;
+    if (us < WATCH_MIN_INTERVAL_US) us = WATCH_MIN_INTERVAL_US;
+    if (us > 1000000ul) us = 1000000ul;
+    c->watch_interval_us = (unsigned int)us;
+    return;
+  }
+  if (len == 0 || len >= MACRO_NAME_MAX) return;
+  int i = 0;
+  while (i < c->watch_count && strcmp(c->watch_names[i], name) != 0) ++i;
+  if (i == WATCH_MAX) {
+    fprintf(stderr, "Warning: more than %d watch regions, '%s' ignored\n", WATCH_MAX, name);
+    return;
+  }
+  if (i == c->watch_count) {
+    ++c->watch_count;
+    memcpy(c->watch_names[i], name, len + 1);
+  }
+  snprintf(c->watch_src[i], WATCH_SRC_MAX, "%s", val);
+}
 
-  //DFS over windows belonging to a process whose path/cmdline contains "foxhole"
-  Window stack[1024];
-  int stack_top = 0;
-  stack[stack_top++] = root;
+//"<action>=<hotkey>"; an unknown key keeps the current binding
+static void load_hotkey_binding(config_snap *c, int action, const char *name, const char *val) {
+  int code = 0, mods = 0;
+  if (!hotkey_from_name(val, &code, &mods)) {
+    fprintf(stderr, "Warning: unknown key '%s' for '%s'\n", val, name);
+    return;
+  }
+  c->keys[action] = code;
+  c->mods[action] = mods;
+}
 
-  while (stack_top > 0) {
-    Window w = stack[--stack_top];
+//---- load/save hotkey config from file ----
 
-    //read PID for this window
-    Atom type;
-    int format;
-    unsigned long nitems, bytes_after;
-    unsigned char *prop = NULL;
-    if (XGetWindowProperty(display, w, pid_atom,
-                           0, 1, False, XA_CARDINAL,
-                           &type, &format, &nitems, &bytes_after, &prop) == Success &&
-        prop != NULL && nitems >= 1 && format == 32) {
-      unsigned long pid_ul = *((unsigned long*)prop);
-      XFree(prop);
+static void load_hotkey_config(config_snap *c) {
+  FILE *f = fopen(CONFIG_FILE, "r");
+  if (!f) return;
+
+  char line[MACRO_SRC_MAX + 64];
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+      continue;
 
-      if (process_matches_foxhole(pid_ul)) {
-        return w;
+    //"<key>=<value>"; the value is the rest of the line (macro sources have spaces)
+    char *eq = strchr(line, '=');
+    if (!eq) continue;
+    *eq = '\0';
+    char *key = trim(line);
+    char *val = trim(eq + 1);
+    size_t key_len = strlen(key);
+    size_t stem = 0;
+
+    //"Macro <name>=<key>" binds a macro, "Macro <name> seq=<steps>" defines it
+    size_t pfx_len = strlen(CONFIG_MACRO_PREFIX);
+    if (key_len > pfx_len && strncmp(key, CONFIG_MACRO_PREFIX, pfx_len) == 0) {
+      const char *name = key + pfx_len;
+      size_t name_len = key_len - pfx_len;
+      if (ends_with(name, name_len, CONFIG_MACRO_SUFFIX, &stem)) {
+        int action = macro_user_action(c, name, stem, 1);
+        if (action < 0) continue;
+        snprintf(c->macro_src[action - ACTION_MACRO_FIRST], MACRO_SRC_MAX, "%s", val);
+      } else {
+        int action = macro_user_action(c, name, name_len, 1);
+        if (action >= 0) load_hotkey_binding(c, action, name, val);
       }
-    } else if (prop) {
-      XFree(prop);
+      continue;
     }
 
-    //push children on the stack to keep searching
-    Window root_ret, parent_ret;
-    Window *children = NULL;
-    unsigned int nchildren = 0;
-    if (XQueryTree(display, w, &root_ret, &parent_ret, &children, &nchildren)) {
-      for (unsigned int i = 0; i < nchildren && stack_top < (int)(sizeof(stack) / sizeof(stack[0])); ++i) {
-        stack[stack_top++] = children[i];
+    pfx_len = strlen(CONFIG_WATCH_PREFIX);
+    if (key_len > pfx_len && strncmp(key, CONFIG_WATCH_PREFIX, pfx_len) == 0) {
+      load_watch(c, key + pfx_len, val);
+      continue;
+    }
+
+    pfx_len = strlen(CONFIG_WORKER_PREFIX);
+    if (key_len > pfx_len && strncmp(key, CONFIG_WORKER_PREFIX, pfx_len) == 0) {
+      load_worker_option(&c->worker, key + pfx_len, val);
+      continue;
+    }
+
+    if (strcmp(key, CONFIG_INJECTOR) == 0) {
+      strtoupper_simple(val);
+      if (strcmp(val, "UINPUT") == 0) c->uinput = 1;
+      else if (strcmp(val, "NATIVE") == 0) c->uinput = 0;
+      else fprintf(stderr, "Warning: unknown injector '%s', using native\n", val);
+      continue;
+    }
+
+    if (strcmp(key, CONFIG_PAUSE_UNFOCUSED) == 0) {
+      load_yes_no(key, val, &c->pause_unfocused);
+      continue;
+    }
+
+    if (strcmp(key, CONFIG_MULTIBOX) == 0) {
+      load_yes_no(key, val, &c->multibox);
+      continue;
+    }
+
+    //"<action> interval_us=<n>" sets the repeat interval of a repeating action
+    if (ends_with(key, key_len, CONFIG_INTERVAL_SUFFIX, &stem)) {
+      int action = action_from_name(key, stem);
+      if (action < 0 || c->interval_us[action] == 0) continue;
+
+      char *end = NULL;
+      unsigned long us = strtoul(val, &end, 10);
+      if (end == val) continue;
+      if (us < SPAM_MIN_INTERVAL_US) us = SPAM_MIN_INTERVAL_US;
+      c->interval_us[action] = (unsigned int)us;
+      continue;
+    }
+
+    //"<action> cps=<n>" overrides the interval, "<action> late=<policy>"
+    if (ends_with(key, key_len, CONFIG_CPS_SUFFIX, &stem)) {
+      int action = action_from_name(key, stem);
+      if (action < 0 || c->interval_us[action] == 0) continue;
+
+      char *end = NULL;
+      unsigned long cps = strtoul(val, &end, 10);
+      if (end == val) continue;
+      if (cps > SPAM_MAX_CPS) {
+        fprintf(stderr, "Warning: %s is limited to %u, using that\n", key, SPAM_MAX_CPS);
+        cps = SPAM_MAX_CPS;
       }
+      c->cps[action] = (unsigned int)cps;
+      continue;
     }
-    if (children) {
-      XFree(children);
+    if (ends_with(key, key_len, CONFIG_LATE_SUFFIX, &stem)) {
+      int action = action_from_name(key, stem);
+      if (action < 0 || c->interval_us[action] == 0) continue;
+      strtoupper_simple(val);
+      if (strcmp(val, "COALESCE") == 0) c->late[action] = LATE_COALESCE;
+      else if (strcmp(val, "CATCHUP") == 0) c->late[action] = LATE_CATCHUP;
+      else fprintf(stderr, "Warning: unknown %s '%s', using coalesce\n", key, val);
+      continue;
     }
+
+    int action = action_from_name(key, key_len);
+    if (action < 0) continue;
+    load_hotkey_binding(c, action, key, val);
   }
 
-  return 0;
+  fclose(f);
 }
 
-static void overlay_position_on_window(void) {
-  if (!dpy || !g_overlay_win || !g_foxhole_win) return;
+//a fresh snapshot: the defaults, overridden by the config file if there is
+//one; NULL when out of memory. safe to call from any thread
+static config_snap *config_load(void) {
+  uint64_t t0 = trace_now();
+  //calloc: unused bytes stay zero, so snapshots compare with memcmp
+  config_snap *c = calloc(1, sizeof(*c));
+  if (!c) return NULL;
+  init_default_hotkeys(c);
+  load_hotkey_config(c);
+  trace_span("config_load", t0, NULL, 0);
+  return c;
+}
 
-  XWindowAttributes wa;
-  if (!XGetWindowAttributes(dpy, g_foxhole_win, &wa)) return;
-  int x = wa.x;
-  int y = 0;
+static void save_hotkey_config(void) {
+  FILE *f = fopen(CONFIG_FILE, "w");
+  if (!f) {
+    fprintf(stderr, "Warning: cannot write config file '%s'\n", CONFIG_FILE);
+    return;
+  }
 
-  unsigned int width = OVERLAY_WIDTH_FULL;
-  unsigned int height = OVERLAY_HEIGHT;
+  char kname[48];
+  for (int i = 0; i < ACTION_COUNT; ++i) {
+    hotkey_name(g_cfg->keys[i], g_cfg->mods[i], kname, sizeof(kname));
+    fprintf(f, "%s=%s\n", g_action_names[i], kname);
+  }
+  for (int i = 0; i < ACTION_COUNT; ++i) {
+    if (g_cfg->interval_us[i] == 0) continue;
+    fprintf(f, "%s%s=%u\n", g_action_names[i], CONFIG_INTERVAL_SUFFIX, g_cfg->interval_us[i]);
+    if (g_cfg->cps[i])
+      fprintf(f, "%s%s=%u\n", g_action_names[i], CONFIG_CPS_SUFFIX, g_cfg->cps[i]);
+    fprintf(f, "%s%s=%s\n", g_action_names[i], CONFIG_LATE_SUFFIX, g_late_names[g_cfg->late[i]]);
+  }
+  fprintf(f, "%s=%s\n", CONFIG_INJECTOR, g_cfg->uinput ? "uinput" : "native");
+  fprintf(f, "%s=%s\n", CONFIG_PAUSE_UNFOCUSED, g_cfg->pause_unfocused ? "yes" : "no");
+  fprintf(f, "%s=%s\n", CONFIG_MULTIBOX, g_cfg->multibox ? "yes" : "no");
+  fprintf(f, "%spriority=%s\n", CONFIG_WORKER_PREFIX, g_worker_prio_names[g_cfg->worker.priority]);
+  fprintf(f, "%spolicy=%s\n", CONFIG_WORKER_PREFIX, g_cfg->worker.rt_rr ? "rr" : "fifo");
+  fprintf(f, "%srt_priority=%d\n", CONFIG_WORKER_PREFIX, g_cfg->worker.rt_priority);
+  fprintf(f, "%snice=%d\n", CONFIG_WORKER_PREFIX, g_cfg->worker.nice);
+  fprintf(f, "%saffinity=0x%llx\n", CONFIG_WORKER_PREFIX, g_cfg->worker.affinity);
+  for (int i = 0; i < g_cfg->macro_count; ++i) {
+    int action = ACTION_MACRO_FIRST + i;
+    if (g_cfg->keys[action])
+      fprintf(f, "%s%s=%s\n", CONFIG_MACRO_PREFIX, g_cfg->macro_names[i],
+              hotkey_name(g_cfg->keys[action], g_cfg->mods[action], kname, sizeof(kname)));
+    fprintf(f, "%s%s%s=%s\n", CONFIG_MACRO_PREFIX, g_cfg->macro_names[i],
+            CONFIG_MACRO_SUFFIX, g_cfg->macro_src[i]);
+  }
+  fprintf(f, "%sinterval_us=%u\n", CONFIG_WATCH_PREFIX, g_cfg->watch_interval_us);
+  for (int i = 0; i < g_cfg->watch_count; ++i)
+    fprintf(f, "%s%s=%s\n", CONFIG_WATCH_PREFIX, g_cfg->watch_names[i], g_cfg->watch_src[i]);
 
-  XMoveResizeWindow(dpy, g_overlay_win, x, y, width, height);
-  XMapRaised(dpy, g_overlay_win);
+  fclose(f);
 }
 
-static void overlay_init(void) {
-  if (!dpy) return;
+//--------------- key resolution table ---------------
+//every key the tool injects or grabs is resolved to its hardware code once
+//(X11 KeyCode / Win32 scan code) and only refreshed when the keyboard
+//mapping changes, so the injection path is a plain table lookup
 
-  int screen = DefaultScreen(dpy);
-  Window root = RootWindow(dpy, screen);
+#define KEYTAB_MAX      64
+#define KEYTAB_EXTENDED 0x100   //Win32: scan code needs KEYEVENTF_EXTENDEDKEY
 
-  unsigned int width = OVERLAY_WIDTH_FULL;
-  unsigned int height = OVERLAY_HEIGHT;
+typedef struct {
+  int code;        //VK_* / XK_*
+  atomic_int hw;   //X11 KeyCode or Win32 scan code, 0 = not mapped
+} keytab_entry;
 
-  //if we do not have an ARGB visual yet (32‑bit with alpha), try to pick one now
-  if (!g_argb_visual) {
-    XVisualInfo vinfo;
-    if (XMatchVisualInfo(dpy, screen, 32, TrueColor, &vinfo)) {
-      g_argb_visual = vinfo.visual;
-      g_argb_depth = vinfo.depth;
-      g_argb_colormap = XCreateColormap(dpy, root, g_argb_visual, AllocNone);
-    }
-  }
+static keytab_entry g_keytab[KEYTAB_MAX];
+static int g_keytab_count = 0;   //only grown by the main thread
 
-  XSetWindowAttributes attrs;
-  unsigned long valuemask = 0;
+//fixed slots for the keys the worker injects
+enum {
+  KEY_SLOT_W = 0,
+  KEY_SLOT_S,
+  KEY_SLOT_FIXED
+};
 
-  if (g_argb_visual && g_argb_depth > 0 && g_argb_colormap) {
-    //create an ARGB window with fully transparent background
-    attrs.colormap = g_argb_colormap;
-    attrs.border_pixel = 0;
+#ifdef _WIN32
+  #define KEYTAB_CODE_W 'W'
+  #define KEYTAB_CODE_S 'S'
+#else
+  #define KEYTAB_CODE_W XK_w
+  #define KEYTAB_CODE_S XK_s
+#endif
+
+static int keytab_hw_lookup(int code);   //platform specific
+
+static int keytab_hw(int slot) {
+  return atomic_load_explicit(&g_keytab[slot].hw, memory_order_relaxed);
+}
+
+//return the slot of a key, adding and resolving it if needed (main thread only)
+static int keytab_intern(int code) {
+  for (int i = 0; i < g_keytab_count; ++i) {
+    if (g_keytab[i].code == code) return i;
+  }
+  if (g_keytab_count == KEYTAB_MAX) return -1;
+
+  int i = g_keytab_count;
+  g_keytab[i].code = code;
+  atomic_store_explicit(&g_keytab[i].hw, keytab_hw_lookup(code), memory_order_relaxed);
+  g_keytab_count = i + 1;
+  return i;
+}
+
+//re-resolve every known key after a mapping/layout change
+static void keytab_refresh(void) {
+  for (int i = 0; i < g_keytab_count; ++i) {
+    atomic_store_explicit(&g_keytab[i].hw, keytab_hw_lookup(g_keytab[i].code),
+                          memory_order_relaxed);
+  }
+}
+
+static void keytab_init(void) {
+  keytab_intern(KEYTAB_CODE_W);   //KEY_SLOT_W
+  keytab_intern(KEYTAB_CODE_S);   //KEY_SLOT_S
+}
+
+//--------------- batched input injection ---------------
+//events are collected into a small batch and handed to the platform in one
+//go: a single SendInput() on Windows, a single XFlush() on X11
+
+enum {
+  INJ_KEY = 0,    //code = keytab slot, down = 1/0
+  INJ_BUTTON,     //code = 0 left, 1 right
+  INJ_MOVE,       //absolute screen position x, y
+  INJ_KEY_HW      //code = hardware code (X11 KeyCode / Win32 scan code | KEYTAB_EXTENDED)
+};
+
+typedef struct {
+  int type;
+  int code;
+  int down;
+  int x, y;
+} inj_event;
+
+#define INJ_BATCH_MAX 16
+
+typedef struct {
+  int n;
+  inj_event ev[INJ_BATCH_MAX];
+} inj_batch;
+
+//an injection backend delivers a batch and empties it; the native one is
+//picked at startup, --bench swaps in the others
+typedef struct {
+  const char *name;
+  void (*send)(inj_batch *b);
+  int virtual_pointer;   //1: the pointer only exists in what this backend sent
+} inj_backend;
+
+static const inj_backend *g_inj_backend;   //set before the worker starts
+
+static void inj_send(inj_batch *b) {
+  if (b->n == 0) return;
+  g_inj_backend->send(b);
+}
+
+static void inj_begin(inj_batch *b) {
+  b->n = 0;
+}
+
+static inj_event *inj_push(inj_batch *b) {
+  if (b->n == INJ_BATCH_MAX) inj_send(b);
+  return &b->ev[b->n++];
+}
+
+static void inj_key(inj_batch *b, int key, int down) {
+  inj_event *e = inj_push(b);
+  e->type = INJ_KEY;
+  e->code = key;
+  e->down = down;
+}
+
+static void inj_button(inj_batch *b, int button, int down) {
+  inj_event *e = inj_push(b);
+  e->type = INJ_BUTTON;
+  e->code = button;
+  e->down = down;
+}
+
+static void inj_key_hw(inj_batch *b, int hw, int down) {
+  inj_event *e = inj_push(b);
+  e->type = INJ_KEY_HW;
+  e->code = hw;
+  e->down = down;
+}
+
+//---- pointer position and screen geometry ----
+//the worker remembers where it last put the pointer, and a macro move to
+//that point is dropped while the pointer is still seen there. Windows checks
+//with GetCursorPos every time (no round trip); on X11 XQueryPointer is a
+//round trip, so the point is trusted for INJ_POINTER_RECHECK_NS between
+//checks. a display change (WM_DISPLAYCHANGE, a root ConfigureNotify after a
+//RandR resize) bumps g_screen_gen: the remembered point is dropped and the
+//backends reload their cached coordinate transform.
+
+#ifdef _WIN32
+#define INJ_POINTER_RECHECK_NS 0ull
+#else
+#define INJ_POINTER_RECHECK_NS 50000000ull
+#endif
+
+static atomic_uint g_screen_gen = 1;   //bumped by the main thread
+
+typedef struct {
+  int valid;
+  int x, y;
+  unsigned int gen;    //g_screen_gen the point belongs to
+  uint64_t checked;    //now_ns() of the last check, 0 = never seen there
+} inj_pointer;
+
+static inj_pointer g_inj_ptr;   //worker thread
+
+static void inj_get_cursor(int *x, int *y);   //platform section
+
+static void screen_changed(void) {
+  atomic_fetch_add_explicit(&g_screen_gen, 1, memory_order_release);
+}
+
+static void inj_move(inj_batch *b, int x, int y) {
+  inj_event *e = inj_push(b);
+  e->type = INJ_MOVE;
+  e->x = x;
+  e->y = y;
+  g_inj_ptr.valid = 1;
+  g_inj_ptr.x = x;
+  g_inj_ptr.y = y;
+  g_inj_ptr.gen = atomic_load_explicit(&g_screen_gen, memory_order_relaxed);
+  g_inj_ptr.checked = 0;
+}
+
+//move unless the pointer is known to be there already
+static void inj_move_to(inj_batch *b, int x, int y, uint64_t now) {
+  inj_pointer *p = &g_inj_ptr;
+  if (p->valid && p->x == x && p->y == y &&
+      p->gen == atomic_load_explicit(&g_screen_gen, memory_order_relaxed)) {
+    //nothing else moves a pointer that only the targets see
+    if (g_inj_backend->virtual_pointer) return;
+    if (p->checked && now - p->checked < INJ_POINTER_RECHECK_NS) return;
+    int cx, cy;
+    inj_get_cursor(&cx, &cy);
+    if (cx == x && cy == y) {
+      p->checked = now;
+      return;
+    }
+  }
+  inj_move(b, x, y);
+  p->checked = now;
+}
+
+//--------------- macro engine ---------------
+//every action that drives input is a macro: a short program compiled once
+//into a preallocated instruction pool. the worker steps the programs on
+//absolute deadlines; running them is a switch over fixed-size instructions,
+//with no allocation or parsing after startup.
+//
+//config syntax, steps separated by ';':
+//  click [x y]      left click at x,y (no coordinates: the point saved when
+//  rclick [x y]     the macro was started)
+//  move x y         move the pointer
+//  down T / up T    press / release T (a key name, LMB or RMB)
+//  tap T            press and release T
+//  hold T <dur>     press T, wait, release
+//  wait <dur>       e.g. 12ms, 500us, 1s (a plain number is ms)
+//  loop             start over (last step, needs a wait in the body)
+
+enum {
+  OP_END = 0,      //macro finished
+  OP_LOOP,         //start over from the first instruction
+  OP_KEY,          //a = keytab slot, b = down
+  OP_BUTTON,       //a = 0 left / 1 right, b = down
+  OP_MOVE,         //a, b = absolute screen position
+  OP_MOVE_SAVED,   //move to the point saved when the macro was started
+  OP_WAIT,         //a = microseconds
+  OP_WAIT_RATE,    //wait the action's configured interval
+  OP_PARK          //stay until the macro is stopped (hold actions)
+};
+
+typedef struct {
+  uint8_t op;
+  int32_t a, b;
+} macro_insn;
+
+enum {
+  MACRO_F_SAVED_POS = 1u << 0,   //save the cursor position when started
+  MACRO_F_RATE      = 1u << 1    //report the achieved loop rate
+};
+
+typedef struct {
+  uint16_t start, len;   //range in the set's code, len 0 = not a macro
+  uint32_t bit;          //ST_* flag that runs it
+  unsigned int flags;    //MACRO_F_*
+} macro_def;
+
+#define MACRO_CODE_MAX    512
+#define MACRO_HELD_MAX    8
+#define MACRO_STEP_BUDGET 64   //instructions per macro per worker pass
+#define RATE_CATCHUP_MAX_NS 50000000ull   //late=catchup: backlog run back to back
+
+//one compiled config. the main thread builds a set, then hands it to the
+//worker and never writes it again; runs keep the set they started on, so a
+//reload does not disturb a macro that is running
+typedef struct {
+  macro_insn code[MACRO_CODE_MAX];
+  int used;
+  macro_def defs[ACTION_MAX];
+  int refs;   //worker only: runs on this set, +1 while it is the current one
+} macro_set;
+
+static macro_set *g_macro_build = NULL;   //main thread: set being compiled
+static macro_set *g_macro_main = NULL;    //main thread: newest set (HUD, hotkeys)
+
+static int macro_emit(int op, int a, int b) {
+  if (g_macro_build->used == MACRO_CODE_MAX) return 0;
+  macro_insn *in = &g_macro_build->code[g_macro_build->used++];
+  in->op = (uint8_t)op;
+  in->a = a;
+  in->b = b;
+  return 1;
+}
+
+//"12ms", "500us", "1s", "20" (ms); returns 0 on error
+static int parse_duration_us(const char *s, unsigned int *us) {
+  char *end = NULL;
+  unsigned long v = strtoul(s, &end, 10);
+  if (end == s) return 0;
+  unsigned long mul = 1000;
+  if (*end == '\0' || strcmp(end, "ms") == 0) mul = 1000;
+  else if (strcmp(end, "us") == 0) mul = 1;
+  else if (strcmp(end, "s") == 0) mul = 1000000;
+  else return 0;
+  if (v > 0xFFFFFFFFul / mul) return 0;
+  *us = (unsigned int)(v * mul);
+  return 1;
+}
+
+//emit a press/release of T: LMB, RMB or a key
+static int macro_emit_input(const char *t, int down) {
+  char up[16];
+  snprintf(up, sizeof(up), "%s", t);
+  strtoupper_simple(up);
+  if (strcmp(up, "LMB") == 0) return macro_emit(OP_BUTTON, 0, down);
+  if (strcmp(up, "RMB") == 0) return macro_emit(OP_BUTTON, 1, down);
+
+  int code = key_code_from_name(t);
+  int slot = code ? keytab_intern(code) : -1;
+  if (slot < 0) return 0;
+  return macro_emit(OP_KEY, slot, down);
+}
+
+//compile one step; returns 0 on a syntax error or a full pool
+static int macro_compile_step(macro_def *def, char *step, int *waits, int *looped) {
+  char w0[32], w1[32], w2[32];
+  w0[0] = w1[0] = w2[0] = '\0';
+  int n = sscanf(step, "%31s %31s %31s", w0, w1, w2);
+  if (n <= 0) return 1;   //empty step
+  if (*looped) return 0;  //nothing may follow "loop"
+  unsigned int us = 0;
+
+  if (strcmp(w0, "click") == 0 || strcmp(w0, "rclick") == 0) {
+    int button = (w0[0] == 'r') ? 1 : 0;
+    if (n == 3) {
+      if (!macro_emit(OP_MOVE, atoi(w1), atoi(w2))) return 0;
+    } else if (n == 1) {
+      def->flags |= MACRO_F_SAVED_POS;
+      if (!macro_emit(OP_MOVE_SAVED, 0, 0)) return 0;
+    } else {
+      return 0;
+    }
+    return macro_emit(OP_BUTTON, button, 1) && macro_emit(OP_BUTTON, button, 0);
+  }
+  if (strcmp(w0, "move") == 0 && n == 3)
+    return macro_emit(OP_MOVE, atoi(w1), atoi(w2));
+  if (strcmp(w0, "down") == 0 && n == 2)
+    return macro_emit_input(w1, 1);
+  if (strcmp(w0, "up") == 0 && n == 2)
+    return macro_emit_input(w1, 0);
+  if (strcmp(w0, "tap") == 0 && n == 2)
+    return macro_emit_input(w1, 1) && macro_emit_input(w1, 0);
+  if (strcmp(w0, "hold") == 0 && n == 3 && parse_duration_us(w2, &us)) {
+    if (us > 0) ++*waits;
+    return macro_emit_input(w1, 1) && macro_emit(OP_WAIT, (int)us, 0) &&
+           macro_emit_input(w1, 0);
+  }
+  if (strcmp(w0, "wait") == 0 && n == 2 && parse_duration_us(w1, &us)) {
+    if (us > 0) ++*waits;
+    return macro_emit(OP_WAIT, (int)us, 0);
+  }
+  if (strcmp(w0, "loop") == 0 && n == 1) {
+    *looped = 1;
+    return macro_emit(OP_LOOP, 0, 0);
+  }
+  return 0;
+}
+
+//compile a user macro from its config source
+static void macro_compile(int action, const char *src) {
+  macro_def *def = &g_macro_build->defs[action];
+  const char *name = g_action_names[action];
+  int start = g_macro_build->used;
+  int waits = 0, looped = 0;
+  def->flags = 0;
+
+  char buf[MACRO_SRC_MAX];
+  snprintf(buf, sizeof(buf), "%s", src);
+  for (char *step = buf; step; ) {
+    char *next = strchr(step, ';');
+    if (next) *next++ = '\0';
+    if (!macro_compile_step(def, step, &waits, &looped)) {
+      fprintf(stderr, "Warning: macro '%s': cannot compile step '%s'\n", name, trim(step));
+      g_macro_build->used = start;
+      def->len = 0;
+      return;
+    }
+    step = next;
+  }
+  //a loop without time passing would never yield to the scheduler
+  if (looped && waits == 0) {
+    fprintf(stderr, "Warning: macro '%s': loop without a wait, ignored\n", name);
+    g_macro_build->used = start;
+    def->len = 0;
+    return;
+  }
+  if (!looped && !macro_emit(OP_END, 0, 0)) {
+    fprintf(stderr, "Warning: macro '%s': instruction pool full\n", name);
+    g_macro_build->used = start;
+    def->len = 0;
+    return;
+  }
+  def->start = (uint16_t)start;
+  def->len = (uint16_t)(g_macro_build->used - start);
+}
+
+//built-in actions expressed as macros
+static void macro_builtin(int action, uint32_t bit, unsigned int flags) {
+  macro_def *def = &g_macro_build->defs[action];
+  def->start = (uint16_t)g_macro_build->used;
+  def->bit = bit;
+  def->flags = flags;
+  switch (action) {
+    case ACTION_SPAM_LMB:
+      macro_emit(OP_MOVE_SAVED, 0, 0);
+      macro_emit(OP_BUTTON, 0, 1);
+      macro_emit(OP_BUTTON, 0, 0);
+      macro_emit(OP_WAIT_RATE, 0, 0);
+      macro_emit(OP_LOOP, 0, 0);
+      break;
+    case ACTION_HOLD_W:
+      macro_emit(OP_KEY, KEY_SLOT_W, 1);
+      macro_emit(OP_PARK, 0, 0);
+      break;
+    case ACTION_HOLD_S:
+      macro_emit(OP_KEY, KEY_SLOT_S, 1);
+      macro_emit(OP_PARK, 0, 0);
+      break;
+    case ACTION_HOLD_RMB:
+      macro_emit(OP_BUTTON, 1, 1);
+      macro_emit(OP_PARK, 0, 0);
+      break;
+    case ACTION_HOLD_LMB:
+      macro_emit(OP_BUTTON, 0, 1);
+      macro_emit(OP_PARK, 0, 0);
+      break;
+    default:
+      break;
+  }
+  def->len = (uint16_t)(g_macro_build->used - def->start);
+}
+
+//compile every macro of g_cfg into a new set, which becomes g_macro_main;
+//needs keytab_init() (fixed key slots) first. returns NULL when out of memory
+static macro_set *macro_build_all(void) {
+  macro_set *set = calloc(1, sizeof(*set));
+  if (!set) return NULL;
+  g_macro_build = set;
+
+  macro_builtin(ACTION_SPAM_LMB, ST_SPAM, MACRO_F_SAVED_POS | MACRO_F_RATE);
+  macro_builtin(ACTION_HOLD_W,   ST_HOLD_W, 0);
+  macro_builtin(ACTION_HOLD_S,   ST_HOLD_S, 0);
+  macro_builtin(ACTION_HOLD_RMB, ST_HOLD_RMB, 0);
+  macro_builtin(ACTION_HOLD_LMB, ST_HOLD_LMB, 0);
+
+  for (int i = 0; i < g_cfg->macro_count; ++i) {
+    int action = ACTION_MACRO_FIRST + i;
+    g_macro_build->defs[action].bit = ST_MACRO(i);
+    if (g_cfg->macro_src[i][0] == '\0') {
+      fprintf(stderr, "Warning: macro '%s' has no '%s%s%s' line\n", g_cfg->macro_names[i],
+              CONFIG_MACRO_PREFIX, g_cfg->macro_names[i], CONFIG_MACRO_SUFFIX);
+      continue;
+    }
+    macro_compile(action, g_cfg->macro_src[i]);
+  }
+  g_macro_build = NULL;
+  g_macro_main = set;
+  return set;
+}
+
+//---- macro runtime (worker thread only) ----
+
+typedef struct {
+  int active;            //started and not finished/stopped
+  int paused;            //suspended: held input released, position kept
+  int pc;
+  uint64_t deadline;     //next instruction due, WAIT_FOREVER while parked
+  uint64_t remaining;    //time left on the current wait when paused
+  uint64_t interval_ns;  //OP_WAIT_RATE
+  int late;              //LATE_*: what OP_WAIT_RATE does after falling behind
+  int save_x, save_y;    //OP_MOVE_SAVED
+  int held_keys[MACRO_HELD_MAX];
+  int n_held_keys;
+  unsigned int held_buttons;   //bit 0 left, bit 1 right
+  uint64_t loops, run_start, last_loop;
+  uint64_t dropped;      //repetitions dropped since run_start
+  macro_set *set;        //the set the run started on
+} macro_run;
+
+static macro_run g_macro_runs[ACTION_MAX];
+static macro_set *g_macro_cur = NULL;    //set new runs start on
+
+static void macro_set_release(macro_set *set) {
+  if (set && --set->refs == 0) free(set);
+}
+
+//adopt a set the main thread built; the old one lives on while runs use it
+static void macro_set_adopt(macro_set *set) {
+  set->refs = 1;
+  macro_set_release(g_macro_cur);
+  g_macro_cur = set;
+}
+
+//print achieved vs target rate once a repeating run ends
+//(elapsed_ns = first to last repetition, so N clicks span N-1 intervals)
+static void report_macro_rate(const char *name, uint64_t clicks, uint64_t elapsed_ns,
+                              uint64_t interval_ns, uint64_t dropped) {
+  if (clicks < 2 || elapsed_ns == 0 || interval_ns == 0) return;
+  double secs = (double)elapsed_ns / 1e9;
+  double achieved = (double)(clicks - 1) / secs;
+  double target = 1e9 / (double)interval_ns;
+  printf("%s: %llu clicks in %.2f s, %.2f clicks/s (target %.2f clicks/s)",
+         name, (unsigned long long)clicks, secs, achieved, target);
+  if (dropped) printf(", %llu dropped", (unsigned long long)dropped);
+  printf("\n");
+  fflush(stdout);
+}
+
+static void macro_track_key(macro_run *r, int slot, int down) {
+  for (int i = 0; i < r->n_held_keys; ++i) {
+    if (r->held_keys[i] != slot) continue;
+    if (!down) r->held_keys[i] = r->held_keys[--r->n_held_keys];
+    return;
+  }
+  if (down && r->n_held_keys < MACRO_HELD_MAX) r->held_keys[r->n_held_keys++] = slot;
+}
+
+//release (down = 0) or press again (down = 1) whatever the run holds
+static void macro_sync_held(macro_run *r, inj_batch *b, int down) {
+  for (int i = 0; i < r->n_held_keys; ++i) inj_key(b, r->held_keys[i], down);
+  if (r->held_buttons & 1u) inj_button(b, 0, down);
+  if (r->held_buttons & 2u) inj_button(b, 1, down);
+}
+
+static void macro_start(macro_run *r, macro_set *set, uint64_t now) {
+  r->set = set;
+  ++set->refs;
+  r->active = 1;
+  r->paused = 0;
+  r->pc = 0;
+  r->deadline = now;
+  r->n_held_keys = 0;
+  r->held_buttons = 0;
+  r->loops = 0;
+  r->run_start = now;
+  r->last_loop = now;
+  r->dropped = 0;
+}
+
+static void macro_report(int action, macro_run *r) {
+  if (r->set->defs[action].flags & MACRO_F_RATE)
+    report_macro_rate(g_action_names[action], r->loops + 1, r->last_loop - r->run_start,
+                      r->interval_ns, r->dropped);
+}
+
+static void macro_stop(int action, macro_run *r, inj_batch *b) {
+  //a paused run has already released its input and reported
+  if (!r->paused) {
+    macro_sync_held(r, b, 0);
+    macro_report(action, r);
+  }
+  r->n_held_keys = 0;
+  r->held_buttons = 0;
+  r->active = 0;
+  r->paused = 0;
+  macro_set_release(r->set);
+  r->set = NULL;
+}
+
+static void macro_pause(int action, macro_run *r, inj_batch *b, uint64_t now) {
+  macro_sync_held(r, b, 0);
+  r->remaining = (r->deadline != WAIT_FOREVER && r->deadline > now) ? r->deadline - now : 0;
+  r->paused = 1;
+  macro_report(action, r);
+}
+
+static void macro_resume(macro_run *r, inj_batch *b, uint64_t now) {
+  macro_sync_held(r, b, 1);
+  if (r->deadline != WAIT_FOREVER) r->deadline = now + r->remaining;
+  r->paused = 0;
+  r->loops = 0;
+  r->run_start = now;
+  r->last_loop = now;
+  r->dropped = 0;
+}
+
+//run instructions that are due; returns 1 when the macro ended by itself
+static int macro_step(int action, macro_run *r, inj_batch *b, uint64_t now) {
+  const macro_def *def = &r->set->defs[action];
+  const macro_insn *code = &r->set->code[def->start];
+
+  if (r->deadline != WAIT_FOREVER && r->deadline <= now)
+    hist_record(&g_hist_late, now - r->deadline);
+
+  for (int budget = MACRO_STEP_BUDGET; budget > 0; --budget) {
+    if (r->deadline == WAIT_FOREVER || r->deadline > now) return 0;
+    const macro_insn *in = &code[r->pc];
+    switch (in->op) {
+      case OP_KEY:
+        inj_key(b, in->a, in->b);
+        macro_track_key(r, in->a, in->b);
+        ++r->pc;
+        break;
+      case OP_BUTTON:
+        inj_button(b, in->a, in->b);
+        if (in->b) r->held_buttons |= 1u << in->a;
+        else       r->held_buttons &= ~(1u << in->a);
+        ++r->pc;
+        break;
+      case OP_MOVE:
+        inj_move_to(b, in->a, in->b, now);
+        ++r->pc;
+        break;
+      case OP_MOVE_SAVED:
+        inj_move_to(b, r->save_x, r->save_y, now);
+        ++r->pc;
+        break;
+      case OP_WAIT: {
+        uint64_t w = (uint64_t)(uint32_t)in->a * 1000ull;
+        //stay on the original grid; if we fell more than a whole wait
+        //behind, skip the missed ticks instead of bursting to catch up
+        r->deadline += w;
+        if (w > 0 && r->deadline <= now)
+          r->deadline += ((now - r->deadline) / w + 1) * w;
+        ++r->pc;
+      } break;
+      case OP_WAIT_RATE: {
+        uint64_t w = r->interval_ns;
+        r->deadline += w;
+        if (w > 0 && r->deadline <= now) {
+          //due is the number of repetitions whose time has come. coalesce
+          //runs one of them now and drops the rest; catchup runs them back
+          //to back, up to RATE_CATCHUP_MAX_NS worth, and drops only older ones
+          uint64_t due = (now - r->deadline) / w + 1;
+          uint64_t keep = 1;
+          if (r->late == LATE_CATCHUP) {
+            keep = RATE_CATCHUP_MAX_NS / w;
+            if (keep < 1) keep = 1;
+            if (keep > due) keep = due;
+            //the next one runs late; the ones after it see a smaller backlog
+            if (def->flags & MACRO_F_RATE)
+              atomic_fetch_add_explicit(&g_rate[action].caught_up, 1, memory_order_relaxed);
+          }
+          r->deadline += (due - keep) * w;
+          r->dropped += due - keep;
+          if (def->flags & MACRO_F_RATE)
+            atomic_fetch_add_explicit(&g_rate[action].dropped, due - keep, memory_order_relaxed);
+        }
+        ++r->pc;
+      } break;
+      case OP_LOOP:
+        r->pc = 0;
+        ++r->loops;
+        r->last_loop = now;
+        if (def->flags & MACRO_F_RATE)
+          atomic_fetch_add_explicit(&g_rate[action].ticks, 1, memory_order_relaxed);
+        break;
+      case OP_PARK:
+        r->deadline = WAIT_FOREVER;
+        return 0;
+      case OP_END:
+      default:
+        macro_stop(action, r, b);
+        return 1;
+    }
+  }
+  //budget used up without a wait (cannot happen for compiled loops); yield
+  return 0;
+}
+
+//--------------- input recording ---------------
+//capture callbacks stamp each event with now_ns() and push it into a
+//preallocated lock-free ring; stopping the recording writes the ring out as
+//fixed 16-byte records behind a small header. replay maps the file and the
+//worker streams the records into the injection batch on deadlines taken
+//from the timestamps, so a recording is never parsed or copied.
+
+#define REC_FILE    "foxtool_record.bin"
+#define REC_MAGIC   "FXREC\0\0\0"
+#define REC_VERSION 1u
+
+enum {
+  REC_KEY = 0,   //code = hardware code (X11 KeyCode / Win32 scan code | KEYTAB_EXTENDED)
+  REC_BUTTON,    //code = 0 left, 1 right
+  REC_MOVE       //x, y = absolute screen position
+};
+
+typedef struct {
+  uint64_t t_ns;   //since the start of the recording
+  uint8_t type;
+  uint8_t down;
+  uint16_t code;
+  int16_t x, y;
+} rec_event;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t count;
+  uint64_t reserved;
+} rec_header;
+
+_Static_assert(sizeof(rec_event) == 16, "rec_event must stay a fixed 16-byte record");
+_Static_assert(sizeof(rec_header) % 16 == 0, "records must stay aligned after the header");
+
+//---- capture ring: single producer (hook / record thread), single consumer ----
+
+#define REC_RING_SIZE (1u << 18)   //power of two, ~4 MB, minutes of mouse motion
+
+static struct {
+  _Alignas(64) atomic_uint head;
+  _Alignas(64) atomic_uint tail;
+  rec_event slots[REC_RING_SIZE];
+} g_rec_ring;
+
+static uint64_t g_rec_start = 0;      //now_ns() when recording started
+static atomic_uint g_rec_dropped = 0;
+
+static void rec_push(int type, int code, int down, int x, int y) {
+  unsigned int head = atomic_load_explicit(&g_rec_ring.head, memory_order_relaxed);
+  unsigned int tail = atomic_load_explicit(&g_rec_ring.tail, memory_order_acquire);
+  if (head - tail == REC_RING_SIZE) {
+    atomic_fetch_add_explicit(&g_rec_dropped, 1, memory_order_relaxed);
+    return;
+  }
+  rec_event *e = &g_rec_ring.slots[head & (REC_RING_SIZE - 1)];
+  e->t_ns = now_ns() - g_rec_start;
+  e->type = (uint8_t)type;
+  e->down = (uint8_t)down;
+  e->code = (uint16_t)code;
+  e->x = (int16_t)x;
+  e->y = (int16_t)y;
+  atomic_store_explicit(&g_rec_ring.head, head + 1, memory_order_release);
+}
+
+static void rec_ring_reset(void) {
+  atomic_store(&g_rec_ring.head, 0);
+  atomic_store(&g_rec_ring.tail, 0);
+  atomic_store(&g_rec_dropped, 0);
+}
+
+//write everything captured so far; returns the number of records or -1
+static long rec_write_file(const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (!f) return -1;
+
+  unsigned int tail = atomic_load_explicit(&g_rec_ring.tail, memory_order_relaxed);
+  unsigned int head = atomic_load_explicit(&g_rec_ring.head, memory_order_acquire);
+
+  rec_header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, REC_MAGIC, sizeof(h.magic));
+  h.version = REC_VERSION;
+  h.record_size = sizeof(rec_event);
+  h.count = head - tail;
+  int ok = fwrite(&h, sizeof(h), 1, f) == 1;
+
+  //the ring may wrap: at most two contiguous runs
+  while (ok && tail != head) {
+    unsigned int idx = tail & (REC_RING_SIZE - 1);
+    unsigned int run = head - tail;
+    if (run > REC_RING_SIZE - idx) run = REC_RING_SIZE - idx;
+    ok = fwrite(&g_rec_ring.slots[idx], sizeof(rec_event), run, f) == run;
+    tail += run;
+  }
+  atomic_store_explicit(&g_rec_ring.tail, tail, memory_order_release);
+
+  if (fclose(f) != 0) ok = 0;
+  return ok ? (long)h.count : -1;
+}
+
+//validate a mapped recording; returns its records or NULL
+static const rec_event *rec_check_map(const void *base, size_t len, size_t *count) {
+  const rec_header *h = (const rec_header *)base;
+  if (len < sizeof(*h) || memcmp(h->magic, REC_MAGIC, sizeof(h->magic)) != 0) return NULL;
+  if (h->version != REC_VERSION || h->record_size != sizeof(rec_event)) return NULL;
+  if (h->count > (len - sizeof(*h)) / sizeof(rec_event)) return NULL;
+  *count = (size_t)h->count;
+  return (const rec_event *)(h + 1);
+}
+
+//---- replay runtime (worker thread only) ----
+
+#define REPLAY_HW_KEYS 512   //covers X11 KeyCodes and Win32 scan codes | KEYTAB_EXTENDED
+
+typedef struct {
+  const void *map;        //mapped file, owned (and unmapped) by the worker
+  size_t map_len;
+  const rec_event *ev;
+  size_t n, i;
+  int active, paused;
+  uint64_t base;          //now_ns() matching t_ns = 0
+  uint64_t paused_at;
+  uint64_t deadline;      //due time of ev[i]
+  uint8_t keys_down[REPLAY_HW_KEYS / 8];
+  unsigned int buttons_down;
+} replay_run;
+
+static replay_run g_replay;
+
+static void rec_unmap(const void *base, size_t len);   //platform specific
+
+static void replay_sync_held(replay_run *rp, inj_batch *b, int down) {
+  for (int k = 0; k < REPLAY_HW_KEYS; ++k) {
+    if (rp->keys_down[k >> 3] & (1u << (k & 7))) inj_key_hw(b, k, down);
+  }
+  if (rp->buttons_down & 1u) inj_button(b, 0, down);
+  if (rp->buttons_down & 2u) inj_button(b, 1, down);
+}
+
+static void replay_start(replay_run *rp, uint64_t now) {
+  rp->active = 1;
+  rp->paused = 0;
+  rp->i = 0;
+  rp->base = now;
+  rp->deadline = now;
+  memset(rp->keys_down, 0, sizeof(rp->keys_down));
+  rp->buttons_down = 0;
+}
+
+static void replay_stop(replay_run *rp, inj_batch *b) {
+  if (!rp->paused) replay_sync_held(rp, b, 0);
+  memset(rp->keys_down, 0, sizeof(rp->keys_down));
+  rp->buttons_down = 0;
+  rp->active = 0;
+  rp->paused = 0;
+}
+
+static void replay_pause(replay_run *rp, inj_batch *b, uint64_t now) {
+  replay_sync_held(rp, b, 0);
+  rp->paused_at = now;
+  rp->paused = 1;
+}
+
+static void replay_resume(replay_run *rp, inj_batch *b, uint64_t now) {
+  replay_sync_held(rp, b, 1);
+  //the paused time does not count
+  rp->base += now - rp->paused_at;
+  rp->deadline += now - rp->paused_at;
+  rp->paused = 0;
+}
+
+//hand over a newly mapped recording, dropping the previous one
+static void replay_load(replay_run *rp, inj_batch *b, const void *map, size_t len) {
+  if (rp->active) replay_stop(rp, b);
+  if (rp->map) rec_unmap(rp->map, rp->map_len);
+  rp->map = map;
+  rp->map_len = len;
+  rp->ev = rec_check_map(map, len, &rp->n);
+  if (!rp->ev) rp->n = 0;
+}
+
+//inject every record that is due; returns 1 when the recording is done
+static int replay_step(replay_run *rp, inj_batch *b, uint64_t now) {
+  while (rp->i < rp->n) {
+    const rec_event *e = &rp->ev[rp->i];
+    uint64_t due = rp->base + e->t_ns;
+    if (due > now) {
+      rp->deadline = due;
+      return 0;
+    }
+    switch (e->type) {
+      case REC_KEY:
+        if (e->code >= REPLAY_HW_KEYS) break;
+        inj_key_hw(b, e->code, e->down);
+        if (e->down) rp->keys_down[e->code >> 3] |= (uint8_t)(1u << (e->code & 7));
+        else         rp->keys_down[e->code >> 3] &= (uint8_t)~(1u << (e->code & 7));
+        break;
+      case REC_BUTTON:
+        if (e->code > 1) break;
+        inj_button(b, e->code, e->down);
+        if (e->down) rp->buttons_down |= 1u << e->code;
+        else         rp->buttons_down &= ~(1u << e->code);
+        break;
+      case REC_MOVE:
+        inj_move(b, e->x, e->y);
+        break;
+      default:
+        break;
+    }
+    ++rp->i;
+  }
+  replay_stop(rp, b);
+  return 1;
+}
+
+//--------------- system input and overlay handling ---------------
+
+#ifdef _WIN32
+//---------------- Windows input and overlay -----------------
+
+//main overlay window handles on Windows
+static HWND g_overlay_hwnd = NULL;
+static HWND g_war_hwnd = NULL;
+static HFONT g_overlay_font = NULL;
+
+//F11 toggles overlay visibility
+#define VK_HIDE_OVERLAY   VK_F11
+
+#ifndef MAPVK_VK_TO_VSC_EX
+  #define MAPVK_VK_TO_VSC_EX 4
+#endif
+
+//layout the scan codes in g_keytab were resolved for
+static HKL g_keytab_layout = NULL;
+
+static int keytab_hw_lookup(int vk) {
+  //MAPVK_VK_TO_VSC_EX puts 0xE0 in the high byte for extended keys
+  UINT sc = MapVirtualKeyExA((UINT)vk, MAPVK_VK_TO_VSC_EX, g_keytab_layout);
+  int hw = (int)(sc & 0xFFu);
+  if (hw && (sc & 0xFF00u) == 0xE000u) hw |= KEYTAB_EXTENDED;
+  return hw;
+}
+
+//scan codes depend on the layout of the game, i.e. the foreground thread;
+//called when a hotkey arrives so a layout switch is picked up before injecting
+static void keytab_check_layout(void) {
+  HWND fg = GetForegroundWindow();
+  HKL hkl = GetKeyboardLayout(fg ? GetWindowThreadProcessId(fg, NULL) : 0);
+  if (hkl == g_keytab_layout) return;
+  g_keytab_layout = hkl;
+  keytab_refresh();
+}
+
+static void win_fill_key_hw(INPUT *in, int hw, int down) {
+  //scan code events are what games reading raw input expect
+  in->type = INPUT_KEYBOARD;
+  in->ki.wScan = (WORD)(hw & 0xFF);
+  in->ki.dwFlags = KEYEVENTF_SCANCODE | ((hw & KEYTAB_EXTENDED) ? KEYEVENTF_EXTENDEDKEY : 0);
+  if (!down) in->ki.dwFlags |= KEYEVENTF_KEYUP;
+}
+
+static void win_fill_key(INPUT *in, int slot, int down) {
+  int hw = keytab_hw(slot);
+  if (hw) {
+    win_fill_key_hw(in, hw, down);
+    return;
+  }
+  in->type = INPUT_KEYBOARD;
+  in->ki.wVk = (WORD)g_keytab[slot].code;
+  if (!down) in->ki.dwFlags |= KEYEVENTF_KEYUP;
+}
+
+static void win_fill_mouse_btn(INPUT *in, int button, int down) {
+  //button: 0=left 1=right
+  in->type = INPUT_MOUSE;
+  if (button == 0) in->mi.dwFlags = down ? MOUSEEVENTF_LEFTDOWN  : MOUSEEVENTF_LEFTUP;
+  else             in->mi.dwFlags = down ? MOUSEEVENTF_RIGHTDOWN : MOUSEEVENTF_RIGHTUP;
+}
+
+//virtual desktop rectangle for absolute moves, reloaded after a display change
+static struct {
+  unsigned int gen;
+  int x, y;
+  int w1, h1;   //width - 1, height - 1 (at least 1)
+} g_win_vscreen;
+
+static void win_fill_move_abs(INPUT *in, int x, int y) {
+  unsigned int gen = atomic_load_explicit(&g_screen_gen, memory_order_acquire);
+  if (g_win_vscreen.gen != gen) {
+    g_win_vscreen.gen = gen;
+    g_win_vscreen.x = GetSystemMetrics(SM_XVIRTUALSCREEN);
+    g_win_vscreen.y = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    g_win_vscreen.w1 = GetSystemMetrics(SM_CXVIRTUALSCREEN) - 1;
+    g_win_vscreen.h1 = GetSystemMetrics(SM_CYVIRTUALSCREEN) - 1;
+    if (g_win_vscreen.w1 < 1) g_win_vscreen.w1 = 1;
+    if (g_win_vscreen.h1 < 1) g_win_vscreen.h1 = 1;
+  }
+  //absolute 0..65535 over the whole virtual desktop, rounded to the nearest unit
+  in->type = INPUT_MOUSE;
+  in->mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK;
+  in->mi.dx = (LONG)(((int64_t)(x - g_win_vscreen.x) * 65535 + g_win_vscreen.w1 / 2) /
+                     g_win_vscreen.w1);
+  in->mi.dy = (LONG)(((int64_t)(y - g_win_vscreen.y) * 65535 + g_win_vscreen.h1 / 2) /
+                     g_win_vscreen.h1);
+}
+
+static void win_fill_event(INPUT *in, const inj_event *e) {
+  switch (e->type) {
+    case INJ_KEY:    win_fill_key(in, e->code, e->down); break;
+    case INJ_BUTTON: win_fill_mouse_btn(in, e->code, e->down); break;
+    case INJ_MOVE:   win_fill_move_abs(in, e->x, e->y); break;
+    case INJ_KEY_HW: win_fill_key_hw(in, e->code, e->down); break;
+    default: break;
+  }
+}
+
+//one SendInput call for the whole batch
+static void inj_send_native(inj_batch *b) {
+  INPUT in[INJ_BATCH_MAX];
+  ZeroMemory(in, sizeof(INPUT) * (size_t)b->n);
+  for (int i = 0; i < b->n; ++i) win_fill_event(&in[i], &b->ev[i]);
+  SendInput((UINT)b->n, in, sizeof(INPUT));
+  b->n = 0;
+}
+
+//one SendInput call per event (benchmark reference)
+static void inj_send_single(inj_batch *b) {
+  for (int i = 0; i < b->n; ++i) {
+    INPUT in;
+    ZeroMemory(&in, sizeof(in));
+    win_fill_event(&in, &b->ev[i]);
+    SendInput(1, &in, sizeof(INPUT));
+  }
+  b->n = 0;
+}
+
+static const inj_backend g_inj_native = { "SendInput batched", inj_send_native, 0 };
+static const inj_backend g_inj_single = { "SendInput per event", inj_send_single, 0 };
+
+static void win_get_cursor(int *x, int *y) {
+  POINT p;
+  GetCursorPos(&p);
+  *x = (int)p.x;
+  *y = (int)p.y;
+}
+
+static void inj_get_cursor(int *x, int *y) {
+  win_get_cursor(x, y);
+}
+
+//move and resize overlay to match the game window
+static void overlay_reposition_win(void) {
+  if (!g_overlay_hwnd || !g_war_hwnd) return;
+
+  RECT rc;
+  if (!GetWindowRect(g_war_hwnd, &rc)) return;
+
+  int x = rc.left;
+  int y = 0;
+  int width  = (int)OVERLAY_WIDTH_FULL;
+  int height = (int)OVERLAY_HEIGHT;
+
+  MoveWindow(g_overlay_hwnd, x, y, width, height, FALSE);
+}
+
+#else
+//---------------- Linux (X11) input and overlay ----------------
+static Display *dpy = NULL;
+
+//overlay window and target game window (Linux/X11)
+static Window g_overlay_win = 0;
+static Window g_foxhole_win = 0;
+static XFontStruct *g_overlay_font = NULL;
+static XftFont *g_overlay_xft = NULL;   //antialiased glyphs for the XRender path
+static Visual *g_argb_visual = NULL;
+static int g_argb_depth = 0;
+static Colormap g_argb_colormap = 0;
+static GC g_overlay_gc = 0;
+static unsigned long g_overlay_white_pixel = 0;
+
+//overlay size as last set by us (no XGetWindowAttributes round trip per frame)
+static unsigned int g_overlay_w = OVERLAY_WIDTH_FULL;
+static unsigned int g_overlay_h = OVERLAY_HEIGHT;
+
+//cached HUD text and metrics for g_overlay_gen
+static unsigned int g_overlay_gen = 0;
+static const char *g_overlay_text = "";   //hud_compose span
+static int g_overlay_text_len = 0;
+static unsigned int g_overlay_clear_w = 0;
+static unsigned int g_overlay_clear_h = 0;
+
+//F11 toggles overlay visibility
+#define KS_HIDE_OVERLAY   XK_F11
+
+static void x11_get_cursor(int *x, int *y) {
+  Window root = DefaultRootWindow(dpy);
+  Window ret_root, ret_child;
+  int root_x, root_y, win_x, win_y;
+  unsigned int mask;
+  XQueryPointer(dpy, root, &ret_root, &ret_child, &root_x, &root_y, &win_x, &win_y, &mask);
+  *x = root_x;
+  *y = root_y;
+}
+
+//root window size after a RandR resize, 0 = as at startup (main thread writes)
+static atomic_int g_screen_w = 0;
+static atomic_int g_screen_h = 0;
+
+static void x11_screen_changed(int w, int h) {
+  atomic_store_explicit(&g_screen_w, w, memory_order_relaxed);
+  atomic_store_explicit(&g_screen_h, h, memory_order_relaxed);
+  screen_changed();
+}
+
+static int keytab_hw_lookup(int keysym) {
+  return dpy ? (int)XKeysymToKeycode(dpy, (KeySym)keysym) : 0;
+}
+
+//the x11_* helpers only queue requests; inj_send() flushes once per batch
+static void x11_move_mouse(int x, int y) {
+  XTestFakeMotionEvent(dpy, -1, x, y, CurrentTime);
+}
+
+static void x11_mouse_btn(int button, int down) {
+  //XTest buttons: 1=left 3=right
+  int b = (button == 0) ? 1 : 3;
+  XTestFakeButtonEvent(dpy, b, down ? True : False, CurrentTime);
+}
+
+static void x11_key(int slot, int down) {
+  KeyCode kc = (KeyCode)keytab_hw(slot);
+  if (kc == 0) return;
+  XTestFakeKeyEvent(dpy, kc, down ? True : False, CurrentTime);
+}
+
+static void x11_queue_event(const inj_event *e) {
+  switch (e->type) {
+    case INJ_KEY:    x11_key(e->code, e->down); break;
+    case INJ_BUTTON: x11_mouse_btn(e->code, e->down); break;
+    case INJ_MOVE:   x11_move_mouse(e->x, e->y); break;
+    case INJ_KEY_HW:
+      XTestFakeKeyEvent(dpy, (unsigned int)e->code, e->down ? True : False, CurrentTime);
+      break;
+    default: break;
+  }
+}
+
+//queue the whole batch, flush once
+static void inj_send_native(inj_batch *b) {
+  for (int i = 0; i < b->n; ++i) x11_queue_event(&b->ev[i]);
+  XFlush(dpy);
+  b->n = 0;
+}
+
+//flush after every event (benchmark reference)
+static void inj_send_single(inj_batch *b) {
+  for (int i = 0; i < b->n; ++i) {
+    x11_queue_event(&b->ev[i]);
+    XFlush(dpy);
+  }
+  b->n = 0;
+}
+
+static const inj_backend g_inj_native = { "XTest batched flush", inj_send_native, 0 };
+static const inj_backend g_inj_single = { "XTest flush per event", inj_send_single, 0 };
+
+//---- XTest on a connection of its own ----
+//the worker injects through a separate XCB connection, so a click never
+//waits for the Xlib display lock held by event handling or a redraw, and
+//a slow request on the UI connection never delays a click. fake_input has
+//no reply: a batch is queued and written with one xcb_flush.
+
+static xcb_connection_t *g_inj_conn = NULL;
+static xcb_window_t g_inj_root = XCB_NONE;
+
+static int inj_conn_open(void) {
+  int screen = 0;
+  xcb_connection_t *c = xcb_connect(NULL, &screen);
+  if (xcb_connection_has_error(c)) {
+    xcb_disconnect(c);
+    return 0;
+  }
+  const xcb_query_extension_reply_t *ext = xcb_get_extension_data(c, &xcb_test_id);
+  xcb_screen_iterator_t it = xcb_setup_roots_iterator(xcb_get_setup(c));
+  for (; it.rem && screen > 0; --screen) xcb_screen_next(&it);
+  if (!ext || !ext->present || !it.rem) {
+    xcb_disconnect(c);
+    return 0;
+  }
+  g_inj_root = it.data->root;
+  g_inj_conn = c;
+  return 1;
+}
+
+static void inj_conn_close(void) {
+  if (!g_inj_conn) return;
+  xcb_disconnect(g_inj_conn);
+  g_inj_conn = NULL;
+}
+
+static void xcb_queue_event(xcb_connection_t *c, const inj_event *e) {
+  int kc;
+  switch (e->type) {
+    case INJ_KEY:
+    case INJ_KEY_HW:
+      kc = (e->type == INJ_KEY) ? keytab_hw(e->code) : e->code;
+      if (kc == 0) return;
+      xcb_test_fake_input(c, e->down ? XCB_KEY_PRESS : XCB_KEY_RELEASE, (uint8_t)kc,
+                          XCB_CURRENT_TIME, XCB_NONE, 0, 0, 0);
+      break;
+    case INJ_BUTTON:
+      //XTest buttons: 1=left 3=right
+      xcb_test_fake_input(c, e->down ? XCB_BUTTON_PRESS : XCB_BUTTON_RELEASE,
+                          e->code == 0 ? 1 : 3, XCB_CURRENT_TIME, XCB_NONE, 0, 0, 0);
+      break;
+    case INJ_MOVE:
+      //detail 0: absolute position on root
+      xcb_test_fake_input(c, XCB_MOTION_NOTIFY, 0, XCB_CURRENT_TIME, g_inj_root,
+                          (int16_t)e->x, (int16_t)e->y, 0);
+      break;
+    default:
+      break;
+  }
+}
+
+static void inj_send_xcb(inj_batch *b) {
+  for (int i = 0; i < b->n; ++i) xcb_queue_event(g_inj_conn, &b->ev[i]);
+  xcb_flush(g_inj_conn);
+  b->n = 0;
+  //errors of unchecked fake_input requests are the only events on this
+  //connection; a non-blocking read once the batch is out keeps them from
+  //piling up, whether or not anything queries the pointer
+  xcb_generic_event_t *ev;
+  while ((ev = xcb_poll_for_event(g_inj_conn)) != NULL) free(ev);
+}
+
+static const inj_backend g_inj_xcb = { "XTest on own XCB connection", inj_send_xcb, 0 };
+
+static void inj_get_cursor(int *x, int *y) {
+  *x = *y = -1;   //unknown (mock benchmark): never "already there"
+  if (!g_inj_conn) {
+    if (dpy) x11_get_cursor(x, y);
+    return;
+  }
+  xcb_query_pointer_reply_t *r =
+      xcb_query_pointer_reply(g_inj_conn, xcb_query_pointer(g_inj_conn, g_inj_root), NULL);
+  if (r) {
+    *x = r->root_x;
+    *y = r->root_y;
+    free(r);
+  }
+}
+
+//---- uinput backend ----
+//a virtual keyboard + absolute pointer; a batch becomes one write() of
+//input_event records straight to the kernel, no display server round trip.
+//keys use the keytab's X KeyCodes: X servers number keys as evdev code + 8.
+
+#define UINPUT_KEYCODE_OFFSET 8
+#define UINPUT_SETTLE_NS      200000000ull
+
+static int g_uinput_fd = -1;
+static uint64_t g_uinput_ready = 0;   //injecting thread: no writes before this time
+
+//the axes keep the range they were created with while the display server
+//maps them onto the current screen: scale when the screen was resized since
+static struct {
+  unsigned int gen;
+  int max_x, max_y;   //axis maximum, screen size - 1 at creation
+  int cur_x, cur_y;   //current screen size - 1
+} g_uinput_axes;
+
+static int uinput_init(void) {
+  int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    fprintf(stderr, "Warning: cannot open /dev/uinput (%s)\n", strerror(errno));
+    return 0;
+  }
+
+  //absolute axes span the X screen, so coordinates need no scaling
+  int w = dpy ? DisplayWidth(dpy, DefaultScreen(dpy)) : 1920;
+  int h = dpy ? DisplayHeight(dpy, DefaultScreen(dpy)) : 1080;
+
+  int ok = ioctl(fd, UI_SET_EVBIT, EV_SYN) == 0 &&
+           ioctl(fd, UI_SET_EVBIT, EV_KEY) == 0 &&
+           ioctl(fd, UI_SET_EVBIT, EV_ABS) == 0 &&
+           ioctl(fd, UI_SET_KEYBIT, BTN_LEFT) == 0 &&
+           ioctl(fd, UI_SET_KEYBIT, BTN_RIGHT) == 0 &&
+           ioctl(fd, UI_SET_ABSBIT, ABS_X) == 0 &&
+           ioctl(fd, UI_SET_ABSBIT, ABS_Y) == 0;
+  for (int k = 1; ok && k < 256; ++k) {
+    ok = ioctl(fd, UI_SET_KEYBIT, k) == 0;
+  }
+
+  struct uinput_abs_setup abs;
+  for (int axis = 0; ok && axis < 2; ++axis) {
+    memset(&abs, 0, sizeof(abs));
+    abs.code = (axis == 0) ? ABS_X : ABS_Y;
+    abs.absinfo.minimum = 0;
+    abs.absinfo.maximum = ((axis == 0) ? w : h) - 1;
+    ok = ioctl(fd, UI_ABS_SETUP, &abs) == 0;
+  }
+  g_uinput_axes.gen = atomic_load(&g_screen_gen);
+  g_uinput_axes.max_x = g_uinput_axes.cur_x = w - 1;
+  g_uinput_axes.max_y = g_uinput_axes.cur_y = h - 1;
+
+  struct uinput_setup setup;
+  memset(&setup, 0, sizeof(setup));
+  setup.id.bustype = BUS_VIRTUAL;
+  setup.id.vendor = 0x1209;    //pid.codes open vendor id
+  setup.id.product = 0xF0C5;
+  snprintf(setup.name, sizeof(setup.name), "foxholetool virtual input");
+  ok = ok && ioctl(fd, UI_DEV_SETUP, &setup) == 0 && ioctl(fd, UI_DEV_CREATE) == 0;
+  if (!ok) {
+    fprintf(stderr, "Warning: cannot create uinput device (%s)\n", strerror(errno));
+    close(fd);
+    return 0;
+  }
+
+  //events sent before the display server opened the new device are lost;
+  //the first write waits for it (uinput_settle), startup does not
+  g_uinput_ready = now_ns() + UINPUT_SETTLE_NS;
+  g_uinput_fd = fd;
+  return 1;
+}
+
+static void uinput_settle(void) {
+  if (!g_uinput_ready) return;
+  uint64_t now = now_ns();
+  if (now < g_uinput_ready) {
+    uint64_t left = g_uinput_ready - now;
+    struct timespec ts = { (time_t)(left / 1000000000ull), (long)(left % 1000000000ull) };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) { }
+  }
+  g_uinput_ready = 0;
+}
+
+static void uinput_destroy(void) {
+  if (g_uinput_fd < 0) return;
+  ioctl(g_uinput_fd, UI_DEV_DESTROY);
+  close(g_uinput_fd);
+  g_uinput_fd = -1;
+}
+
+static void uinput_emit(struct input_event *ev, int *n, int type, int code, int value) {
+  memset(&ev[*n], 0, sizeof(ev[*n]));   //the kernel stamps the time
+  ev[*n].type = (unsigned short)type;
+  ev[*n].code = (unsigned short)code;
+  ev[*n].value = value;
+  ++*n;
+}
+
+static void uinput_axes_refresh(void) {
+  unsigned int gen = atomic_load_explicit(&g_screen_gen, memory_order_acquire);
+  if (g_uinput_axes.gen == gen) return;
+  g_uinput_axes.gen = gen;
+  int w = atomic_load_explicit(&g_screen_w, memory_order_relaxed);
+  int h = atomic_load_explicit(&g_screen_h, memory_order_relaxed);
+  if (w > 1 && h > 1) {
+    g_uinput_axes.cur_x = w - 1;
+    g_uinput_axes.cur_y = h - 1;
+  }
+}
+
+static int uinput_axis(int v, int max, int cur) {
+  if (max == cur || cur <= 0) return v;
+  return (int)(((int64_t)v * max + cur / 2) / cur);
+}
+
+static void inj_send_uinput(inj_batch *b) {
+  //at most x, y and a report per injected event
+  struct input_event ev[INJ_BATCH_MAX * 3];
+  int n = 0;
+  uinput_settle();
+  uinput_axes_refresh();
+  for (int i = 0; i < b->n; ++i) {
+    const inj_event *e = &b->ev[i];
+    int kc = 0;
+    switch (e->type) {
+      case INJ_KEY:
+      case INJ_KEY_HW:
+        kc = (e->type == INJ_KEY) ? keytab_hw(e->code) : e->code;
+        if (kc < UINPUT_KEYCODE_OFFSET) continue;
+        uinput_emit(ev, &n, EV_KEY, kc - UINPUT_KEYCODE_OFFSET, e->down);
+        break;
+      case INJ_BUTTON:
+        uinput_emit(ev, &n, EV_KEY, e->code == 0 ? BTN_LEFT : BTN_RIGHT, e->down);
+        break;
+      case INJ_MOVE:
+        uinput_emit(ev, &n, EV_ABS, ABS_X, uinput_axis(e->x, g_uinput_axes.max_x, g_uinput_axes.cur_x));
+        uinput_emit(ev, &n, EV_ABS, ABS_Y, uinput_axis(e->y, g_uinput_axes.max_y, g_uinput_axes.cur_y));
+        break;
+      default:
+        continue;
+    }
+    uinput_emit(ev, &n, EV_SYN, SYN_REPORT, 0);
+  }
+  if (n > 0 && write(g_uinput_fd, ev, sizeof(ev[0]) * (size_t)n) < 0) {
+    static int warned = 0;
+    if (!warned) fprintf(stderr, "Warning: uinput write failed (%s)\n", strerror(errno));
+    warned = 1;
+  }
+  b->n = 0;
+}
+
+static const inj_backend g_inj_uinput = { "uinput", inj_send_uinput, 0 };
+#endif
+
+//counts events and touches nothing; lets the scheduler run headless
+static atomic_ullong g_inj_mock_events = 0;
+static atomic_ullong g_inj_mock_moves = 0;
+
+static void inj_send_mock(inj_batch *b) {
+  unsigned long long moves = 0;
+  for (int i = 0; i < b->n; ++i) moves += (b->ev[i].type == INJ_MOVE);
+  atomic_fetch_add_explicit(&g_inj_mock_events, (unsigned long long)b->n, memory_order_relaxed);
+  atomic_fetch_add_explicit(&g_inj_mock_moves, moves, memory_order_relaxed);
+  b->n = 0;
+}
+
+static const inj_backend g_inj_mock = { "mock", inj_send_mock, 0 };
+
+//---- targeted delivery (Multibox=yes) ----
+//every game window found gets the batch as messages posted to the window
+//(Windows) or as synthetic events sent to it on the worker's XCB connection
+//(X11) instead of global input, so the real cursor never moves and each
+//client sees the input at the same point of its own window. a screen point
+//is mapped through the window it lies in (the first window if none), so a
+//position saved over one client applies to all of them. posting waits for
+//neither the clients nor the server, so one worker serves every window.
+
+#define TARGETS_MAX 8
+
+typedef struct {
+  int n;
+#ifdef _WIN32
+  HWND win[TARGETS_MAX];
+#else
+  Window win[TARGETS_MAX];
+  //root coordinates and size, kept current by the main thread
+  atomic_int x[TARGETS_MAX], y[TARGETS_MAX], w[TARGETS_MAX], h[TARGETS_MAX];
+#endif
+} target_set;
+
+typedef struct {
+  int x, y, w, h;
+} target_rect;
+
+static target_set *g_targets = NULL;   //worker thread, replaced by CMD_TARGETS_SET
+
+//the pointer as the targets last saw it; buttons: bit 0 left, bit 1 right
+static struct {
+  int valid;
+  int x, y;
+  unsigned int buttons;
+} g_tgt_ptr;   //worker thread
+
+//screen rectangle of a target's client area; 0 if it is unknown or gone
+static int target_rect_get(const target_set *t, int i, target_rect *r) {
+#ifdef _WIN32
+  RECT rc;
+  POINT p = { 0, 0 };
+  if (!GetClientRect(t->win[i], &rc) || !ClientToScreen(t->win[i], &p)) return 0;
+  r->x = (int)p.x;
+  r->y = (int)p.y;
+  r->w = (int)rc.right;
+  r->h = (int)rc.bottom;
+#else
+  r->x = atomic_load_explicit(&t->x[i], memory_order_relaxed);
+  r->y = atomic_load_explicit(&t->y[i], memory_order_relaxed);
+  r->w = atomic_load_explicit(&t->w[i], memory_order_relaxed);
+  r->h = atomic_load_explicit(&t->h[i], memory_order_relaxed);
+#endif
+  return r->w > 0 && r->h > 0;
+}
+
+#ifdef _WIN32
+//one event as a window message; cx, cy in client coordinates, buttons held before it
+static void target_deliver(HWND w, const target_rect *r, const inj_event *e,
+                           int cx, int cy, unsigned int buttons) {
+  (void)r;
+  LPARAM pos = MAKELPARAM((WORD)(SHORT)cx, (WORD)(SHORT)cy);
+  unsigned int bit = (e->code == 0) ? 1u : 2u;
+  if (e->type == INJ_BUTTON) buttons = e->down ? (buttons | bit) : (buttons & ~bit);
+  WPARAM mk = ((buttons & 1u) ? MK_LBUTTON : 0) | ((buttons & 2u) ? MK_RBUTTON : 0);
+
+  switch (e->type) {
+    case INJ_MOVE:
+      PostMessageA(w, WM_MOUSEMOVE, mk, pos);
+      break;
+    case INJ_BUTTON:
+      if (e->code == 0) PostMessageA(w, e->down ? WM_LBUTTONDOWN : WM_LBUTTONUP, mk, pos);
+      else PostMessageA(w, e->down ? WM_RBUTTONDOWN : WM_RBUTTONUP, mk, pos);
+      break;
+    case INJ_KEY:
+    case INJ_KEY_HW: {
+      int hw = (e->type == INJ_KEY) ? keytab_hw(e->code) : e->code;
+      UINT scan = (UINT)(hw & 0xff);
+      int ext = (hw & KEYTAB_EXTENDED) != 0;
+      UINT vk = MapVirtualKeyA(ext ? (0xE000u | scan) : scan, MAPVK_VSC_TO_VK_EX);
+      if (!scan || !vk) return;
+      //repeat count 1, scan code, extended flag; key up adds previous state + transition
+      LPARAM lp = (LPARAM)(1u | (scan << 16) | (ext ? 1u << 24 : 0) | (e->down ? 0 : 3u << 30));
+      PostMessageA(w, e->down ? WM_KEYDOWN : WM_KEYUP, vk, lp);
+    } break;
+    default:
+      break;
+  }
+}
+#else
+//one event as XSendEvent to the window; cx, cy in window coordinates,
+//buttons held before it (X reports the state before the event)
+static void target_deliver(Window w, const target_rect *r, const inj_event *e,
+                           int cx, int cy, unsigned int buttons) {
+  xcb_button_press_event_t ev;   //key, button and motion events share this layout
+  memset(&ev, 0, sizeof(ev));
+  ev.time = XCB_CURRENT_TIME;
+  ev.root = g_inj_root;
+  ev.event = (xcb_window_t)w;
+  ev.child = XCB_NONE;
+  ev.root_x = (int16_t)(r->x + cx);
+  ev.root_y = (int16_t)(r->y + cy);
+  ev.event_x = (int16_t)cx;
+  ev.event_y = (int16_t)cy;
+  ev.state = (uint16_t)(((buttons & 1u) ? XCB_BUTTON_MASK_1 : 0) |
+                        ((buttons & 2u) ? XCB_BUTTON_MASK_3 : 0));
+  ev.same_screen = 1;
+
+  uint32_t mask;
+  switch (e->type) {
+    case INJ_MOVE:
+      ev.response_type = XCB_MOTION_NOTIFY;
+      ev.detail = XCB_MOTION_NORMAL;
+      mask = XCB_EVENT_MASK_POINTER_MOTION;
+      break;
+    case INJ_BUTTON:
+      ev.response_type = e->down ? XCB_BUTTON_PRESS : XCB_BUTTON_RELEASE;
+      ev.detail = (e->code == 0) ? 1 : 3;
+      mask = e->down ? XCB_EVENT_MASK_BUTTON_PRESS : XCB_EVENT_MASK_BUTTON_RELEASE;
+      break;
+    case INJ_KEY:
+    case INJ_KEY_HW: {
+      int kc = (e->type == INJ_KEY) ? keytab_hw(e->code) : e->code;
+      if (kc == 0) return;
+      ev.response_type = e->down ? XCB_KEY_PRESS : XCB_KEY_RELEASE;
+      ev.detail = (uint8_t)kc;
+      mask = e->down ? XCB_EVENT_MASK_KEY_PRESS : XCB_EVENT_MASK_KEY_RELEASE;
+    } break;
+    default:
+      return;
+  }
+  xcb_send_event(g_inj_conn, 0, (xcb_window_t)w, mask, (const char *)&ev);
+}
+#endif
+
+static void inj_send_targets(inj_batch *b) {
+  const target_set *t = g_targets;
+  int n = t ? t->n : 0;
+  target_rect r[TARGETS_MAX];
+  int ok[TARGETS_MAX];
+  for (int i = 0; i < n; ++i) ok[i] = target_rect_get(t, i, &r[i]);
+
+  //until the first move the targets see the pointer where the real one is
+  if (!g_tgt_ptr.valid) {
+    inj_get_cursor(&g_tgt_ptr.x, &g_tgt_ptr.y);
+    g_tgt_ptr.valid = 1;
+  }
+
+  for (int k = 0; k < b->n; ++k) {
+    const inj_event *e = &b->ev[k];
+    if (e->type == INJ_MOVE) {
+      g_tgt_ptr.x = e->x;
+      g_tgt_ptr.y = e->y;
+    }
+    int px = g_tgt_ptr.x, py = g_tgt_ptr.y;
+    int src = -1;
+    for (int i = 0; i < n && src < 0; ++i) {
+      if (ok[i] && px >= r[i].x && py >= r[i].y && px < r[i].x + r[i].w && py < r[i].y + r[i].h)
+        src = i;
+    }
+    for (int i = 0; i < n && src < 0; ++i) {
+      if (ok[i]) src = i;
+    }
+    if (src >= 0) {
+      int cx = px - r[src].x, cy = py - r[src].y;
+      for (int i = 0; i < n; ++i) {
+        if (ok[i]) target_deliver(t->win[i], &r[i], e, cx, cy, g_tgt_ptr.buttons);
+      }
+    }
+    if (e->type == INJ_BUTTON) {
+      unsigned int bit = (e->code == 0) ? 1u : 2u;
+      g_tgt_ptr.buttons = e->down ? (g_tgt_ptr.buttons | bit) : (g_tgt_ptr.buttons & ~bit);
+    }
+  }
+#ifndef _WIN32
+  if (n) xcb_flush(g_inj_conn);
+#endif
+  b->n = 0;
+}
+
+#ifdef _WIN32
+static const inj_backend g_inj_target = { "PostMessage to each game window", inj_send_targets, 1 };
+#else
+static const inj_backend g_inj_target = { "XSendEvent to each game window", inj_send_targets, 1 };
+#endif
+
+//---------- text shown in the overlay (Windows + Linux) ----------
+//one HUD model for both renderers. everything that only changes with the
+//config is formatted once by hud_model_build: the hotkey legend, the
+//"Active:" labels of every combination of the fixed flags and the macro
+//names. hud_compose then only copies spans; the recording clock and the
+//spam rate are the only numbers, and the rate is formatted when it is sampled
+
+#define HUD_LEGEND_MAX 640
+#define HUD_TEXT_MAX   1024
+#define HUD_ACTIVE_MAX 32
+
+//flags with a fixed label, in HUD order; hud_model.active is indexed by
+//the mask of these (bit i = g_hud_flags[i])
+static const struct {
+  uint32_t flag;
+  const char *label;
+} g_hud_flags[] = {
+  { ST_SPAM,     " Spam" },
+  { ST_HOLD_W,   " W" },
+  { ST_HOLD_S,   " S" },
+  { ST_HOLD_RMB, " RMB" },
+  { ST_HOLD_LMB, " LMB" },
+  { ST_REPLAY,   " Replay" }
+};
+#define HUD_FLAG_COUNT ((int)(sizeof(g_hud_flags) / sizeof(g_hud_flags[0])))
+
+typedef struct {
+  const char *s;
+  size_t len;
+} hud_span;
+
+typedef struct {
+  char legend[HUD_LEGEND_MAX];
+  size_t legend_len;
+  char active[1 << HUD_FLAG_COUNT][HUD_ACTIVE_MAX];
+  uint8_t active_len[1 << HUD_FLAG_COUNT];
+  uint32_t active_mask;                        //all flags of g_hud_flags
+  char macro[MACRO_USER_MAX][MACRO_NAME_MAX + 1];   //" <name>"
+  uint8_t macro_len[MACRO_USER_MAX];
+  int macro_count;
+  char rate[64];                               //" 998/1000 cps (3 dropped)"
+  size_t rate_len;
+  char text[HUD_TEXT_MAX];                     //hud_compose output
+} hud_model;
+
+static hud_model g_hud;   //main thread
+
+//built-in actions in HUD order with their label
+static const struct {
+  int action;
+  const char *label;
+} g_hud_items[] = {
+  { ACTION_SPAM_LMB, "spam LMB saved position" },
+  { ACTION_HOLD_W,   "hold W" },
+  { ACTION_HOLD_S,   "hold S" },
+  { ACTION_HOLD_RMB, "hold RMB" },
+  { ACTION_HOLD_LMB, "hold LMB" },
+  { ACTION_SUSPEND,  "stop" },
+  { ACTION_EXIT,     "exit" },
+  { ACTION_RECORD,   "rec" },
+  { ACTION_REPLAY,   "replay" },
+  { ACTION_STATS,    "stats" }
+};
+
+//snprintf at offset *used of the legend, keeping *used within the buffer
+static void hud_legend_add(size_t *used, const char *fmt, const char *a, const char *b) {
+  size_t room = sizeof(g_hud.legend) - *used;
+  int n = snprintf(g_hud.legend + *used, room, fmt, a, b);
+  if (n > 0) *used += ((size_t)n < room) ? (size_t)n : room - 1;
+}
+
+//format the parts that only change with the config (main thread; after
+//macro_build_all, since unbound or broken macros are left out)
+static void hud_model_build(void) {
+  char key[48];
+  size_t used = 0;
+  g_hud.legend[0] = '\0';
+  for (size_t k = 0; k < sizeof(g_hud_items) / sizeof(g_hud_items[0]); ++k) {
+    int action = g_hud_items[k].action;
+    if (!g_cfg->keys[action]) continue;
+    hud_legend_add(&used, "%s %s | ",
+                   hotkey_name(g_cfg->keys[action], g_cfg->mods[action], key, sizeof(key)),
+                   g_hud_items[k].label);
+  }
+  hud_legend_add(&used, "%s %s", key_name(
+#ifdef _WIN32
+      VK_HIDE_OVERLAY,
+#else
+      KS_HIDE_OVERLAY,
+#endif
+      key, sizeof(key)), "hide HUD");
+  for (int i = 0; i < g_cfg->macro_count; ++i) {
+    int action = ACTION_MACRO_FIRST + i;
+    if (!g_cfg->keys[action] || g_macro_main->defs[action].len == 0) continue;
+    hud_legend_add(&used, " | %s %s",
+                   hotkey_name(g_cfg->keys[action], g_cfg->mods[action], key, sizeof(key)),
+                   g_cfg->macro_names[i]);
+  }
+  g_hud.legend_len = used;
+
+  //the fixed labels never change, but building them here keeps one entry point
+  g_hud.active_mask = 0;
+  for (int i = 0; i < HUD_FLAG_COUNT; ++i) g_hud.active_mask |= g_hud_flags[i].flag;
+  for (unsigned int m = 0; m < (1u << HUD_FLAG_COUNT); ++m) {
+    size_t n = 0;
+    for (int i = 0; i < HUD_FLAG_COUNT; ++i) {
+      if (!(m & (1u << i))) continue;
+      size_t l = strlen(g_hud_flags[i].label);
+      memcpy(g_hud.active[m] + n, g_hud_flags[i].label, l);
+      n += l;
+    }
+    g_hud.active_len[m] = (uint8_t)n;
+  }
+
+  g_hud.macro_count = g_cfg->macro_count;
+  for (int i = 0; i < g_cfg->macro_count; ++i) {
+    size_t l = strlen(g_cfg->macro_names[i]);
+    g_hud.macro[i][0] = ' ';
+    memcpy(g_hud.macro[i] + 1, g_cfg->macro_names[i], l);
+    g_hud.macro_len[i] = (uint8_t)(l + 1);
+  }
+}
+
+//the hotkey legend alone (console help)
+static hud_span hud_legend(void) {
+  hud_span s = { g_hud.legend, g_hud.legend_len };
+  return s;
+}
+
+//format the spam rate segment from the last sample; empty while spam is off
+//or not sampled yet (rate_views_refresh)
+static void hud_rate_update(void) {
+  const rate_view *v = &g_rate_view[ACTION_SPAM_LMB];
+  uint64_t iv = atomic_load_explicit(&g_rate[ACTION_SPAM_LMB].interval_ns, memory_order_relaxed);
+  g_hud.rate_len = 0;
+  if (!v->active || v->per_sec < 0 || !iv) return;
+  uint64_t dropped =
+      atomic_load_explicit(&g_rate[ACTION_SPAM_LMB].dropped, memory_order_relaxed) - v->dropped0;
+  int n = dropped
+      ? snprintf(g_hud.rate, sizeof(g_hud.rate), " %.0f/%.0f cps (%llu dropped)",
+                 v->per_sec, 1e9 / (double)iv, (unsigned long long)dropped)
+      : snprintf(g_hud.rate, sizeof(g_hud.rate), " %.0f/%.0f cps",
+                 v->per_sec, 1e9 / (double)iv);
+  if (n > 0) g_hud.rate_len = ((size_t)n < sizeof(g_hud.rate)) ? (size_t)n : sizeof(g_hud.rate) - 1;
+}
+
+//append a span to the composed text, cut at the end of the buffer
+static size_t hud_put(size_t used, const char *s, size_t len) {
+  if (len > sizeof(g_hud.text) - used) len = sizeof(g_hud.text) - used;
+  memcpy(g_hud.text + used, s, len);
+  return used + len;
+}
+
+//decimal digits of v, no formatting
+static size_t hud_put_uint(size_t used, unsigned int v) {
+  char d[10];
+  size_t n = 0;
+  do {
+    d[sizeof(d) - ++n] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v && n < sizeof(d));
+  return hud_put(used, d + sizeof(d) - n, n);
+}
+
+//the HUD line for the action flags f: the legend, then " | Active: ..." for
+//the flags that are set. valid until the next call (main thread)
+static hud_span hud_compose(uint32_t f) {
+  static const char k_active[] = " | Active:", k_rec[] = " REC ";
+  static const char k_susp[] = " [SUSP]", k_nofocus[] = " [NO FOCUS]";
+  uint32_t macros = 0;
+  for (int i = 0; i < g_hud.macro_count; ++i) {
+    if (f & ST_MACRO(i)) macros |= 1u << i;
+  }
+  if (!(f & (g_hud.active_mask | ST_RECORDING | ST_SUSPENDED | ST_UNFOCUSED)) && !macros)
+    return hud_legend();
+
+  unsigned int m = 0;
+  for (int i = 0; i < HUD_FLAG_COUNT; ++i) {
+    if (f & g_hud_flags[i].flag) m |= 1u << i;
+  }
+  size_t used = hud_put(0, g_hud.legend, g_hud.legend_len);
+  used = hud_put(used, k_active, sizeof(k_active) - 1);
+  if (m & 1u) {
+    //the rate goes right after the " Spam" every such entry starts with
+    size_t l = g_hud.active_len[1];
+    used = hud_put(used, g_hud.active[m], l);
+    used = hud_put(used, g_hud.rate, g_hud.rate_len);
+    used = hud_put(used, g_hud.active[m] + l, g_hud.active_len[m] - l);
+  } else {
+    used = hud_put(used, g_hud.active[m], g_hud.active_len[m]);
+  }
+  for (int i = 0; macros; ++i, macros >>= 1) {
+    if (macros & 1u) used = hud_put(used, g_hud.macro[i], g_hud.macro_len[i]);
+  }
+  if (f & ST_RECORDING) {
+    used = hud_put(used, k_rec, sizeof(k_rec) - 1);
+    used = hud_put_uint(used, (unsigned int)((now_ns() - g_rec_start) / 1000000000ull));
+    used = hud_put(used, "s", 1);
+  }
+  if (f & ST_SUSPENDED) used = hud_put(used, k_susp, sizeof(k_susp) - 1);
+  if (f & ST_UNFOCUSED) used = hud_put(used, k_nofocus, sizeof(k_nofocus) - 1);
+  hud_span s = { g_hud.text, used };
+  return s;
+}
+
+static void overlay_draw(void);
+
+//--------------- focus gating ---------------
+//the window tracking code reports every focus change of the game window
+//(EVENT_SYSTEM_FOREGROUND on Windows, _NET_ACTIVE_WINDOW on X11); with
+//PauseUnfocused the worker then treats ST_UNFOCUSED like ST_SUSPENDED:
+//held input is released on the way out and pressed again on the way back
+
+static int g_game_focused = 0;   //main thread
+
+//bring ST_UNFOCUSED in line with the focus and the config
+static void focus_apply(void) {
+  int pause = g_cfg->pause_unfocused && !g_game_focused;
+  if (!(st_flags(state_load()) & ST_UNFOCUSED) == !pause) return;
+  state_update(ST_UNFOCUSED, pause ? ST_UNFOCUSED : 0);
+  worker_wake();
+  printf("Game focus: %s\n", pause ? "lost, pausing" : "back, resuming");
+  fflush(stdout);
+  overlay_draw();
+}
+
+static void focus_set(int focused) {
+  g_game_focused = focused;
+  focus_apply();
+}
+
+#ifndef _WIN32
+//--------------- overlay helpers for Linux/X11 -----------
+
+//helpers to read and compare window titles
+static int window_title_equals(Display *display, Window w, const char *exact) {
+  if (!display || !exact) return 0;
+  char *name = NULL;
+  if (XFetchName(display, w, &name) > 0 && name) {
+    int ok = (strcasecmp(name, exact) == 0);
+    XFree(name);
+    return ok;
+  }
+  return 0;
+}
+
+static int window_title_contains(Display *display, Window w, const char *substr) {
+  if (!display || !substr) return 0;
+  char *name = NULL;
+  if (XFetchName(display, w, &name) > 0 && name) {
+    int ok = strcasestr_simple(name, substr);
+    XFree(name);
+    return ok;
+  }
+  return 0;
+}
+
+static Window find_window_title_exact_rec(Display *display, Window w, const char *exact) {
+  if (window_title_equals(display, w, exact))
+    return w;
+
+  Window root_ret, parent_ret;
+  Window *children = NULL;
+  unsigned int nchildren = 0;
+  if (!XQueryTree(display, w, &root_ret, &parent_ret, &children, &nchildren))
+    return 0;
+
+  Window result = 0;
+  for (unsigned int i = 0; i < nchildren && !result; ++i) {
+    result = find_window_title_exact_rec(display, children[i], exact);
+  }
+
+  if (children)
+    XFree(children);
+
+  return result;
+}
+
+static Window find_window_title_contains_rec(Display *display, Window w, const char *substr) {
+  if (window_title_contains(display, w, substr))
+    return w;
+
+  Window root_ret, parent_ret;
+  Window *children = NULL;
+  unsigned int nchildren = 0;
+  if (!XQueryTree(display, w, &root_ret, &parent_ret, &children, &nchildren))
+    return 0;
+
+  Window result = 0;
+  for (unsigned int i = 0; i < nchildren && !result; ++i) {
+    result = find_window_title_contains_rec(display, children[i], substr);
+  }
+
+  if (children)
+    XFree(children);
+
+  return result;
+}
+
+//return 1 if process path/cmdline contains "foxhole"
+static int process_matches_foxhole(unsigned long pid_ul) {
+  if (pid_ul == 0) return 0;
+
+  char pathbuf[512];
+  char procfile[64];
+
+  //check /proc/<pid>/exe symlink
+  snprintf(procfile, sizeof(procfile), "/proc/%lu/exe", pid_ul);
+  ssize_t len = readlink(procfile, pathbuf, sizeof(pathbuf) - 1);
+  if (len > 0) {
+    pathbuf[len] = '\0';
+    if (strcasestr_simple(pathbuf, "foxhole")) {
+      return 1;
+    }
+  }
+
+  //check first argument in /proc/<pid>/cmdline
+  snprintf(procfile, sizeof(procfile), "/proc/%lu/cmdline", pid_ul);
+  FILE *f = fopen(procfile, "r");
+  if (f) {
+    size_t n = fread(pathbuf, 1, sizeof(pathbuf) - 1, f);
+    fclose(f);
+    if (n > 0) {
+      //cmdline is NUL‑separated; first string is enough
+      pathbuf[n] = '\0';
+      if (strcasestr_simple(pathbuf, "foxhole")) {
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int process_matches_foxhole_cached(unsigned long pid_ul) {
+  int v = pid_cache_get(pid_ul);
+  if (v < 0) {
+    v = process_matches_foxhole(pid_ul);
+    pid_cache_put(pid_ul, v);
+  }
+  return v;
+}
+
+//EWMH path: read _NET_CLIENT_LIST once and pipeline the _NET_WM_PID requests
+//for all clients through XCB, so the whole scan costs two round trips.
+//stores up to max matches in out and returns their number; returns 0 and
+//sets *have_list = 0 when the window manager has no list.
+static int find_target_windows_clients(Display *display, Atom pid_atom, Window *out, int max,
+                                       int *have_list) {
+  *have_list = 0;
+  Atom list_atom = XInternAtom(display, "_NET_CLIENT_LIST", True);
+  if (list_atom == None) return 0;
+
+  Atom type;
+  int format;
+  unsigned long nitems, bytes_after;
+  unsigned char *prop = NULL;
+  if (XGetWindowProperty(display, DefaultRootWindow(display), list_atom,
+                         0, 0x10000, False, XA_WINDOW,
+                         &type, &format, &nitems, &bytes_after, &prop) != Success ||
+      !prop || format != 32) {
+    if (prop) XFree(prop);
+    return 0;
+  }
+  *have_list = 1;
+
+  //format 32 properties come back as an array of long in Xlib
+  const unsigned long *clients = (const unsigned long *)prop;
+  xcb_connection_t *conn = XGetXCBConnection(display);
+  xcb_get_property_cookie_t *cookies =
+      (xcb_get_property_cookie_t *)malloc(sizeof(*cookies) * (nitems ? nitems : 1));
+  if (!conn || !cookies) {
+    free(cookies);
+    XFree(prop);
+    return 0;
+  }
+
+  for (unsigned long i = 0; i < nitems; ++i) {
+    cookies[i] = xcb_get_property(conn, 0, (xcb_window_t)clients[i], (xcb_atom_t)pid_atom,
+                                  XCB_ATOM_CARDINAL, 0, 1);
+  }
+
+  int found = 0;
+  for (unsigned long i = 0; i < nitems; ++i) {
+    if (found == max) {
+      xcb_discard_reply(conn, cookies[i].sequence);
+      continue;
+    }
+    xcb_get_property_reply_t *r = xcb_get_property_reply(conn, cookies[i], NULL);
+    if (!r) continue;
+    if (r->format == 32 && xcb_get_property_value_length(r) >= 4) {
+      uint32_t pid = *(const uint32_t *)xcb_get_property_value(r);
+      if (process_matches_foxhole_cached(pid)) {
+        out[found++] = (Window)clients[i];
+      }
+    }
+    free(r);
+  }
+
+  free(cookies);
+  XFree(prop);
+  return found;
+}
+
+//fallback for window managers without EWMH: walk the whole window tree
+static int find_target_windows_tree(Display *display, Atom pid_atom, Window *out, int max) {
+  Window root = DefaultRootWindow(display);
+
+  //DFS over windows belonging to a process whose path/cmdline contains "foxhole"
+  size_t cap = 1024, top = 0;
+  Window *stack = (Window *)malloc(sizeof(Window) * cap);
+  if (!stack) return 0;
+  stack[top++] = root;
+
+  int found = 0;
+  while (top > 0 && found < max) {
+    Window w = stack[--top];
+
+    //read PID for this window
+    Atom type;
+    int format;
+    unsigned long nitems, bytes_after;
+    unsigned char *prop = NULL;
+    if (XGetWindowProperty(display, w, pid_atom,
+                           0, 1, False, XA_CARDINAL,
+                           &type, &format, &nitems, &bytes_after, &prop) == Success &&
+        prop != NULL && nitems >= 1 && format == 32) {
+      unsigned long pid_ul = *((unsigned long*)prop);
+      XFree(prop);
+
+      //the game's own windows hold no further game windows
+      if (process_matches_foxhole_cached(pid_ul)) {
+        out[found++] = w;
+        continue;
+      }
+    } else if (prop) {
+      XFree(prop);
+    }
+
+    //push children on the stack to keep searching (the stack grows as needed)
+    Window root_ret, parent_ret;
+    Window *children = NULL;
+    unsigned int nchildren = 0;
+    if (XQueryTree(display, w, &root_ret, &parent_ret, &children, &nchildren)) {
+      if (top + nchildren > cap) {
+        size_t ncap = cap;
+        while (top + nchildren > ncap) ncap *= 2;
+        Window *grown = (Window *)realloc(stack, sizeof(Window) * ncap);
+        if (grown) {
+          stack = grown;
+          cap = ncap;
+        }
+      }
+      for (unsigned int i = 0; i < nchildren && top < cap; ++i) {
+        stack[top++] = children[i];
+      }
+    }
+    if (children) {
+      XFree(children);
+    }
+  }
+
+  free(stack);
+  return found;
+}
+
+//up to max game windows, in client list (stacking-independent) order
+static int find_target_windows(Display *display, Window *out, int max) {
+  if (!display) return 0;
+
+  uint64_t t0 = trace_now();
+  int n = 0;
+  Atom pid_atom = XInternAtom(display, "_NET_WM_PID", True);
+  if (pid_atom != None) {
+    int have_list = 0;
+    n = find_target_windows_clients(display, pid_atom, out, max, &have_list);
+    if (!n && !have_list) n = find_target_windows_tree(display, pid_atom, out, max);
+  }
+  trace_span("find_window", t0, "found", n);
+  return n;
+}
+
+static Window find_target_window(Display *display) {
+  Window w = 0;
+  return find_target_windows(display, &w, 1) ? w : 0;
+}
+
+static void overlay_move_to(int x) {
+  XMoveResizeWindow(dpy, g_overlay_win, x, 0, OVERLAY_WIDTH_FULL, OVERLAY_HEIGHT);
+}
+
+//align the overlay with the game window (callers map it if needed)
+static void overlay_position_on_window(void) {
+  if (!dpy || !g_overlay_win || !g_foxhole_win) return;
+
+  //the game is usually reparented into a WM frame, so ask for root coordinates
+  int x = 0, y = 0;
+  Window child;
+  if (!XTranslateCoordinates(dpy, g_foxhole_win, DefaultRootWindow(dpy), 0, 0, &x, &y, &child))
+    return;
+  overlay_move_to(x);
+}
+
+//---- game window tracking ----
+//the overlay follows the game through events: ConfigureNotify/DestroyNotify
+//on the game window, and _NET_CLIENT_LIST changes (or top-level MapNotify
+//without EWMH) on the root window to pick the game up again after a restart.
+//focus comes from _NET_ACTIVE_WINDOW changes on the root window, or from
+//FocusIn/FocusOut on the game window when the WM does not maintain it
+
+static Atom g_atom_client_list = None;
+static Atom g_atom_active_window = None;
+static long g_root_event_mask = KeyPressMask;
+
+static void root_select_input(void) {
+  XSelectInput(dpy, DefaultRootWindow(dpy), g_root_event_mask);
+}
+
+static void target_watch_init(void) {
+  g_atom_client_list = XInternAtom(dpy, "_NET_CLIENT_LIST", True);
+  g_atom_active_window = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", True);
+  //StructureNotify: the root is resized (ConfigureNotify) after a RandR change
+  g_root_event_mask = KeyPressMask | StructureNotifyMask |
+                      (g_atom_client_list != None ? PropertyChangeMask : SubstructureNotifyMask) |
+                      (g_atom_active_window != None ? PropertyChangeMask : 0);
+  root_select_input();
+}
+
+//1 if the game window has the focus right now (one round trip)
+static int target_query_focus(void) {
+  if (!g_foxhole_win) return 0;
+  if (g_atom_active_window == None) {
+    Window focus = None;
+    int revert;
+    XGetInputFocus(dpy, &focus, &revert);
+    return focus == g_foxhole_win;
+  }
+
+  Atom type;
+  int format;
+  unsigned long n = 0, after;
+  unsigned char *data = NULL;
+  Window active = None;
+  if (XGetWindowProperty(dpy, DefaultRootWindow(dpy), g_atom_active_window,
+                         0, 1, False, XA_WINDOW,
+                         &type, &format, &n, &after, &data) == Success && data) {
+    if (type == XA_WINDOW && format == 32 && n == 1) active = (Window)*(unsigned long *)data;
+    XFree(data);
+  }
+  return active == g_foxhole_win;
+}
+
+static void target_track(Window w) {
+  g_foxhole_win = w;
+  if (w) {
+    XSelectInput(dpy, w, StructureNotifyMask |
+                         (g_atom_active_window == None ? FocusChangeMask : 0));
+  }
+  focus_set(target_query_focus());
+}
+
+//set while the startup thread runs the first search (it owns the PID cache
+//until then); a change seen meanwhile is searched again once it is done
+static int g_target_search_busy = 0, g_target_search_missed = 0;
+
+//look for the game again; called only from root events while it is missing
+static void target_rediscover(void) {
+  if (g_target_search_busy) {
+    g_target_search_missed = 1;
+    return;
+  }
+  Window w = find_target_window(dpy);
+  if (!w) return;
+
+  target_track(w);
+  printf("Game window found again.\n");
+  fflush(stdout);
+  if (g_overlay_win) {
+    overlay_position_on_window();
+    if (!atomic_load(&g_overlay_hidden)) XMapRaised(dpy, g_overlay_win);
+  }
+  XFlush(dpy);
+}
+
+//returns 1 if the event belonged to target tracking
+static int target_handle_event(const XEvent *ev) {
+  Window root = DefaultRootWindow(dpy);
+
+  if (g_foxhole_win && ev->type == ConfigureNotify && ev->xconfigure.window == g_foxhole_win) {
+    //synthetic ConfigureNotify from the WM carries root coordinates (ICCCM 4.1.5)
+    if (ev->xconfigure.send_event) {
+      if (g_overlay_win) overlay_move_to(ev->xconfigure.x);
+    } else {
+      overlay_position_on_window();
+    }
+    //keep the HUD above a game that was raised or went fullscreen
+    if (g_overlay_win && !atomic_load(&g_overlay_hidden)) XRaiseWindow(dpy, g_overlay_win);
+    XFlush(dpy);
+    return 1;
+  }
+
+  if (g_foxhole_win && ev->type == DestroyNotify && ev->xdestroywindow.window == g_foxhole_win) {
+    g_foxhole_win = 0;
+    focus_set(0);
+    pid_cache_clear();
+    if (g_overlay_win) XUnmapWindow(dpy, g_overlay_win);
+    XFlush(dpy);
+    printf("Game window closed, waiting for it to come back.\n");
+    fflush(stdout);
+    return 1;
+  }
+
+  //grabs (our own hotkeys included) move the focus only for their duration
+  if ((ev->type == FocusIn || ev->type == FocusOut) && ev->xfocus.window == g_foxhole_win) {
+    if ((ev->xfocus.mode == NotifyNormal || ev->xfocus.mode == NotifyWhileGrabbed) &&
+        ev->xfocus.detail != NotifyInferior)
+      focus_set(ev->type == FocusIn);
+    return 1;
+  }
+
+  if (ev->type == PropertyNotify && ev->xproperty.window == root) {
+    if (!g_foxhole_win && ev->xproperty.atom == g_atom_client_list) target_rediscover();
+    else if (g_foxhole_win && ev->xproperty.atom == g_atom_active_window)
+      focus_set(target_query_focus());
+    return 1;
+  }
+
+  if (ev->type == MapNotify && ev->xmap.event == root) {
+    if (!g_foxhole_win) target_rediscover();
+    return 1;
+  }
+
+  return 0;
+}
+
+//---- XRender backbuffer ----
+//with RENDER and an ARGB visual the HUD is composed in an offscreen ARGB
+//picture from a glyph set built once from the overlay font; a frame is then
+//a single XRenderComposite to the window (Expose needs nothing else).
+//glyphs come antialiased from the Xft (FreeType) face when there is one,
+//from the core font with hard edges otherwise
+
+#define XR_GLYPH_FIRST 32
+#define XR_GLYPH_LAST  126
+#define XR_BASELINE    18
+
+static int g_xr_ok = 0;
+static Pixmap g_xr_pixmap = 0;
+static Picture g_xr_back = 0;          //ARGB32 backbuffer on g_xr_pixmap
+static Picture g_xr_win = 0;           //the overlay window
+static Picture g_xr_white = 0;         //solid white text source
+static GlyphSet g_xr_glyphs = 0;
+static XRenderPictFormat *g_xr_a8 = NULL;
+static int g_xr_back_valid = 0;        //backbuffer holds the cached text
+
+static const XCharStruct *xr_char_metrics(const XFontStruct *font, int c) {
+  if (font->per_char &&
+      (unsigned int)c >= font->min_char_or_byte2 &&
+      (unsigned int)c <= font->max_char_or_byte2) {
+    return &font->per_char[c - (int)font->min_char_or_byte2];
+  }
+  return &font->max_bounds;
+}
+
+//rasterize the printable ASCII range once: all glyphs are drawn side by side
+//into one 1-bit pixmap, read back with a single XGetImage and uploaded with
+//a single XRenderAddGlyphs
+static int xr_build_glyphs(XFontStruct *font) {
+  enum { NGLYPHS = XR_GLYPH_LAST - XR_GLYPH_FIRST + 1 };
+  int asc = font->ascent;
+  int h = font->ascent + font->descent;
+  if (h <= 0) return 0;
+
+  int xs[NGLYPHS], ws[NGLYPHS];
+  int total_w = 0;
+  size_t data_size = 0;
+  for (int i = 0; i < NGLYPHS; ++i) {
+    const XCharStruct *cs = xr_char_metrics(font, XR_GLYPH_FIRST + i);
+    int gw = cs->rbearing - cs->lbearing;
+    if (gw < 0) gw = 0;
+    xs[i] = total_w;
+    ws[i] = gw;
+    total_w += gw + 1;
+    data_size += (size_t)((gw + 3) & ~3) * (size_t)h;   //A8 rows are 32-bit padded
+  }
+
+  Pixmap pm = XCreatePixmap(dpy, g_overlay_win, (unsigned int)total_w, (unsigned int)h, 1);
+  GC gc = XCreateGC(dpy, pm, 0, NULL);
+  XSetForeground(dpy, gc, 0);
+  XFillRectangle(dpy, pm, gc, 0, 0, (unsigned int)total_w, (unsigned int)h);
+  XSetForeground(dpy, gc, 1);
+  XSetFont(dpy, gc, font->fid);
+  for (int i = 0; i < NGLYPHS; ++i) {
+    const XCharStruct *cs = xr_char_metrics(font, XR_GLYPH_FIRST + i);
+    char ch = (char)(XR_GLYPH_FIRST + i);
+    XDrawString(dpy, pm, gc, xs[i] - cs->lbearing, asc, &ch, 1);
+  }
+  XImage *img = XGetImage(dpy, pm, 0, 0, (unsigned int)total_w, (unsigned int)h,
+                          AllPlanes, ZPixmap);
+  XFreeGC(dpy, gc);
+  XFreePixmap(dpy, pm);
+  if (!img) return 0;
+
+  char *data = (char *)calloc(data_size ? data_size : 1, 1);
+  if (!data) {
+    XDestroyImage(img);
+    return 0;
+  }
+
+  Glyph ids[NGLYPHS];
+  XGlyphInfo infos[NGLYPHS];
+  char *out = data;
+  for (int i = 0; i < NGLYPHS; ++i) {
+    const XCharStruct *cs = xr_char_metrics(font, XR_GLYPH_FIRST + i);
+    int stride = (ws[i] + 3) & ~3;
+    for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < ws[i]; ++x) {
+        if (XGetPixel(img, xs[i] + x, y)) out[y * stride + x] = (char)0xFF;
+      }
+    }
+    out += (size_t)stride * (size_t)h;
+
+    ids[i] = (Glyph)(XR_GLYPH_FIRST + i);
+    infos[i].width  = (unsigned short)ws[i];
+    infos[i].height = (unsigned short)h;
+    infos[i].x      = (short)(-cs->lbearing);
+    infos[i].y      = (short)asc;
+    infos[i].xOff   = cs->width;
+    infos[i].yOff   = 0;
+  }
+  XRenderAddGlyphs(dpy, g_xr_glyphs, ids, infos, NGLYPHS, data, (int)data_size);
+
+  free(data);
+  XDestroyImage(img);
+  return 1;
+}
+
+//rasterize the printable ASCII range from the FreeType face into one buffer
+//and upload it with a single XRenderAddGlyphs, like the core glyphs: gray
+//coverage goes into the A8 glyphs as is, bitmap strikes become 0/255
+static int xr_build_glyphs_xft(XftFont *xf) {
+  enum { NGLYPHS = XR_GLYPH_LAST - XR_GLYPH_FIRST + 1 };
+  FT_Face face = XftLockFace(xf);
+  if (!face) return 0;
+
+  Glyph ids[NGLYPHS];
+  XGlyphInfo infos[NGLYPHS];
+  char *data = NULL;
+  size_t data_size = 0;
+  int n = 0, ok = 1;
+  for (int i = 0; ok && i < NGLYPHS; ++i) {
+    //a glyph the face does not have is left out
+    if (FT_Load_Char(face, (FT_ULong)(XR_GLYPH_FIRST + i), FT_LOAD_RENDER | FT_LOAD_TARGET_NORMAL))
+      continue;
+    const FT_GlyphSlot g = face->glyph;
+    const FT_Bitmap *bm = &g->bitmap;
+    int w = (int)bm->width, h = (int)bm->rows;
+    int stride = (w + 3) & ~3;   //A8 rows are 32-bit padded
+    size_t size = (size_t)stride * (size_t)h;
+    char *grown = (char *)realloc(data, data_size + size + 1);
+    if (!grown) {
+      ok = 0;
+      break;
+    }
+    data = grown;
+    char *out = data + data_size;
+    memset(out, 0, size);
+    for (int y = 0; y < h; ++y) {
+      const unsigned char *row = bm->buffer + (ptrdiff_t)y * bm->pitch;
+      for (int x = 0; x < w; ++x) {
+        if (bm->pixel_mode == FT_PIXEL_MODE_GRAY)
+          out[y * stride + x] = (char)row[x];
+        else if (bm->pixel_mode == FT_PIXEL_MODE_MONO && (row[x >> 3] & (0x80 >> (x & 7))))
+          out[y * stride + x] = (char)0xFF;
+      }
+    }
+    data_size += size;
+
+    ids[n] = (Glyph)(XR_GLYPH_FIRST + i);
+    infos[n].width  = (unsigned short)w;
+    infos[n].height = (unsigned short)h;
+    infos[n].x      = (short)(-g->bitmap_left);
+    infos[n].y      = (short)g->bitmap_top;
+    infos[n].xOff   = (short)((g->advance.x + 32) >> 6);
+    infos[n].yOff   = 0;
+    ++n;
+  }
+  XftUnlockFace(xf);
+  if (ok && n > 0) XRenderAddGlyphs(dpy, g_xr_glyphs, ids, infos, n, data, (int)data_size);
+  free(data);
+  return ok && n > 0;
+}
+
+static void xr_backbuffer_create(void) {
+  if (g_xr_back) XRenderFreePicture(dpy, g_xr_back);
+  if (g_xr_pixmap) XFreePixmap(dpy, g_xr_pixmap);
+
+  g_xr_pixmap = XCreatePixmap(dpy, g_overlay_win, g_overlay_w, g_overlay_h, 32);
+  g_xr_back = XRenderCreatePicture(dpy, g_xr_pixmap,
+                                   XRenderFindStandardFormat(dpy, PictStandardARGB32),
+                                   0, NULL);
+  g_xr_back_valid = 0;
+}
+
+static void xr_init(void) {
+  g_xr_ok = 0;
+  int ev_base, err_base;
+  if (!XRenderQueryExtension(dpy, &ev_base, &err_base)) return;
+
+  XRenderPictFormat *win_fmt = XRenderFindVisualFormat(dpy, g_argb_visual);
+  g_xr_a8 = XRenderFindStandardFormat(dpy, PictStandardA8);
+  if (!win_fmt || !g_xr_a8) return;
+
+  //core glyphs need metrics even when "Renner" is missing
+  if (!g_overlay_xft && !g_overlay_font) {
+    g_overlay_font = XLoadQueryFont(dpy, "fixed");
+    if (!g_overlay_font) return;
+  }
+
+  g_xr_glyphs = XRenderCreateGlyphSet(dpy, g_xr_a8);
+  int built = g_overlay_xft && xr_build_glyphs_xft(g_overlay_xft);
+  if (!built && g_overlay_font) built = xr_build_glyphs(g_overlay_font);
+  if (!built) {
+    XRenderFreeGlyphSet(dpy, g_xr_glyphs);
+    g_xr_glyphs = 0;
+    return;
+  }
+
+  XRenderColor white = { 0xffff, 0xffff, 0xffff, 0xffff };
+  g_xr_white = XRenderCreateSolidFill(dpy, &white);
+  g_xr_win = XRenderCreatePicture(dpy, g_overlay_win, win_fmt, 0, NULL);
+  xr_backbuffer_create();
+  g_xr_ok = 1;
+}
+
+//compose the cached text into the backbuffer
+static void xr_render_text(void) {
+  XRenderColor clear = { 0, 0, 0, 0 };
+  XRenderFillRectangle(dpy, PictOpSrc, g_xr_back, &clear, 0, 0, g_overlay_w, g_overlay_h);
+  if (g_overlay_text_len > 0) {
+    XRenderCompositeString8(dpy, PictOpOver, g_xr_white, g_xr_back, g_xr_a8, g_xr_glyphs,
+                            0, 0, 4, XR_BASELINE, g_overlay_text, g_overlay_text_len);
+  }
+  g_xr_back_valid = 1;
+}
+
+//try to load "Renner" font; if missing (NULL), X11 uses a default font
+static XFontStruct *overlay_font_load(void) {
+  XFontStruct *f = XLoadQueryFont(dpy, "Renner-12");
+  if (!f) f = XLoadQueryFont(dpy, "Renner");
+  return f;
+}
+
+//the same face through fontconfig for the XRender glyphs; fontconfig picks
+//its closest match when "Renner" is not installed
+static XftFont *overlay_xft_load(void) {
+  return XftFontOpenName(dpy, DefaultScreen(dpy), "Renner-12:antialias=true");
+}
+
+static void overlay_init(void) {
+  if (!dpy) return;
+
+  int screen = DefaultScreen(dpy);
+  Window root = RootWindow(dpy, screen);
+
+  unsigned int width = OVERLAY_WIDTH_FULL;
+  unsigned int height = OVERLAY_HEIGHT;
+
+  //if we do not have an ARGB visual yet (32‑bit with alpha), try to pick one now
+  if (!g_argb_visual) {
+    XVisualInfo vinfo;
+    if (XMatchVisualInfo(dpy, screen, 32, TrueColor, &vinfo)) {
+      g_argb_visual = vinfo.visual;
+      g_argb_depth = vinfo.depth;
+      g_argb_colormap = XCreateColormap(dpy, root, g_argb_visual, AllocNone);
+    }
+  }
+
+  XSetWindowAttributes attrs;
+  unsigned long valuemask = 0;
+
+  if (g_argb_visual && g_argb_depth > 0 && g_argb_colormap) {
+    //create an ARGB window with fully transparent background
+    attrs.colormap = g_argb_colormap;
+    attrs.border_pixel = 0;
     attrs.background_pixel = 0;  //ARGB = 0x00000000 (full alpha 0)
     attrs.override_redirect = True;
     valuemask = CWColormap | CWBorderPixel | CWBackPixel | CWOverrideRedirect;
 
-    g_overlay_win = XCreateWindow(
-        dpy, root,
-        0, 0,
-        width, height,
-        0,
-        g_argb_depth,
-        InputOutput,
-        g_argb_visual,
-        valuemask, &attrs);
+    g_overlay_win = XCreateWindow(
+        dpy, root,
+        0, 0,
+        width, height,
+        0,
+        g_argb_depth,
+        InputOutput,
+        g_argb_visual,
+        valuemask, &attrs);
+  } else {
+    //fallback: standard visual without per‑pixel alpha
+    attrs.override_redirect = True;
+    valuemask = CWOverrideRedirect;
+
+    g_overlay_win = XCreateWindow(
+        dpy, root,
+        0, 0,
+        width, height,
+        0,
+        CopyFromParent,
+        InputOutput,
+        CopyFromParent,
+        valuemask, &attrs);
+  }
+  g_overlay_w = width;
+  g_overlay_h = height;
+  g_overlay_gen = 0;
+
+  //no static backbuffer, so the compositor does not reuse an old screenshot
+  XSetWindowBackgroundPixmap(dpy, g_overlay_win, None);
+
+  if (g_overlay_gc) {
+    XFreeGC(dpy, g_overlay_gc);
+  }
+  g_overlay_gc = XCreateGC(dpy, g_overlay_win, 0, NULL);
+
+  //g_overlay_font comes from overlay_font_load(), on the startup thread
+
+  //color used for overlay text (usually white)
+  if (g_argb_colormap) {
+    XColor col, dummy;
+    if (XAllocNamedColor(dpy, g_argb_colormap, "white", &col, &dummy)) {
+      g_overlay_white_pixel = col.pixel;
+    } else {
+      g_overlay_white_pixel = WhitePixel(dpy, screen);
+    }
+  } else {
+    g_overlay_white_pixel = WhitePixel(dpy, screen);
+  }
+
+  //composited rendering when possible, core drawing otherwise
+  if (g_argb_visual && g_argb_depth > 0 && g_argb_colormap) {
+    xr_init();
+  }
+
+  //StructureNotify keeps g_overlay_w/h current without querying the server
+  XSelectInput(dpy, g_overlay_win, ExposureMask | StructureNotifyMask);
+}
+
+//rebuild cached text and metrics; returns 1 if the text changed
+static int overlay_update_text(void) {
+  uint64_t st = state_load();
+  unsigned int gen = st_gen(st);
+  if (gen == g_overlay_gen) return 0;
+  g_overlay_gen = gen;
+  uint32_t f = st_flags(st);
+
+  hud_span text = hud_compose(f);
+  g_overlay_text = text.s;
+  g_overlay_text_len = (int)text.len;
+
+  //the cleared area must also cover a longer previous text
+  int text_width = (int)g_overlay_w;
+  int text_height = OVERLAY_HEIGHT;
+  if (g_overlay_font && g_overlay_text_len > 0) {
+    text_width = XTextWidth(g_overlay_font, g_overlay_text, g_overlay_text_len);
+    text_height = g_overlay_font->ascent + g_overlay_font->descent;
+  }
+  unsigned int clear_w = (unsigned int)(text_width + 8);
+  unsigned int clear_h = (unsigned int)(text_height + 4);
+  if (clear_w < g_overlay_clear_w) clear_w = g_overlay_clear_w;
+  if (clear_h < g_overlay_clear_h) clear_h = g_overlay_clear_h;
+  if (clear_w > g_overlay_w) clear_w = g_overlay_w;
+  if (clear_h > g_overlay_h) clear_h = g_overlay_h;
+  g_overlay_clear_w = clear_w;
+  g_overlay_clear_h = clear_h;
+  return 1;
+}
+
+//paint the cached text (also used for Expose)
+static void overlay_paint(void) {
+  if (!dpy || !g_overlay_win) return;
+  if (atomic_load(&g_overlay_hidden)) return;
+  int changed = overlay_update_text();
+
+  if (g_xr_ok) {
+    if (changed || !g_xr_back_valid) xr_render_text();
+    XRenderComposite(dpy, PictOpSrc, g_xr_back, None, g_xr_win,
+                     0, 0, 0, 0, 0, 0, g_overlay_w, g_overlay_h);
+    XFlush(dpy);
+    return;
+  }
+
+  //use Renner font if it was loaded
+  if (g_overlay_font) {
+    XSetFont(dpy, g_overlay_gc, g_overlay_font->fid);
+  }
+
+  //clear only the text region to alpha 0 when using ARGB
+  if (g_argb_visual && g_argb_depth > 0 && g_argb_colormap) {
+    XSetForeground(dpy, g_overlay_gc, 0x00000000u);
+    XFillRectangle(dpy, g_overlay_win, g_overlay_gc,
+                   0, 0, g_overlay_clear_w, g_overlay_clear_h);
+  }
+
+  int screen = DefaultScreen(dpy);
+  unsigned long white_pixel = g_overlay_white_pixel ? g_overlay_white_pixel
+                                                    : WhitePixel(dpy, screen);
+
+  XSetForeground(dpy, g_overlay_gc, white_pixel);
+  XDrawString(dpy, g_overlay_win, g_overlay_gc, 4, 18, g_overlay_text, g_overlay_text_len);
+  XFlush(dpy);
+}
+
+//track the overlay size from ConfigureNotify
+static void overlay_configured(const XConfigureEvent *ce) {
+  if (ce->width <= 0 || ce->height <= 0) return;
+  unsigned int w = (unsigned int)ce->width, h = (unsigned int)ce->height;
+  if (w == g_overlay_w && h == g_overlay_h) return;
+
+  g_overlay_w = w;
+  g_overlay_h = h;
+  g_overlay_gen = 0;           //recompute the cleared area
+  g_overlay_clear_w = 0;
+  g_overlay_clear_h = 0;
+  if (g_xr_ok) xr_backbuffer_create();
+}
+
+//repaint only if the HUD state changed since the last frame
+static void overlay_draw(void) {
+  if (!dpy || !g_overlay_win) return;
+  if (atomic_load(&g_overlay_hidden)) return;
+  if (st_gen(state_load()) == g_overlay_gen) return;
+  uint64_t t0 = now_ns();
+  overlay_paint();
+  hist_record(&g_hist_overlay, now_ns() - t0);
+  trace_span("overlay_draw", t0, NULL, 0);
+}
+
+#endif //!_WIN32
+
+//--------------- overlay rendering for Windows ---
+#ifdef _WIN32
+//the HUD is drawn into a persistent 32-bit DIB with per-pixel alpha and
+//pushed with UpdateLayeredWindow; there is no WM_PAINT / erase at all
+
+static HDC g_overlay_dc = NULL;            //memory DC, DIB and font stay selected
+static HBITMAP g_overlay_bmp = NULL;
+static HGDIOBJ g_overlay_old_bmp = NULL;
+static uint32_t *g_overlay_bits = NULL;    //top-down BGRA, premultiplied
+static unsigned int g_overlay_gen = 0;     //state generation currently on screen
+
+static int overlay_dib_init(void) {
+  HDC screen = GetDC(NULL);
+  g_overlay_dc = CreateCompatibleDC(screen);
+  ReleaseDC(NULL, screen);
+  if (!g_overlay_dc) return 0;
+
+  BITMAPINFO bi;
+  ZeroMemory(&bi, sizeof(bi));
+  bi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+  bi.bmiHeader.biWidth = (LONG)OVERLAY_WIDTH_FULL;
+  bi.bmiHeader.biHeight = -(LONG)OVERLAY_HEIGHT;   //negative = top-down rows
+  bi.bmiHeader.biPlanes = 1;
+  bi.bmiHeader.biBitCount = 32;
+  bi.bmiHeader.biCompression = BI_RGB;
+
+  void *bits = NULL;
+  g_overlay_bmp = CreateDIBSection(g_overlay_dc, &bi, DIB_RGB_COLORS, &bits, NULL, 0);
+  if (!g_overlay_bmp || !bits) {
+    DeleteDC(g_overlay_dc);
+    g_overlay_dc = NULL;
+    return 0;
+  }
+  g_overlay_bits = (uint32_t *)bits;
+  g_overlay_old_bmp = SelectObject(g_overlay_dc, g_overlay_bmp);
+
+  if (g_overlay_font) {
+    SelectObject(g_overlay_dc, g_overlay_font);
+  }
+  SetBkMode(g_overlay_dc, TRANSPARENT);
+  SetTextColor(g_overlay_dc, RGB(255, 255, 255));
+  g_overlay_gen = 0;
+  return 1;
+}
+
+static void overlay_dib_destroy(void) {
+  if (g_overlay_dc) {
+    SelectObject(g_overlay_dc, g_overlay_old_bmp);
+    DeleteDC(g_overlay_dc);
+    g_overlay_dc = NULL;
+  }
+  if (g_overlay_bmp) {
+    DeleteObject(g_overlay_bmp);
+    g_overlay_bmp = NULL;
+  }
+  g_overlay_bits = NULL;
+}
+
+//draw the HUD text for the action flags f into the DIB
+static void overlay_render_dib(uint32_t f) {
+  hud_span text = hud_compose(f);
+
+  //white text on a fully transparent background
+  const size_t npix = (size_t)OVERLAY_WIDTH_FULL * OVERLAY_HEIGHT;
+  ZeroMemory(g_overlay_bits, npix * sizeof(uint32_t));
+  RECT rc = { 0, 0, (LONG)OVERLAY_WIDTH_FULL, (LONG)OVERLAY_HEIGHT };
+  DrawTextA(g_overlay_dc, text.s, (int)text.len, &rc, DT_LEFT | DT_VCENTER | DT_SINGLELINE);
+  GdiFlush();
+
+  //GDI leaves alpha at 0; the grey coverage of white text is the alpha,
+  //and premultiplied white of alpha a is (a, a, a)
+  for (size_t i = 0; i < npix; ++i) {
+    uint32_t px = g_overlay_bits[i];
+    if (!px) continue;
+    uint32_t r = (px >> 16) & 0xFFu, g = (px >> 8) & 0xFFu, b = px & 0xFFu;
+    uint32_t a = r > g ? r : g;
+    if (b > a) a = b;
+    g_overlay_bits[i] = (a << 24) | (a << 16) | (a << 8) | a;
+  }
+}
+
+//redraw the DIB and push it, only if the HUD state changed
+static void overlay_draw(void) {
+  if (!g_overlay_hwnd || !g_overlay_dc) return;
+  if (atomic_load(&g_overlay_hidden)) return;
+
+  uint64_t st = state_load();
+  unsigned int gen = st_gen(st);
+  if (gen == g_overlay_gen) return;
+  g_overlay_gen = gen;
+  uint64_t t0 = now_ns();
+
+  overlay_render_dib(st_flags(st));
+
+  SIZE size = { (LONG)OVERLAY_WIDTH_FULL, (LONG)OVERLAY_HEIGHT };
+  POINT src = { 0, 0 };
+  BLENDFUNCTION blend = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+  UpdateLayeredWindow(g_overlay_hwnd, NULL, NULL, &size, g_overlay_dc, &src,
+                      0, &blend, ULW_ALPHA);
+  hist_record(&g_hist_overlay, now_ns() - t0);
+  trace_span("overlay_draw", t0, NULL, 0);
+}
+#endif
+
+//--------------- worker scheduling -------------------
+//applied by the worker to itself at start. every step falls back to the
+//next weaker one when the OS refuses it; the result goes to the stats.
+
+#ifdef _WIN32
+typedef HANDLE (WINAPI *av_set_mm_fn)(LPCSTR, LPDWORD);
+typedef BOOL (WINAPI *av_set_prio_fn)(HANDLE, int);
+typedef BOOL (WINAPI *av_revert_fn)(HANDLE);
+#define AVRT_PRIO_HIGH     1   //AVRT_PRIORITY_HIGH
+#define AVRT_PRIO_CRITICAL 2   //AVRT_PRIORITY_CRITICAL
+
+//avrt.dll is loaded on demand so the build needs no extra import library
+static HMODULE g_avrt = NULL;
+static HANDLE g_worker_mmcss = NULL;
+
+static const char *thread_prio_name(int p) {
+  switch (p) {
+    case THREAD_PRIORITY_TIME_CRITICAL: return "TIME_CRITICAL";
+    case THREAD_PRIORITY_HIGHEST:       return "HIGHEST";
+    case THREAD_PRIORITY_ABOVE_NORMAL:  return "ABOVE_NORMAL";
+    case THREAD_PRIORITY_NORMAL:        return "NORMAL";
+    default:                            return "other";
+  }
+}
+
+//register the calling thread with MMCSS as a "Games" task
+static int worker_join_mmcss(int avrt_prio) {
+  g_avrt = LoadLibraryA("avrt.dll");
+  if (!g_avrt) return 0;
+  av_set_mm_fn set_mm = (av_set_mm_fn)(void (*)(void))GetProcAddress(g_avrt, "AvSetMmThreadCharacteristicsA");
+  av_set_prio_fn set_prio = (av_set_prio_fn)(void (*)(void))GetProcAddress(g_avrt, "AvSetMmThreadPriority");
+  DWORD task = 0;
+  if (set_mm) g_worker_mmcss = set_mm("Games", &task);
+  if (!g_worker_mmcss) {
+    fprintf(stderr, "Warning: MMCSS \"Games\" unavailable (error %lu)\n", GetLastError());
+    FreeLibrary(g_avrt);
+    g_avrt = NULL;
+    return 0;
+  }
+  if (set_prio) set_prio(g_worker_mmcss, avrt_prio);
+  return 1;
+}
+
+static void apply_worker_sched(char *desc, size_t size) {
+  int prio = g_worker_sched.priority;
+  HANDLE self = GetCurrentThread();
+  int mmcss = 0;
+
+  //high = MMCSS alone (or HIGHEST without it); realtime adds TIME_CRITICAL
+  if (prio != WORKER_PRIO_NORMAL)
+    mmcss = worker_join_mmcss(prio == WORKER_PRIO_REALTIME ? AVRT_PRIO_CRITICAL : AVRT_PRIO_HIGH);
+  if (prio == WORKER_PRIO_REALTIME &&
+      !SetThreadPriority(self, THREAD_PRIORITY_TIME_CRITICAL)) {
+    fprintf(stderr, "Warning: cannot make the worker TIME_CRITICAL (error %lu)\n", GetLastError());
+    prio = WORKER_PRIO_HIGH;
+  }
+  if (prio == WORKER_PRIO_HIGH && !mmcss)
+    SetThreadPriority(self, THREAD_PRIORITY_HIGHEST);
+
+  char aff[48] = "";
+  if (g_worker_sched.affinity) {
+    if (SetThreadAffinityMask(self, (DWORD_PTR)g_worker_sched.affinity))
+      snprintf(aff, sizeof(aff), ", affinity 0x%llx", g_worker_sched.affinity);
+    else
+      fprintf(stderr, "Warning: cannot set worker affinity 0x%llx (error %lu)\n",
+              g_worker_sched.affinity, GetLastError());
+  }
+  snprintf(desc, size, "%s%s%s", mmcss ? "MMCSS Games, " : "",
+           thread_prio_name(GetThreadPriority(self)), aff);
+}
+
+static void release_worker_sched(void) {
+  if (!g_worker_mmcss) return;
+  av_revert_fn revert = (av_revert_fn)(void (*)(void))GetProcAddress(g_avrt, "AvRevertMmThreadCharacteristics");
+  if (revert) revert(g_worker_mmcss);
+  FreeLibrary(g_avrt);
+  g_worker_mmcss = NULL;
+  g_avrt = NULL;
+}
+#else
+static void apply_worker_sched(char *desc, size_t size) {
+  int prio = g_worker_sched.priority;
+  char pol[64];
+  snprintf(pol, sizeof(pol), "SCHED_OTHER");
+
+  if (prio == WORKER_PRIO_REALTIME) {
+    int policy = g_worker_sched.rt_rr ? SCHED_RR : SCHED_FIFO;
+    const char *name = g_worker_sched.rt_rr ? "SCHED_RR" : "SCHED_FIFO";
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    sp.sched_priority = g_worker_sched.rt_priority;
+    int err = pthread_setschedparam(pthread_self(), policy, &sp);
+    if (err == 0) {
+      snprintf(pol, sizeof(pol), "%s priority %d", name, g_worker_sched.rt_priority);
+    } else {
+      //usually EPERM without CAP_SYS_NICE or an RLIMIT_RTPRIO grant
+      fprintf(stderr, "Warning: cannot give the worker %s (%s), trying nice %d\n",
+              name, strerror(err), g_worker_sched.nice);
+      prio = WORKER_PRIO_HIGH;
+    }
+  }
+  if (prio == WORKER_PRIO_HIGH) {
+    //on Linux a thread id makes setpriority apply to this thread only
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    if (setpriority(PRIO_PROCESS, (id_t)tid, g_worker_sched.nice) == 0)
+      snprintf(pol, sizeof(pol), "SCHED_OTHER nice %d", g_worker_sched.nice);
+    else
+      fprintf(stderr, "Warning: cannot set worker nice %d (%s)\n",
+              g_worker_sched.nice, strerror(errno));
+  }
+
+  char aff[48] = "";
+  if (g_worker_sched.affinity) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < 64; ++cpu) {
+      if (g_worker_sched.affinity >> cpu & 1u) CPU_SET(cpu, &set);
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err == 0)
+      snprintf(aff, sizeof(aff), ", affinity 0x%llx", g_worker_sched.affinity);
+    else
+      fprintf(stderr, "Warning: cannot set worker affinity 0x%llx (%s)\n",
+              g_worker_sched.affinity, strerror(err));
+  }
+  snprintf(desc, size, "%s%s", pol, aff);
+}
+
+static void release_worker_sched(void) {}
+#endif
+
+//--------------- worker thread -------------------
+static void set_all_up(void) {
+  state_update(ST_ACTIONS, 0);
+
+  //release whatever running macros hold
+  inj_batch b;
+  inj_begin(&b);
+  for (int i = 0; i < ACTION_MAX; ++i) {
+    if (g_macro_runs[i].active) macro_stop(i, &g_macro_runs[i], &b);
+  }
+  if (g_replay.active) replay_stop(&g_replay, &b);
+  inj_send(&b);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_thread(LPVOID unused)   //background loop for actions (Windows)
+#else
+static void* worker_thread(void* unused)           //background loop for actions (Linux)
+#endif
+{
+  (void)unused;
+  uint32_t seen_gen = 0;
+  trace_thread("worker");
+
+  apply_worker_sched(g_worker_sched_desc, sizeof(g_worker_sched_desc));
+  atomic_store_explicit(&g_worker_sched_ready, 1, memory_order_release);
+  printf("Worker scheduling: %s\n", g_worker_sched_desc);
+
+  while (atomic_load(&g_running)) {
+    //one load gives a consistent snapshot of every flag; commands pushed
+    //before that state change are already visible in the ring
+    uint64_t st = state_load();
+    uint32_t f = st_flags(st);
+
+    //a new state may come from a hotkey: time its first injected event
+    uint64_t t_hotkey = 0;
+    if (st_gen(st) != seen_gen) {
+      seen_gen = st_gen(st);
+      t_hotkey = atomic_exchange_explicit(&g_hotkey_t0, 0, memory_order_acquire);
+    }
+
+    worker_cmd cmd;
+    while (cmd_pop(&cmd)) {
+      if (cmd.type == CMD_MACRO_SET) {
+        macro_set_adopt((macro_set *)cmd.data);
+        continue;
+      }
+      if (cmd.type == CMD_TARGETS_SET) {
+        free(g_targets);
+        g_targets = (target_set *)cmd.data;
+        //windows that just joined have not seen the last move
+        g_inj_ptr.valid = 0;
+        continue;
+      }
+      if (cmd.type == CMD_REPLAY_LOAD) {
+        inj_batch rb;
+        inj_begin(&rb);
+        replay_load(&g_replay, &rb, cmd.data, cmd.len);
+        inj_send(&rb);
+        continue;
+      }
+      if (cmd.action < 0 || cmd.action >= ACTION_MAX) continue;
+      macro_run *r = &g_macro_runs[cmd.action];
+      switch (cmd.type) {
+        case CMD_SET_CLICK_POS:
+          r->save_x = cmd.x;
+          r->save_y = cmd.y;
+          break;
+        case CMD_SET_INTERVAL:
+          if (cmd.ns > 0) {
+            r->interval_ns = cmd.ns;
+            atomic_store_explicit(&g_rate[cmd.action].interval_ns, cmd.ns, memory_order_relaxed);
+          }
+          break;
+        case CMD_SET_LATE:
+          r->late = cmd.x;
+          break;
+        default:
+          break;
+      }
+    }
+
+    //everything decided in one pass goes out as one batch
+    inj_batch b;
+    inj_begin(&b);
+
+    uint64_t now = now_ns();
+    uint64_t deadline = WAIT_FOREVER;
+    uint32_t finished = 0;
+    for (int i = 0; i < ACTION_MAX; ++i) {
+      macro_run *r = &g_macro_runs[i];
+      //a run keeps its own set; only new runs pick up a reloaded one
+      const macro_set *set = r->active ? r->set : g_macro_cur;
+      if (!set || set->defs[i].len == 0) continue;
+      //copied: stopping the run may free an old set
+      uint32_t bit = set->defs[i].bit;
+
+      if (!(f & bit)) {
+        if (r->active) macro_stop(i, r, &b);
+        continue;
+      }
+      if (!r->active) macro_start(r, g_macro_cur, now);
+
+      //suspended or unfocused runs release their input and keep their place
+      if (f & ST_PAUSED) {
+        if (!r->paused) macro_pause(i, r, &b, now);
+        continue;
+      }
+      if (r->paused) macro_resume(r, &b, now);
+
+      if (macro_step(i, r, &b, now)) {
+        finished |= bit;
+        continue;
+      }
+      if (r->deadline != WAIT_FOREVER && (deadline == WAIT_FOREVER || r->deadline < deadline))
+        deadline = r->deadline;
+    }
+
+    //recorded input, same pause/resume rules as the macros
+    replay_run *rp = &g_replay;
+    if (!(f & ST_REPLAY)) {
+      if (rp->active) replay_stop(rp, &b);
+    } else if (rp->ev) {
+      if (!rp->active) replay_start(rp, now);
+      if (f & ST_PAUSED) {
+        if (!rp->paused) replay_pause(rp, &b, now);
+      } else {
+        if (rp->paused) replay_resume(rp, &b, now);
+        if (replay_step(rp, &b, now)) {
+          finished |= ST_REPLAY;
+        } else if (deadline == WAIT_FOREVER || rp->deadline < deadline) {
+          deadline = rp->deadline;
+        }
+      }
+    }
+
+    int injected = b.n;
+    uint64_t t_send = trace_now();
+    inj_send(&b);
+    if (injected) trace_span("inject", t_send, "events", injected);
+    if (t_hotkey && injected) hist_record(&g_hist_inject, now_ns() - t_hotkey);
+
+    //macros that ran to their end switch themselves off
+    if (finished) {
+      state_update(finished, 0);
+      ui_notify();
+      continue;
+    }
+
+    //sleep until the next step is due or a hotkey changes something
+    worker_wait(deadline);
+  }
+
+  //make sure everything is released
+  set_all_up();
+  free(g_targets);
+  g_targets = NULL;
+  if (g_replay.map) rec_unmap(g_replay.map, g_replay.map_len);
+  release_worker_sched();
+
+#ifdef _WIN32
+  return 0;
+#else
+  return NULL;
+#endif
+}
+
+//--------------- input capture and recording files ---------------
+
+#ifdef _WIN32
+//low-level hooks run on the thread that installed them, i.e. inside the
+//main GetMessage loop; they only stamp and queue the event
+
+static HHOOK g_rec_kb_hook = NULL;
+static HHOOK g_rec_mouse_hook = NULL;
+static uint8_t g_rec_skip_vk[256 / 8];   //our own hotkeys are not recorded
+
+static LRESULT CALLBACK rec_kb_proc(int code, WPARAM wp, LPARAM lp) {
+  if (code == HC_ACTION) {
+    const KBDLLHOOKSTRUCT *k = (const KBDLLHOOKSTRUCT *)lp;
+    int skip = (k->flags & LLKHF_INJECTED) ||
+               (k->vkCode < 256 && (g_rec_skip_vk[k->vkCode >> 3] & (1u << (k->vkCode & 7))));
+    if (!skip) {
+      int hw = (int)(k->scanCode & 0xFFu) | ((k->flags & LLKHF_EXTENDED) ? KEYTAB_EXTENDED : 0);
+      rec_push(REC_KEY, hw, wp == WM_KEYDOWN || wp == WM_SYSKEYDOWN, 0, 0);
+    }
+  }
+  return CallNextHookEx(NULL, code, wp, lp);
+}
+
+static LRESULT CALLBACK rec_mouse_proc(int code, WPARAM wp, LPARAM lp) {
+  if (code == HC_ACTION) {
+    const MSLLHOOKSTRUCT *m = (const MSLLHOOKSTRUCT *)lp;
+    if (!(m->flags & LLMHF_INJECTED)) {
+      switch (wp) {
+        case WM_MOUSEMOVE:   rec_push(REC_MOVE, 0, 0, (int)m->pt.x, (int)m->pt.y); break;
+        case WM_LBUTTONDOWN: rec_push(REC_BUTTON, 0, 1, 0, 0); break;
+        case WM_LBUTTONUP:   rec_push(REC_BUTTON, 0, 0, 0, 0); break;
+        case WM_RBUTTONDOWN: rec_push(REC_BUTTON, 1, 1, 0, 0); break;
+        case WM_RBUTTONUP:   rec_push(REC_BUTTON, 1, 0, 0, 0); break;
+        default: break;
+      }
+    }
+  }
+  return CallNextHookEx(NULL, code, wp, lp);
+}
+
+static void rec_capture_stop(void) {
+  if (g_rec_kb_hook) UnhookWindowsHookEx(g_rec_kb_hook);
+  if (g_rec_mouse_hook) UnhookWindowsHookEx(g_rec_mouse_hook);
+  g_rec_kb_hook = NULL;
+  g_rec_mouse_hook = NULL;
+}
+
+static int rec_capture_start(void) {
+  memset(g_rec_skip_vk, 0, sizeof(g_rec_skip_vk));
+  for (int i = 0; i < ACTION_MAX; ++i) {
+    int vk = g_cfg->keys[i];
+    if (vk > 0 && vk < 256) g_rec_skip_vk[vk >> 3] |= (uint8_t)(1u << (vk & 7));
+  }
+  g_rec_skip_vk[VK_HIDE_OVERLAY >> 3] |= (uint8_t)(1u << (VK_HIDE_OVERLAY & 7));
+
+  HINSTANCE inst = GetModuleHandleW(NULL);
+  g_rec_kb_hook = SetWindowsHookExW(WH_KEYBOARD_LL, rec_kb_proc, inst, 0);
+  g_rec_mouse_hook = SetWindowsHookExW(WH_MOUSE_LL, rec_mouse_proc, inst, 0);
+  if (!g_rec_kb_hook || !g_rec_mouse_hook) {
+    fprintf(stderr, "Warning: cannot install input hooks for recording\n");
+    rec_capture_stop();
+    return 0;
+  }
+  return 1;
+}
+
+//map a recording read-only; the view stays valid after the handles are closed
+static const void *rec_map_file(const char *path, size_t *len) {
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return NULL;
+
+  const void *base = NULL;
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping) {
+      base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+    *len = (size_t)size.QuadPart;
+  }
+  CloseHandle(file);
+  return base;
+}
+
+static void rec_unmap(const void *base, size_t len) {
+  (void)len;
+  UnmapViewOfFile(base);
+}
+
+#else
+//XRecord delivers device events on its own connection, which blocks in
+//XRecordEnableContext() on a dedicated thread until the context is disabled
+
+static Display *g_rec_dpy = NULL;   //data connection, used by the record thread only
+static XRecordContext g_rec_ctx = 0;
+static pthread_t g_rec_thread;
+static uint8_t g_rec_skip_kc[256 / 8];   //our own hotkeys are not recorded
+
+//XRecord reports our own XTest/uinput output like real input, without the
+//device it came from. it is not recorded (as LLKHF_INJECTED on Windows) while
+//an action that produces that kind of event runs; real input of the same
+//kind is lost meanwhile
+static int rec_x11_ours(int type, int detail) {
+  uint32_t f = st_flags(state_load());
+  uint32_t any = ST_REPLAY | ST_MACROS;
+  switch (type) {
+    case KeyPress:
+    case KeyRelease:
+      if (f & any) return 1;
+      if ((f & ST_HOLD_W) && detail == keytab_hw(KEY_SLOT_W)) return 1;
+      return (f & ST_HOLD_S) && detail == keytab_hw(KEY_SLOT_S);
+    case ButtonPress:
+    case ButtonRelease:
+      if (f & (any | ST_SPAM)) return 1;
+      if ((f & ST_HOLD_LMB) && detail == 1) return 1;
+      return (f & ST_HOLD_RMB) && detail == 3;
+    default:
+      return (f & (any | ST_SPAM)) != 0;   //Spam LMB moves to the saved position
+  }
+}
+
+static void rec_x11_intercept(XPointer priv, XRecordInterceptData *d) {
+  (void)priv;
+  if (d->category == XRecordFromServer && d->data) {
+    const xEvent *ev = (const xEvent *)d->data;
+    int type = ev->u.u.type & 0x7F;
+    int detail = ev->u.u.detail;
+    switch (type) {
+      case KeyPress:
+      case KeyRelease:
+        if (!(g_rec_skip_kc[detail >> 3] & (1u << (detail & 7))) && !rec_x11_ours(type, detail))
+          rec_push(REC_KEY, detail, type == KeyPress, 0, 0);
+        break;
+      case ButtonPress:
+      case ButtonRelease:
+        //X buttons: 1=left 3=right
+        if ((detail == 1 || detail == 3) && !rec_x11_ours(type, detail))
+          rec_push(REC_BUTTON, detail == 1 ? 0 : 1, type == ButtonPress, 0, 0);
+        break;
+      case MotionNotify:
+        if (!rec_x11_ours(type, detail))
+          rec_push(REC_MOVE, 0, 0, ev->u.keyButtonPointer.rootX, ev->u.keyButtonPointer.rootY);
+        break;
+      default:
+        break;
+    }
+  }
+  XRecordFreeData(d);
+}
+
+static void *rec_thread_main(void *unused) {
+  (void)unused;
+  XRecordEnableContext(g_rec_dpy, g_rec_ctx, rec_x11_intercept, NULL);
+  return NULL;
+}
+
+static int rec_capture_start(void) {
+  int major = 0, minor = 0;
+  if (!XRecordQueryVersion(dpy, &major, &minor)) {
+    fprintf(stderr, "Warning: X server has no RECORD extension, cannot record\n");
+    return 0;
+  }
+
+  memset(g_rec_skip_kc, 0, sizeof(g_rec_skip_kc));
+  for (int i = 0; i <= ACTION_MAX; ++i) {
+    int ks = (i < ACTION_MAX) ? g_cfg->keys[i] : KS_HIDE_OVERLAY;
+    KeyCode kc = ks ? XKeysymToKeycode(dpy, (KeySym)ks) : 0;
+    if (kc) g_rec_skip_kc[kc >> 3] |= (uint8_t)(1u << (kc & 7));
+  }
+
+  g_rec_dpy = XOpenDisplay(NULL);
+  if (!g_rec_dpy) {
+    fprintf(stderr, "Warning: cannot open a second X connection for recording\n");
+    return 0;
+  }
+  XRecordRange *range = XRecordAllocRange();
+  if (range) {
+    range->device_events.first = KeyPress;
+    range->device_events.last = MotionNotify;
+    XRecordClientSpec spec = XRecordAllClients;
+    g_rec_ctx = XRecordCreateContext(dpy, 0, &spec, 1, &range, 1);
+    XFree(range);
+  }
+  //the context must exist on the server before the data connection enables it
+  XSync(dpy, False);
+  if (!g_rec_ctx || pthread_create(&g_rec_thread, NULL, rec_thread_main, NULL) != 0) {
+    fprintf(stderr, "Warning: cannot start the X11 input recorder\n");
+    if (g_rec_ctx) XRecordFreeContext(dpy, g_rec_ctx);
+    g_rec_ctx = 0;
+    XCloseDisplay(g_rec_dpy);
+    g_rec_dpy = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+static void rec_capture_stop(void) {
+  if (!g_rec_ctx) return;
+  //ends XRecordEnableContext() on the data connection
+  XRecordDisableContext(dpy, g_rec_ctx);
+  XSync(dpy, False);
+  pthread_join(g_rec_thread, NULL);
+  XRecordFreeContext(dpy, g_rec_ctx);
+  g_rec_ctx = 0;
+  XCloseDisplay(g_rec_dpy);
+  g_rec_dpy = NULL;
+}
+
+static const void *rec_map_file(const char *path, size_t *len) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return NULL;
+  struct stat sb;
+  void *base = NULL;
+  if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+    base = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) base = NULL;
+    *len = (size_t)sb.st_size;
+  }
+  close(fd);
+  return base;
+}
+
+static void rec_unmap(const void *base, size_t len) {
+  munmap((void *)base, len);
+}
+#endif
+
+//--------------- hotkey handling -----------------
+//queue a command for the worker; the ring is far larger than the burst of
+//commands a single hotkey produces, so a full ring means the worker is stuck
+static void send_worker_cmd(const worker_cmd *c) {
+  if (!cmd_push(c)) {
+    fprintf(stderr, "Warning: worker command queue full, command dropped\n");
+  }
+}
+
+//---- HUD ticks ----
+//while something in the HUD changes with time (the recording clock, the
+//achieved rate of a repeating action) the main loop's timer wakes it for
+//the next change; otherwise the timer stays off
+
+#define RATE_SAMPLE_NS 500000000ull
+static uint64_t g_rate_next = WAIT_FOREVER;   //next rate sample, main thread
+
+static void hud_timer_arm(void) {
+  uint64_t d = g_rate_next;
+  if (st_flags(state_load()) & ST_RECORDING) {
+    //the recording clock ticks on whole seconds
+    uint64_t secs = (now_ns() - g_rec_start) / 1000000000ull + 1;
+    uint64_t rec = g_rec_start + secs * 1000000000ull;
+    if (d == WAIT_FOREVER || rec < d) d = rec;
+  }
+  ui_timer_set(d);
+}
+
+//follow the repeating actions that started or stopped, and with sample set
+//take the achieved rate of the running ones since the last sample
+static void rate_views_refresh(int sample) {
+  uint64_t now = now_ns();
+  uint32_t f = st_flags(state_load());
+  int any = 0;
+  for (int a = 0; a < ACTION_MAX; ++a) {
+    const macro_def *def = &g_macro_main->defs[a];
+    rate_view *v = &g_rate_view[a];
+    int on = def->len && (def->flags & MACRO_F_RATE) && (f & def->bit);
+    uint64_t ticks = atomic_load_explicit(&g_rate[a].ticks, memory_order_relaxed);
+    if (!on) {
+      v->active = 0;
+    } else if (!v->active) {
+      v->active = 1;
+      v->t = now;
+      v->ticks = ticks;
+      v->dropped0 = atomic_load_explicit(&g_rate[a].dropped, memory_order_relaxed);
+      v->per_sec = -1.0;
+    } else if (sample && now > v->t) {
+      v->per_sec = (double)(ticks - v->ticks) * 1e9 / (double)(now - v->t);
+      v->t = now;
+      v->ticks = ticks;
+    }
+    any |= on;
+  }
+  if (!any) g_rate_next = WAIT_FOREVER;
+  else if (sample || g_rate_next == WAIT_FOREVER) g_rate_next = now + RATE_SAMPLE_NS;
+  hud_rate_update();
+  if (any && sample) state_changed();
+  hud_timer_arm();
+}
+
+static void toggle_with_log(const char* name, uint32_t flag) {
+  uint64_t st = state_update(0, flag);
+  worker_wake();
+  int v = (st_flags(st) & flag) != 0;
+  printf("%s: %s\n", name, v ? "ON" : "OFF");
+  fflush(stdout);
+
+  rate_views_refresh(0);
+  overlay_draw();
+}
+
+//the point a macro's plain "click" steps use
+static void save_cursor_pos(int action) {
+  int x = 0, y = 0;
+#ifdef _WIN32
+  win_get_cursor(&x, &y);
+#else
+  x11_get_cursor(&x, &y);
+#endif
+  worker_cmd c = { CMD_SET_CLICK_POS, action, x, y, 0, NULL, 0 };
+  send_worker_cmd(&c);
+  printf("Saved cursor position: (%d, %d)\n", x, y);
+  fflush(stdout);
+}
+
+//start recording, or stop and write the file
+static void record_toggle(void) {
+  uint32_t f = st_flags(state_load());
+  if (f & ST_RECORDING) {
+    rec_capture_stop();
+    double secs = (double)(now_ns() - g_rec_start) / 1e9;
+    state_update(ST_RECORDING, 0);
+    hud_timer_arm();
+    long n = rec_write_file(REC_FILE);
+    if (n < 0) {
+      fprintf(stderr, "Warning: cannot write recording '%s'\n", REC_FILE);
+    } else {
+      printf("Recording: OFF, %ld events in %.2f s saved to %s\n", n, secs, REC_FILE);
+    }
+    unsigned int dropped = atomic_load(&g_rec_dropped);
+    if (dropped) fprintf(stderr, "Warning: recording buffer full, %u events dropped\n", dropped);
+    fflush(stdout);
+    overlay_draw();
+    return;
+  }
+
+  if (f & ST_REPLAY) {
+    fprintf(stderr, "Warning: stop the replay before recording\n");
+    return;
+  }
+  rec_ring_reset();
+  g_rec_start = now_ns();
+  if (!rec_capture_start()) return;
+  state_update(0, ST_RECORDING);
+  hud_timer_arm();   //HUD clock
+  printf("Recording: ON\n");
+  fflush(stdout);
+  overlay_draw();
+}
+
+//map the recording, hand it to the worker and start it; or stop it
+static void replay_toggle(void) {
+  uint32_t f = st_flags(state_load());
+  if (!(f & ST_REPLAY)) {
+    if (f & ST_RECORDING) {
+      fprintf(stderr, "Warning: stop the recording before replaying\n");
+      return;
+    }
+    size_t len = 0;
+    const void *map = rec_map_file(REC_FILE, &len);
+    size_t count = 0;
+    if (!map || !rec_check_map(map, len, &count) || count == 0) {
+      fprintf(stderr, "Warning: no usable recording in '%s'\n", REC_FILE);
+      if (map) rec_unmap(map, len);
+      return;
+    }
+    worker_cmd c = { CMD_REPLAY_LOAD, 0, 0, 0, 0, map, len };
+    if (!cmd_push(&c)) {
+      fprintf(stderr, "Warning: worker command queue full, command dropped\n");
+      rec_unmap(map, len);
+      return;
+    }
+    printf("Replaying %zu events from %s\n", count, REC_FILE);
+  }
+  toggle_with_log("Replay", ST_REPLAY);
+}
+
+//switch a macro on or off; a macro clicking at its saved point takes the
+//cursor position when save_pos is set (hotkeys), or keeps the point it was given
+static void macro_toggle(int action, int save_pos) {
+  const macro_def *def = &g_macro_main->defs[action];
+  if (def->len == 0) return;
+  if (save_pos && (def->flags & MACRO_F_SAVED_POS) && !(st_flags(state_load()) & ST_PAUSED))
+    save_cursor_pos(action);
+  toggle_with_log(g_action_names[action], def->bit);
+}
+
+static void handle_action(int action) {
+  uint64_t t0 = trace_now();
+  switch (action) {
+    case ACTION_RECORD:
+      record_toggle();
+      break;
+    case ACTION_REPLAY:
+      replay_toggle();
+      break;
+    case ACTION_STATS:
+      stats_dump(stdout);
+      break;
+    case ACTION_SUSPEND: {
+      uint64_t st = state_update(0, ST_SUSPENDED);
+      worker_wake();
+      printf("Suspended: %s\n", (st_flags(st) & ST_SUSPENDED) ? "YES" : "NO");
+      fflush(stdout);
+      overlay_draw();
+    } break;
+    case ACTION_EXIT:
+      atomic_store(&g_running, 0);
+      worker_wake();
+      break;
+    default:
+      //everything else toggles a macro
+      if (action >= 0 && action < ACTION_MAX) macro_toggle(action, 1);
+      break;
+  }
+  trace_span("handle_action", t0, "action", action);
+}
+
+//compile the current config and hand the new set to the worker; the HUD
+//text follows the config either way
+static int macro_publish(void) {
+  macro_set *set = macro_build_all();
+  hud_model_build();
+  if (!set) return 0;
+  worker_cmd c = { CMD_MACRO_SET, 0, 0, 0, 0, set, sizeof(*set) };
+  send_worker_cmd(&c);
+  return 1;
+}
+
+//hand the configured intervals and late policies to the worker
+static void send_config_to_worker(void) {
+  for (int i = 0; i < ACTION_COUNT; ++i) {
+    if (g_cfg->interval_us[i] == 0) continue;
+    uint64_t ns = g_cfg->cps[i] ? (1000000000ull + g_cfg->cps[i] / 2) / g_cfg->cps[i]
+                                : (uint64_t)g_cfg->interval_us[i] * 1000ull;
+    worker_cmd c = { CMD_SET_INTERVAL, i, 0, 0, ns, NULL, 0 };
+    send_worker_cmd(&c);
+    worker_cmd l = { CMD_SET_LATE, i, g_cfg->late[i], 0, 0, NULL, 0 };
+    send_worker_cmd(&l);
+  }
+}
+
+//--------------- control channel ---------------
+//local IPC for scripts and helper tools: a Unix seqpacket socket or a
+//message-mode named pipe, so a request and its reply are one message each.
+//the main loop serves it next to the hotkeys, and requests take the same
+//path (handle_action, the worker command ring), so control is as fast as a
+//key press. messages are fixed-size structs in host byte order; the peer is
+//always on the same machine.
+
+#define CTL_MAGIC     0xF7
+#define CTL_NAME_MAX  64      //CTL_OP_FIND: name bytes after the request
+#define CTL_REPLY_MAX 16384   //largest reply payload (stats text)
+#ifdef _WIN32
+#define CTL_PIPE_NAME "\\\\.\\pipe\\foxholetool"
+#else
+#define CTL_SOCKET_NAME "foxholetool.sock"
+#define CTL_CLIENTS_MAX 8
+#endif
+
+enum {
+  CTL_OP_STATE = 0,      //only the reply: current ST_* flags
+  CTL_OP_FIND,           //name follows the request; value = its action
+  CTL_OP_TOGGLE,         //like the action's hotkey
+  CTL_OP_START,          //switch on unless on (actions with an on state)
+  CTL_OP_STOP,           //switch off unless off
+  CTL_OP_SET_POS,        //a, b = click point of the action
+  CTL_OP_SET_INTERVAL,   //a = repeat interval in microseconds
+  CTL_OP_STATS           //payload: the stats summary text
+};
+
+enum {
+  CTL_OK = 0,
+  CTL_E_REQUEST,   //malformed request or unknown op
+  CTL_E_ACTION,    //no such action, or the op does not apply to it
+  CTL_E_VALUE      //argument out of range
+};
+
+#define CTL_F_POS 0x01u   //TOGGLE/START: click at a, b instead of the cursor
+
+typedef struct {
+  uint8_t magic;
+  uint8_t op;        //CTL_OP_*
+  uint8_t flags;     //CTL_F_*
+  uint8_t action;
+  int32_t a, b;
+  uint32_t seq;      //echoed in the reply
+} ctl_request;
+
+typedef struct {
+  uint8_t magic;
+  uint8_t status;    //CTL_OK / CTL_E_*
+  uint16_t reserved;
+  uint32_t seq;
+  uint32_t flags;    //ST_* flags after the request
+  int32_t value;     //CTL_OP_FIND: the action
+  uint32_t len;      //payload bytes following the reply
+} ctl_reply;
+
+_Static_assert(sizeof(ctl_request) == 16, "ctl_request is a fixed 16-byte message");
+_Static_assert(sizeof(ctl_reply) == 20, "ctl_reply is a fixed 20-byte header");
+
+//ST_* flag that is set while an action is on, 0 for one-shot actions
+static uint32_t action_flag(int action) {
+  switch (action) {
+    case ACTION_SUSPEND: return ST_SUSPENDED;
+    case ACTION_RECORD:  return ST_RECORDING;
+    case ACTION_REPLAY:  return ST_REPLAY;
+    case ACTION_EXIT:
+    case ACTION_STATS:   return 0;
+    default:             return g_macro_main->defs[action].bit;
+  }
+}
+
+//handle one request message; the reply payload goes to out, its length is returned
+static size_t ctl_handle(const void *msg, size_t len, ctl_reply *rep, char *out, size_t out_size) {
+  const ctl_request *rq = (const ctl_request *)msg;
+  uint64_t t_recv = now_ns();
+  size_t n = 0;
+
+  memset(rep, 0, sizeof(*rep));
+  rep->magic = CTL_MAGIC;
+  if (len < sizeof(*rq) || rq->magic != CTL_MAGIC) {
+    rep->status = CTL_E_REQUEST;
+    return 0;
+  }
+  rep->seq = rq->seq;
+
+  int action = rq->action;
+  int known = action < ACTION_MAX && g_action_names[action] != NULL;
+  int is_macro = known && g_macro_main->defs[action].len > 0;
+
+  switch (rq->op) {
+    case CTL_OP_STATE:
+      break;
+    case CTL_OP_FIND: {
+      size_t name_len = len - sizeof(*rq);
+      const char *name = (const char *)(rq + 1);
+      rep->value = -1;
+      for (int i = 0; i < ACTION_MAX; ++i) {
+        const char *an = g_action_names[i];
+        if (an && strlen(an) == name_len && memcmp(an, name, name_len) == 0) rep->value = i;
+      }
+      if (rep->value < 0) rep->status = CTL_E_ACTION;
+    } break;
+    case CTL_OP_TOGGLE:
+    case CTL_OP_START:
+    case CTL_OP_STOP: {
+      if (!known) {
+        rep->status = CTL_E_ACTION;
+        break;
+      }
+      uint32_t flag = action_flag(action);
+      int on = (st_flags(state_load()) & flag) != 0;
+      if (rq->op != CTL_OP_TOGGLE && !flag) {
+        rep->status = CTL_E_ACTION;
+        break;
+      }
+      if ((rq->op == CTL_OP_START && on) || (rq->op == CTL_OP_STOP && !on)) break;
+      stats_hotkey(t_recv);
+      if (is_macro && (rq->flags & CTL_F_POS) && !on) {
+        worker_cmd c = { CMD_SET_CLICK_POS, action, rq->a, rq->b, 0, NULL, 0 };
+        send_worker_cmd(&c);
+        macro_toggle(action, 0);
+      } else if (is_macro) {
+        //turning off never needs a position
+        macro_toggle(action, !on);
+      } else {
+        handle_action(action);
+      }
+    } break;
+    case CTL_OP_SET_POS: {
+      if (!is_macro) {
+        rep->status = CTL_E_ACTION;
+        break;
+      }
+      worker_cmd c = { CMD_SET_CLICK_POS, action, rq->a, rq->b, 0, NULL, 0 };
+      send_worker_cmd(&c);
+    } break;
+    case CTL_OP_SET_INTERVAL: {
+      if (!is_macro) {
+        rep->status = CTL_E_ACTION;
+        break;
+      }
+      if (rq->a < (int32_t)SPAM_MIN_INTERVAL_US) {
+        rep->status = CTL_E_VALUE;
+        break;
+      }
+      worker_cmd c = { CMD_SET_INTERVAL, action, 0, 0, (uint64_t)rq->a * 1000ull, NULL, 0 };
+      send_worker_cmd(&c);
+      worker_wake();
+    } break;
+    case CTL_OP_STATS:
+      n = stats_format(out, out_size);
+      break;
+    default:
+      rep->status = CTL_E_REQUEST;
+      break;
+  }
+  rep->flags = st_flags(state_load());
+  rep->len = (uint32_t)n;
+  return n;
+}
+
+static const char *ctl_status_name(int status) {
+  switch (status) {
+    case CTL_OK:        return "ok";
+    case CTL_E_REQUEST: return "bad request";
+    case CTL_E_ACTION:  return "no such action for this command";
+    case CTL_E_VALUE:   return "value out of range";
+    default:            return "unknown error";
+  }
+}
+
+//request message plus, for CTL_OP_FIND, the name
+typedef struct {
+  ctl_request rq;
+  char name[CTL_NAME_MAX];
+} ctl_message;
+
+//reply header plus payload, built in place
+static struct {
+  ctl_reply rep;
+  char payload[CTL_REPLY_MAX];
+} g_ctl_out;
+
+//serve one received message; returns the number of reply bytes in g_ctl_out
+static size_t ctl_serve(const ctl_message *m, size_t len) {
+  size_t n = ctl_handle(m, len, &g_ctl_out.rep, g_ctl_out.payload, sizeof(g_ctl_out.payload));
+  return sizeof(g_ctl_out.rep) + n;
+}
+
+#ifdef _WIN32
+//one pipe instance driven by overlapped I/O; its event is part of the main
+//loop's wait, so a client is served without a thread of its own
+
+static HANDLE g_ctl_pipe = INVALID_HANDLE_VALUE;
+static OVERLAPPED g_ctl_ov;       //manual-reset event, connect and read
+static int g_ctl_connected = 0;
+static ctl_message g_ctl_in;
+
+static void ctl_pipe_drop(void) {
+  DisconnectNamedPipe(g_ctl_pipe);
+  g_ctl_connected = 0;
+}
+
+static void ctl_pipe_reply(DWORD n) {
+  DWORD len = (DWORD)ctl_serve(&g_ctl_in, n);
+  OVERLAPPED wo;
+  ZeroMemory(&wo, sizeof(wo));
+  wo.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+  DWORD done = 0;
+  //the out buffer holds a whole reply, so this completes at once
+  if (!wo.hEvent ||
+      (!WriteFile(g_ctl_pipe, &g_ctl_out, len, NULL, &wo) && GetLastError() != ERROR_IO_PENDING) ||
+      !GetOverlappedResult(g_ctl_pipe, &wo, &done, TRUE))
+    ctl_pipe_drop();
+  if (wo.hEvent) CloseHandle(wo.hEvent);
+}
+
+//start the next connect or read; loops while operations complete at once
+static void ctl_pipe_arm(void) {
+  for (;;) {
+    ResetEvent(g_ctl_ov.hEvent);
+    if (!g_ctl_connected) {
+      if (ConnectNamedPipe(g_ctl_pipe, &g_ctl_ov)) {
+        g_ctl_connected = 1;
+        continue;
+      }
+      DWORD err = GetLastError();
+      if (err == ERROR_IO_PENDING) return;
+      if (err == ERROR_PIPE_CONNECTED) {
+        g_ctl_connected = 1;
+        continue;
+      }
+      //e.g. ERROR_NO_DATA: the client is gone already
+      DisconnectNamedPipe(g_ctl_pipe);
+      continue;
+    }
+    DWORD n = 0;
+    if (ReadFile(g_ctl_pipe, &g_ctl_in, sizeof(g_ctl_in), &n, &g_ctl_ov)) {
+      ctl_pipe_reply(n);
+      continue;
+    }
+    if (GetLastError() == ERROR_IO_PENDING) return;
+    //broken pipe, or a message larger than any request
+    ctl_pipe_drop();
+  }
+}
+
+static int ctl_listen_start(void) {
+  g_ctl_pipe = CreateNamedPipeA(CTL_PIPE_NAME,
+                                PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED |
+                                FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT |
+                                PIPE_REJECT_REMOTE_CLIENTS,
+                                1, sizeof(g_ctl_out), sizeof(g_ctl_in), 0, NULL);
+  if (g_ctl_pipe == INVALID_HANDLE_VALUE) {
+    fprintf(stderr, "Warning: cannot create %s (error %lu; another instance running?)\n",
+            CTL_PIPE_NAME, GetLastError());
+    return 0;
+  }
+  ZeroMemory(&g_ctl_ov, sizeof(g_ctl_ov));
+  g_ctl_ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+  if (!g_ctl_ov.hEvent) {
+    CloseHandle(g_ctl_pipe);
+    g_ctl_pipe = INVALID_HANDLE_VALUE;
+    return 0;
+  }
+  ctl_pipe_arm();
+  printf("Control: listening on %s\n", CTL_PIPE_NAME);
+  fflush(stdout);
+  return 1;
+}
+
+static HANDLE ctl_wait_handle(void) {
+  return g_ctl_ov.hEvent;
+}
+
+//the connect or read in flight completed
+static void ctl_pipe_event(void) {
+  DWORD n = 0;
+  BOOL ok = GetOverlappedResult(g_ctl_pipe, &g_ctl_ov, &n, FALSE);
+  if (!g_ctl_connected) {
+    if (ok || GetLastError() == ERROR_PIPE_CONNECTED) g_ctl_connected = 1;
+    else DisconnectNamedPipe(g_ctl_pipe);
+  } else if (ok) {
+    ctl_pipe_reply(n);
+  } else {
+    ctl_pipe_drop();
+  }
+  ctl_pipe_arm();
+}
+
+static void ctl_listen_stop(void) {
+  if (g_ctl_pipe == INVALID_HANDLE_VALUE) return;
+  CancelIo(g_ctl_pipe);
+  CloseHandle(g_ctl_pipe);
+  CloseHandle(g_ctl_ov.hEvent);
+  g_ctl_pipe = INVALID_HANDLE_VALUE;
+  g_ctl_ov.hEvent = NULL;
+}
+
+#else
+static int g_ctl_listen = -1;
+static int g_ctl_clients[CTL_CLIENTS_MAX] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+static char g_ctl_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+//$XDG_RUNTIME_DIR is private to the user; /tmp needs the uid in the name
+static int ctl_socket_addr(struct sockaddr_un *addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  const char *dir = getenv("XDG_RUNTIME_DIR");
+  int n = (dir && *dir)
+              ? snprintf(addr->sun_path, sizeof(addr->sun_path), "%s/%s", dir, CTL_SOCKET_NAME)
+              : snprintf(addr->sun_path, sizeof(addr->sun_path), "/tmp/foxholetool-%u.sock",
+                         (unsigned)getuid());
+  return n > 0 && (size_t)n < sizeof(addr->sun_path);
+}
+
+static int ctl_listen_start(void) {
+  struct sockaddr_un addr;
+  if (!ctl_socket_addr(&addr)) {
+    fprintf(stderr, "Warning: control socket path too long\n");
+    return 0;
+  }
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    fprintf(stderr, "Warning: cannot create control socket (%s)\n", strerror(errno));
+    return 0;
+  }
+
+  //only this user may connect
+  mode_t old_mask = umask(077);
+  int rc = bind(fd, (const struct sockaddr *)&addr, sizeof(addr));
+  if (rc != 0 && errno == EADDRINUSE) {
+    //a socket file left behind by a crashed instance is replaced, a live one is not
+    int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    int alive = probe >= 0 && connect(probe, (const struct sockaddr *)&addr, sizeof(addr)) == 0;
+    if (probe >= 0) close(probe);
+    if (!alive) {
+      unlink(addr.sun_path);
+      rc = bind(fd, (const struct sockaddr *)&addr, sizeof(addr));
+    } else {
+      errno = EADDRINUSE;
+    }
+  }
+  umask(old_mask);
+  if (rc != 0 || listen(fd, CTL_CLIENTS_MAX) != 0) {
+    fprintf(stderr, "Warning: cannot listen on %s (%s)\n", addr.sun_path, strerror(errno));
+    close(fd);
+    return 0;
+  }
+  memcpy(g_ctl_path, addr.sun_path, sizeof(g_ctl_path));
+  g_ctl_listen = fd;
+  printf("Control: listening on %s\n", g_ctl_path);
+  fflush(stdout);
+  return 1;
+}
+
+static void ctl_listen_stop(void) {
+  if (g_ctl_listen < 0) return;
+  for (int i = 0; i < CTL_CLIENTS_MAX; ++i) {
+    if (g_ctl_clients[i] >= 0) close(g_ctl_clients[i]);
+    g_ctl_clients[i] = -1;
+  }
+  close(g_ctl_listen);
+  unlink(g_ctl_path);
+  g_ctl_listen = -1;
+}
+
+//listening socket and clients, after the main loop's own entries; unused
+//slots are -1, which poll() skips
+#define CTL_POLL_FDS (1 + CTL_CLIENTS_MAX)
+
+static void ctl_poll_fill(struct pollfd *p) {
+  p[0].fd = g_ctl_listen;
+  p[0].events = POLLIN;
+  for (int i = 0; i < CTL_CLIENTS_MAX; ++i) {
+    p[1 + i].fd = g_ctl_clients[i];
+    p[1 + i].events = POLLIN;
+  }
+}
+
+static void ctl_client_close(int i) {
+  close(g_ctl_clients[i]);
+  g_ctl_clients[i] = -1;
+}
+
+static void ctl_poll_handle(const struct pollfd *p) {
+  for (int i = 0; i < CTL_CLIENTS_MAX; ++i) {
+    if (p[1 + i].fd < 0 || !p[1 + i].revents) continue;
+    ctl_message m;
+    ssize_t n = recv(g_ctl_clients[i], &m, sizeof(m), 0);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+    if (n <= 0) {
+      ctl_client_close(i);
+      continue;
+    }
+    size_t len = ctl_serve(&m, (size_t)n);
+    if (send(g_ctl_clients[i], &g_ctl_out, len, MSG_NOSIGNAL) < 0) ctl_client_close(i);
+  }
+
+  if (p[0].fd >= 0 && (p[0].revents & POLLIN)) {
+    int fd = accept4(g_ctl_listen, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+    for (int i = 0; i < CTL_CLIENTS_MAX; ++i) {
+      if (g_ctl_clients[i] < 0) {
+        g_ctl_clients[i] = fd;
+        return;
+      }
+    }
+    close(fd);   //all slots busy
+  }
+}
+#endif
+
+//---- client side: foxholetool --ctl <command> ----
+
+#ifdef _WIN32
+typedef HANDLE ctl_conn;
+#else
+typedef int ctl_conn;
+#endif
+
+//one request / reply round trip; returns 0 on transport failure
+static int ctl_call(ctl_conn c, const ctl_message *m, size_t len, void *reply, size_t reply_size,
+                    size_t *got) {
+#ifdef _WIN32
+  DWORD n = 0;
+  if (!TransactNamedPipe(c, (LPVOID)m, (DWORD)len, reply, (DWORD)reply_size, &n, NULL)) return 0;
+  *got = n;
+#else
+  if (send(c, m, len, MSG_NOSIGNAL) != (ssize_t)len) return 0;
+  ssize_t n = recv(c, reply, reply_size, 0);
+  if (n < 0) return 0;
+  *got = (size_t)n;
+#endif
+  return *got >= sizeof(ctl_reply);
+}
+
+static int ctl_usage(void) {
+  fprintf(stderr,
+          "usage: foxholetool --ctl <command>\n"
+          "  state                   print the active state flags\n"
+          "  stats                   print the latency statistics\n"
+          "  toggle <action> [x y]   like the action's hotkey, optionally clicking at x y\n"
+          "  start <action> [x y]    switch an action on\n"
+          "  stop <action>           switch an action off\n"
+          "  pos <action> <x> <y>    set the click point of a macro\n"
+          "  interval <action> <us>  set the repeat interval of a macro\n"
+          "<action> is a name from the config (\"Spam LMB\", a macro name) or its number\n");
+  return 2;
+}
+
+static int ctl_connect(ctl_conn *out) {
+#ifdef _WIN32
+  HANDLE c = CreateFileA(CTL_PIPE_NAME, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                         OPEN_EXISTING, 0, NULL);
+  //the single instance is serving someone else
+  if (c == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY &&
+      WaitNamedPipeA(CTL_PIPE_NAME, 1000))
+    c = CreateFileA(CTL_PIPE_NAME, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+  DWORD mode = PIPE_READMODE_MESSAGE;
+  if (c != INVALID_HANDLE_VALUE && SetNamedPipeHandleState(c, &mode, NULL, NULL)) {
+    *out = c;
+    return 1;
+  }
+  if (c != INVALID_HANDLE_VALUE) CloseHandle(c);
+  fprintf(stderr, "Error: cannot connect to %s\n", CTL_PIPE_NAME);
+#else
+  struct sockaddr_un addr;
+  if (!ctl_socket_addr(&addr)) return 0;
+  int c = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (c >= 0 && connect(c, (const struct sockaddr *)&addr, sizeof(addr)) == 0) {
+    *out = c;
+    return 1;
+  }
+  if (c >= 0) close(c);
+  fprintf(stderr, "Error: cannot connect to %s (%s)\n", addr.sun_path, strerror(errno));
+#endif
+  fprintf(stderr, "Is foxholetool running with --headless or --listen?\n");
+  return 0;
+}
+
+static void ctl_disconnect(ctl_conn c) {
+#ifdef _WIN32
+  CloseHandle(c);
+#else
+  close(c);
+#endif
+}
+
+static struct {
+  ctl_reply rep;
+  char payload[CTL_REPLY_MAX];
+} g_ctl_in_reply;   //client side
+
+//resolve argv's action (a number, or a name the running instance looks up)
+static int ctl_client_action(ctl_conn c, const char *arg) {
+  char *end = NULL;
+  long v = strtol(arg, &end, 10);
+  if (end != arg && *end == '\0') return (v >= 0 && v < ACTION_MAX) ? (int)v : ACTION_MAX;
+
+  ctl_message m;
+  memset(&m, 0, sizeof(m));
+  size_t len = strlen(arg);
+  if (len > CTL_NAME_MAX) len = CTL_NAME_MAX;
+  m.rq.magic = CTL_MAGIC;
+  m.rq.op = CTL_OP_FIND;
+  memcpy(m.name, arg, len);
+  size_t got = 0;
+  if (!ctl_call(c, &m, sizeof(m.rq) + len, &g_ctl_in_reply, sizeof(g_ctl_in_reply), &got)) {
+    fprintf(stderr, "Error: control request failed\n");
+    return -1;
+  }
+  if (g_ctl_in_reply.rep.status != CTL_OK) {
+    fprintf(stderr, "Error: no action named '%s'\n", arg);
+    return -1;
+  }
+  return g_ctl_in_reply.rep.value;
+}
+
+static int ctl_client_run(ctl_conn c, int op, int argc, char **argv) {
+  ctl_message m;
+  memset(&m, 0, sizeof(m));
+  m.rq.magic = CTL_MAGIC;
+  m.rq.op = (uint8_t)op;
+  m.rq.seq = 1;
+  if (argc >= 1) {
+    int action = ctl_client_action(c, argv[0]);
+    if (action < 0) return 1;
+    m.rq.action = (uint8_t)action;
+  }
+  if (argc == 3) {
+    m.rq.flags = CTL_F_POS;
+    m.rq.a = (int32_t)strtol(argv[1], NULL, 10);
+    m.rq.b = (int32_t)strtol(argv[2], NULL, 10);
+  } else if (argc == 2) {
+    m.rq.a = (int32_t)strtol(argv[1], NULL, 10);
+  }
+
+  size_t got = 0;
+  uint64_t t0 = now_ns();
+  if (!ctl_call(c, &m, sizeof(m.rq), &g_ctl_in_reply, sizeof(g_ctl_in_reply), &got)) {
+    fprintf(stderr, "Error: control request failed\n");
+    return 1;
+  }
+  uint64_t dt = now_ns() - t0;
+  const ctl_reply *rep = &g_ctl_in_reply.rep;
+  if (rep->status != CTL_OK) {
+    fprintf(stderr, "Error: %s\n", ctl_status_name(rep->status));
+    return 1;
+  }
+  if (rep->len > 0 && got >= sizeof(*rep) + rep->len)
+    fwrite(g_ctl_in_reply.payload, 1, rep->len, stdout);
+  printf("ok, state 0x%x, %.1f us round trip\n", (unsigned)rep->flags, (double)dt / 1e3);
+  return 0;
+}
+
+static int ctl_client_main(int argc, char **argv) {
+  static const struct { const char *name; int op; int args; } cmds[] = {
+    { "state", CTL_OP_STATE, 0 },        { "stats", CTL_OP_STATS, 0 },
+    { "toggle", CTL_OP_TOGGLE, 1 },      { "start", CTL_OP_START, 1 },
+    { "stop", CTL_OP_STOP, 1 },          { "pos", CTL_OP_SET_POS, 3 },
+    { "interval", CTL_OP_SET_INTERVAL, 2 },
+  };
+  if (argc < 1) return ctl_usage();
+  int k = -1;
+  for (int i = 0; i < (int)(sizeof(cmds) / sizeof(cmds[0])); ++i) {
+    if (strcmp(argv[0], cmds[i].name) == 0) k = i;
+  }
+  if (k < 0) return ctl_usage();
+  int nargs = argc - 1;
+  //toggle/start take an optional point
+  int with_pos = (cmds[k].op == CTL_OP_TOGGLE || cmds[k].op == CTL_OP_START) && nargs == 3;
+  if (nargs != cmds[k].args && !with_pos) return ctl_usage();
+
+  ctl_conn c;
+  if (!ctl_connect(&c)) return 1;
+  int rc = ctl_client_run(c, cmds[k].op, nargs, argv + 1);
+  ctl_disconnect(c);
+  return rc;
+}
+
+//--------------- hotkey dispatch table ---------------
+//built from the loaded bindings each time the hotkeys are registered: one
+//byte per (modifier mask, key) holding the slot + 1, so a key event is a
+//single lookup. the key is the VK (Windows) or the hardware KeyCode (X11);
+//exactly the bindings in the table get registered / grabbed.
+
+#define HOTKEY_KEYS  256
+#define HOTKEY_HIDE  ACTION_MAX          //slot of the fixed overlay toggle
+#define HOTKEY_SLOTS (ACTION_MAX + 1)
+
+static uint8_t g_hotkey_table[(HK_MOD_ALL + 1) * HOTKEY_KEYS];
+
+//binding of a slot; 0 if it has none
+static int hotkey_binding(int slot, int *mods) {
+  *mods = 0;
+  if (slot == HOTKEY_HIDE) {
+#ifdef _WIN32
+    return VK_HIDE_OVERLAY;
+#else
+    return KS_HIDE_OVERLAY;
+#endif
+  }
+  if (slot >= ACTION_MACRO_FIRST && g_macro_main->defs[slot].len == 0) return 0;
+  *mods = g_cfg->mods[slot];
+  return g_cfg->keys[slot];
+}
+
+static const char *hotkey_slot_name(int slot) {
+  return slot == HOTKEY_HIDE ? "Hide overlay" : g_action_names[slot];
+}
+
+static void hotkey_table_build(void) {
+  memset(g_hotkey_table, 0, sizeof(g_hotkey_table));
+  char name[48];
+  for (int slot = 0; slot < HOTKEY_SLOTS; ++slot) {
+    int mods;
+    int code = hotkey_binding(slot, &mods);
+    if (!code) continue;
+#ifdef _WIN32
+    int key = code;
+#else
+    int ks_slot = keytab_intern(code);
+    int key = (ks_slot >= 0) ? keytab_hw(ks_slot) : 0;
+#endif
+    hotkey_name(code, mods, name, sizeof(name));
+    if (key <= 0 || key >= HOTKEY_KEYS) {
+      fprintf(stderr, "Warning: %s for '%s' is not on this keyboard\n",
+              name, hotkey_slot_name(slot));
+      continue;
+    }
+    uint8_t *e = &g_hotkey_table[mods * HOTKEY_KEYS + key];
+    if (*e) {
+      fprintf(stderr, "Warning: %s is bound to '%s' and '%s', keeping '%s'\n", name,
+              hotkey_slot_name(*e - 1), hotkey_slot_name(slot), hotkey_slot_name(*e - 1));
+      continue;
+    }
+    *e = (uint8_t)(slot + 1);
+  }
+}
+
+//slot for a key event, or -1
+static int hotkey_lookup(unsigned int key, int mods) {
+  if (key >= HOTKEY_KEYS) return -1;
+  return (int)g_hotkey_table[(mods & HK_MOD_ALL) * HOTKEY_KEYS + key] - 1;
+}
+
+#ifdef _WIN32
+
+//internal IDs for Windows global hotkeys: HK_ID_BASE + dispatch slot
+enum {
+  HK_ID_BASE = 1
+};
+
+//simple overlay window above the "War"/Foxhole game window
+
+static LRESULT CALLBACK overlay_wnd_proc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+  switch (msg) {
+    //content comes from UpdateLayeredWindow, nothing to paint or erase here
+    case WM_ERASEBKGND:
+      return 1;
+    case WM_PAINT:
+      ValidateRect(hwnd, NULL);
+      return 0;
+    //sent to every top-level window when a monitor is added, removed or resized
+    case WM_DISPLAYCHANGE:
+      screen_changed();
+      break;
+    default:
+      break;
+  }
+  return DefWindowProc(hwnd, msg, wParam, lParam);
+}
+
+//return 1 if a top-level window belongs to the game; the process image is
+//looked up once per PID (OpenProcess + QueryFullProcessImageNameA), later
+//windows of the same process only cost a cache probe
+static int window_is_foxhole(HWND hwnd) {
+  DWORD pid = 0;
+  GetWindowThreadProcessId(hwnd, &pid);
+  if (pid) {
+    int v = pid_cache_get(pid);
+    if (v < 0) {
+      v = 0;
+      HANDLE hProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+      if (hProc) {
+        char path[MAX_PATH];
+        DWORD size = sizeof(path);
+        BOOL ok = QueryFullProcessImageNameA(hProc, 0, path, &size);
+        CloseHandle(hProc);
+        v = ok && strcasestr_simple(path, "foxhole");
+      }
+      pid_cache_put(pid, v);
+    }
+    if (v) return 1;
+  }
+
+  //fallback: if path has no "foxhole", try window title ("War" or containing "foxhole");
+  //for windows of other processes this reads the stored caption, no message is sent
+  char title[256];
+  if (GetWindowTextA(hwnd, title, sizeof(title)) > 0) {
+    if (_stricmp(title, "War") == 0 || strcasestr_simple(title, "foxhole")) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+//EnumWindows collector: stops once max game windows are found
+typedef struct {
+  HWND *out;
+  int n, max;
+  int shown;   //only visible windows without an owner (no IME or helper windows)
+} window_list;
+
+static BOOL CALLBACK find_foxhole_window_proc(HWND hwnd, LPARAM lParam) {
+  window_list *l = (window_list *)lParam;
+  if (l->shown && (!IsWindowVisible(hwnd) || GetWindow(hwnd, GW_OWNER))) return TRUE;
+  if (window_is_foxhole(hwnd)) l->out[l->n++] = hwnd;
+  return l->n < l->max;
+}
+
+//up to max game windows, in Z order; with shown set only the ones a player sees
+static int find_game_windows_win(HWND *out, int max, int shown) {
+  window_list l = { out, 0, max, shown };
+  uint64_t t0 = trace_now();
+  EnumWindows(find_foxhole_window_proc, (LPARAM)&l);
+  trace_span("find_window", t0, "found", l.n);
+  return l.n;
+}
+
+//---- game window tracking ----
+//location/destroy WinEvents scoped to the game process move the overlay only
+//when the game actually moves. while there is no game (not started yet, or
+//exited), top-level windows are checked one at a time as they are shown or
+//come to the foreground, so the game is picked up the moment it opens
+//without enumerating every window again. WINEVENT_OUTOFCONTEXT callbacks
+//arrive through this thread's GetMessage loop.
+
+static HWINEVENTHOOK g_hook_location = NULL;
+static HWINEVENTHOOK g_hook_destroy = NULL;
+static HWINEVENTHOOK g_hook_foreground = NULL;
+static HWINEVENTHOOK g_hook_create = NULL;   //EVENT_OBJECT_CREATE..EVENT_OBJECT_SHOW
+
+static void target_track_win(HWND hwnd);
+
+static void target_found_win(HWND hwnd) {
+  printf("Game window found.\n");
+  fflush(stdout);
+  target_track_win(hwnd);
+  overlay_reposition_win();
+  if (g_overlay_hwnd && !atomic_load(&g_overlay_hidden)) {
+    ShowWindow(g_overlay_hwnd, SW_SHOWNOACTIVATE);
+  }
+  focus_set(GetForegroundWindow() == hwnd);
+}
+
+static void CALLBACK target_event_proc(HWINEVENTHOOK hook, DWORD event, HWND hwnd,
+                                       LONG idObject, LONG idChild,
+                                       DWORD thread, DWORD time) {
+  (void)hook; (void)thread; (void)time;
+  if (!hwnd || idObject != OBJID_WINDOW || idChild != CHILDID_SELF) return;
+
+  switch (event) {
+    case EVENT_OBJECT_LOCATIONCHANGE:
+      if (hwnd == g_war_hwnd) overlay_reposition_win();
+      break;
+    case EVENT_OBJECT_DESTROY:
+      if (hwnd == g_war_hwnd) {
+        if (g_overlay_hwnd) ShowWindow(g_overlay_hwnd, SW_HIDE);
+        printf("Game window closed, waiting for it to come back.\n");
+        fflush(stdout);
+        //its PID may be reused by anything now
+        pid_cache_clear();
+        target_track_win(NULL);
+        focus_set(0);
+      }
+      break;
+    case EVENT_SYSTEM_FOREGROUND:
+      if (g_war_hwnd) {
+        focus_set(hwnd == g_war_hwnd);
+        break;
+      }
+      if (GetAncestor(hwnd, GA_ROOT) == hwnd && window_is_foxhole(hwnd))
+        target_found_win(hwnd);
+      break;
+    case EVENT_OBJECT_CREATE:
+      //most windows are created hidden; those are checked when shown
+      if (!IsWindowVisible(hwnd)) break;
+      //fall through
+    case EVENT_OBJECT_SHOW:
+      if (!g_war_hwnd && GetAncestor(hwnd, GA_ROOT) == hwnd && window_is_foxhole(hwnd))
+        target_found_win(hwnd);
+      break;
+    default:
+      break;
+  }
+}
+
+static void target_unhook_win(void) {
+  if (g_hook_location)   { UnhookWinEvent(g_hook_location);   g_hook_location = NULL; }
+  if (g_hook_destroy)    { UnhookWinEvent(g_hook_destroy);    g_hook_destroy = NULL; }
+  if (g_hook_foreground) { UnhookWinEvent(g_hook_foreground); g_hook_foreground = NULL; }
+  if (g_hook_create)     { UnhookWinEvent(g_hook_create);     g_hook_create = NULL; }
+}
+
+//follow hwnd, or wait for the game to reappear when hwnd is NULL
+static void target_track_win(HWND hwnd) {
+  target_unhook_win();
+  g_war_hwnd = hwnd;
+
+  //foreground changes: the game coming back while it is missing, its focus while tracked
+  g_hook_foreground = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND,
+                                      NULL, target_event_proc, 0, 0,
+                                      WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+  if (!hwnd) {
+    g_hook_create = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_SHOW,
+                                    NULL, target_event_proc, 0, 0,
+                                    WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+    return;
+  }
+
+  DWORD pid = 0;
+  GetWindowThreadProcessId(hwnd, &pid);
+  g_hook_location = SetWinEventHook(EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_LOCATIONCHANGE,
+                                    NULL, target_event_proc, pid, 0, WINEVENT_OUTOFCONTEXT);
+  g_hook_destroy = SetWinEventHook(EVENT_OBJECT_DESTROY, EVENT_OBJECT_DESTROY,
+                                   NULL, target_event_proc, pid, 0, WINEVENT_OUTOFCONTEXT);
+}
+
+//"Renner" if installed; GDI falls back to something else if not
+static HFONT overlay_font_create_win(void) {
+  return CreateFontA(
+      -16, 0, 0, 0,
+      FW_NORMAL,
+      FALSE, FALSE, FALSE,
+      DEFAULT_CHARSET,
+      OUT_DEFAULT_PRECIS,
+      CLIP_DEFAULT_PRECIS,
+      ANTIALIASED_QUALITY,   //greyscale AA, so coverage maps to alpha
+      DEFAULT_PITCH | FF_DONTCARE,
+      "Renner");
+}
+
+//the game window, NULL if none (one EnumWindows; window events find it later)
+static HWND find_game_window_win(void) {
+  HWND game = NULL;
+  return find_game_windows_win(&game, 1, 0) ? game : NULL;
+}
+
+//font and game come from the startup thread
+static void overlay_init_win(HFONT font, HWND game) {
+  HINSTANCE hInst = GetModuleHandle(NULL);
+
+  WNDCLASSEXA wc;
+  ZeroMemory(&wc, sizeof(wc));
+  wc.cbSize = sizeof(wc);
+  wc.lpfnWndProc = overlay_wnd_proc;
+  wc.hInstance = hInst;
+  wc.lpszClassName = "ClickerOverlayClass";
+  wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+
+  RegisterClassExA(&wc);
+
+  if (!g_overlay_font) g_overlay_font = font;
+
+  //the overlay exists from the start and stays hidden until there is a game
+  g_overlay_hwnd = CreateWindowExA(
+      WS_EX_TOPMOST | WS_EX_LAYERED | WS_EX_TRANSPARENT | WS_EX_TOOLWINDOW,
+      "ClickerOverlayClass",
+      "",
+      WS_POPUP,
+      0, 0, (int)OVERLAY_WIDTH_FULL, (int)OVERLAY_HEIGHT,
+      NULL, NULL, hInst, NULL);
+
+  //per-pixel alpha DIB; without it the window stays empty
+  if (g_overlay_hwnd && !overlay_dib_init()) {
+    DestroyWindow(g_overlay_hwnd);
+    g_overlay_hwnd = NULL;
+  }
+  if (g_overlay_hwnd) overlay_draw();
+
+  //tracking runs even without a HUD: it drives PauseUnfocused
+  if (game) {
+    target_found_win(game);
   } else {
-    //fallback: standard visual without per‑pixel alpha
-    attrs.override_redirect = True;
-    valuemask = CWOverrideRedirect;
+    printf("Game window not found yet, waiting for it.\n");
+    fflush(stdout);
+    target_track_win(NULL);
+    focus_set(0);
+  }
+}
 
-    g_overlay_win = XCreateWindow(
-        dpy, root,
-        0, 0,
-        width, height,
-        0,
-        CopyFromParent,
-        InputOutput,
-        CopyFromParent,
-        valuemask, &attrs);
+//--headless: no overlay, but a hidden top-level window is still needed for
+//WM_DISPLAYCHANGE to reach the injection's screen transform
+static void display_watch_init_win(void) {
+  HINSTANCE hInst = GetModuleHandle(NULL);
+
+  WNDCLASSEXA wc;
+  ZeroMemory(&wc, sizeof(wc));
+  wc.cbSize = sizeof(wc);
+  wc.lpfnWndProc = overlay_wnd_proc;
+  wc.hInstance = hInst;
+  wc.lpszClassName = "ClickerDisplayWatchClass";
+  RegisterClassExA(&wc);
+
+  //never shown
+  if (!CreateWindowExA(WS_EX_TOOLWINDOW, "ClickerDisplayWatchClass", "", WS_POPUP,
+                       0, 0, 0, 0, NULL, NULL, hInst, NULL))
+    fprintf(stderr, "Warning: display changes will not be tracked (%lu)\n", GetLastError());
+}
+
+//register every binding of the dispatch table; 0 if none could be
+static int register_hotkeys_win(void) {
+  hotkey_table_build();
+  int registered = 0;
+  char name[48];
+  for (int i = 0; i < (int)sizeof(g_hotkey_table); ++i) {
+    if (!g_hotkey_table[i]) continue;
+    int slot = g_hotkey_table[i] - 1;
+    UINT mods = (UINT)(i / HOTKEY_KEYS), vk = (UINT)(i % HOTKEY_KEYS);
+    if (RegisterHotKey(NULL, HK_ID_BASE + slot, mods | MOD_NOREPEAT, vk)) {
+      ++registered;
+      continue;
+    }
+    fprintf(stderr, "Warning: cannot register %s for '%s' (in use?)\n",
+            hotkey_name((int)vk, (int)mods, name, sizeof(name)), hotkey_slot_name(slot));
+    g_hotkey_table[i] = 0;
+  }
+  return registered > 0;
+}
+
+static void unregister_hotkeys_win(void) {
+  for (int slot = 0; slot < HOTKEY_SLOTS; ++slot) {
+    UnregisterHotKey(NULL, HK_ID_BASE + slot);
   }
+}
 
-  //no static backbuffer, so the compositor does not reuse an old screenshot
-  XSetWindowBackgroundPixmap(dpy, g_overlay_win, None);
+#else
+
+//helpers to register global hotkeys on Linux/X11
+static unsigned int hk_to_xmods(int mods) {
+  unsigned int m = 0;
+  if (mods & HK_MOD_SHIFT) m |= ShiftMask;
+  if (mods & HK_MOD_CTRL)  m |= ControlMask;
+  if (mods & HK_MOD_ALT)   m |= Mod1Mask;
+  if (mods & HK_MOD_SUPER) m |= Mod4Mask;
+  return m;
+}
+
+static int hk_from_xmods(unsigned int state) {
+  int m = 0;
+  if (state & ShiftMask)   m |= HK_MOD_SHIFT;
+  if (state & ControlMask) m |= HK_MOD_CTRL;
+  if (state & Mod1Mask)    m |= HK_MOD_ALT;
+  if (state & Mod4Mask)    m |= HK_MOD_SUPER;
+  return m;
+}
+
+//grab or release every binding in the dispatch table, each also with
+//NumLock/CapsLock so those do not hide the hotkey
+static void grab_hotkeys(Display *d, int grab) {
+  static const unsigned int lock_mods[] = {0, LockMask, Mod2Mask, LockMask | Mod2Mask};
+  Window root = DefaultRootWindow(d);
+  for (int i = 0; i < (int)sizeof(g_hotkey_table); ++i) {
+    if (!g_hotkey_table[i]) continue;
+    KeyCode kc = (KeyCode)(i % HOTKEY_KEYS);
+    unsigned int mods = hk_to_xmods(i / HOTKEY_KEYS);
+    for (size_t k = 0; k < sizeof(lock_mods) / sizeof(lock_mods[0]); k++) {
+      if (grab) XGrabKey(d, kc, mods | lock_mods[k], root, True, GrabModeAsync, GrabModeAsync);
+      else XUngrabKey(d, kc, mods | lock_mods[k], root);
+    }
+  }
+}
+
+static int register_hotkeys_x11(void) {
+  if (!dpy) return 0;
+  hotkey_table_build();
+  grab_hotkeys(dpy, 1);
+
+  root_select_input();
+  XFlush(dpy);
+  return 1;
+}
+
+//releases the grabs of the current table, i.e. the old keycodes after a
+//mapping change
+static void unregister_hotkeys_x11(void) {
+  if (!dpy) return;
+  grab_hotkeys(dpy, 0);
+  XFlush(dpy);
+}
+
+#endif
+
+//--------------- screen watch ---------------
+//"Watch" regions are small screen rectangles captured by their own thread
+//every Watch interval_us (XShmGetImage into shared memory on X11, DXGI
+//desktop duplication on Windows) and compared against a color range with
+//SIMD kernels. a region that starts matching sets its bit in
+//g_screen_watch_fired and wakes the main loop, which runs the action through
+//handle_action like its hotkey would; the first capture only sets the baseline.
+
+typedef struct {
+  char name[MACRO_NAME_MAX];
+  int x, y, w, h;        //virtual desktop coordinates, negative left of/above the primary monitor
+  uint32_t lo, hi;       //per-byte bounds, packed like the pixels (0xAARRGGBB)
+  unsigned int need;     //matching pixels that make the region match
+  int invert;            //'!': fire when the region stops matching
+  int action;
+} watch_region;
+
+typedef struct {
+  int n;
+  unsigned int interval_us;
+  watch_region r[WATCH_MAX];
+} watch_set;
+
+static watch_set *g_watch_set = NULL;             //main thread; read by the watch thread
+static atomic_uint g_screen_watch_fired = 0;      //region bits waiting for the main thread
+
+//---- compare kernels ----
+//count the pixels of a row whose bytes all lie within the bytes of lo..hi
+
+typedef unsigned int (*watch_count_fn)(const uint32_t *px, size_t n, uint32_t lo, uint32_t hi);
+
+static unsigned int watch_count_scalar(const uint32_t *px, size_t n, uint32_t lo, uint32_t hi) {
+  //bytes in memory order, like the vector kernels see them
+  uint8_t l[4], h[4];
+  memcpy(l, &lo, 4);
+  memcpy(h, &hi, 4);
+  const uint8_t *p = (const uint8_t *)px;
+  unsigned int c = 0;
+  for (size_t i = 0; i < n; ++i, p += 4) {
+    c += (unsigned int)((p[0] >= l[0]) & (p[0] <= h[0]) & (p[1] >= l[1]) & (p[1] <= h[1]) &
+                        (p[2] >= l[2]) & (p[2] <= h[2]) & (p[3] >= l[3]) & (p[3] <= h[3]));
+  }
+  return c;
+}
+
+#ifdef WATCH_HAVE_SSE2
+//unsigned byte compare as max/min + cmpeq; a pixel matches when all four
+//bytes do, and the all-ones lanes are subtracted from a counter (-1 each)
+static unsigned int watch_count_sse2(const uint32_t *px, size_t n, uint32_t lo, uint32_t hi) {
+  const __m128i vlo = _mm_set1_epi32((int)lo), vhi = _mm_set1_epi32((int)hi);
+  const __m128i ones = _mm_set1_epi32(-1);
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i p = _mm_loadu_si128((const __m128i *)(px + i));
+    __m128i in = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(p, vlo), p),
+                               _mm_cmpeq_epi8(_mm_min_epu8(p, vhi), p));
+    acc = _mm_sub_epi32(acc, _mm_cmpeq_epi32(in, ones));
+  }
+  uint32_t lanes[4];
+  _mm_storeu_si128((__m128i *)lanes, acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + watch_count_scalar(px + i, n - i, lo, hi);
+}
+#endif
+
+#ifdef WATCH_HAVE_AVX2
+__attribute__((target("avx2")))
+static unsigned int watch_count_avx2(const uint32_t *px, size_t n, uint32_t lo, uint32_t hi) {
+  const __m256i vlo = _mm256_set1_epi32((int)lo), vhi = _mm256_set1_epi32((int)hi);
+  const __m256i ones = _mm256_set1_epi32(-1);
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i p = _mm256_loadu_si256((const __m256i *)(px + i));
+    __m256i in = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(p, vlo), p),
+                                  _mm256_cmpeq_epi8(_mm256_min_epu8(p, vhi), p));
+    acc = _mm256_sub_epi32(acc, _mm256_cmpeq_epi32(in, ones));
+  }
+  uint32_t lanes[8];
+  _mm256_storeu_si256((__m256i *)lanes, acc);
+  unsigned int c = 0;
+  for (int k = 0; k < 8; ++k) c += lanes[k];
+  return c + watch_count_scalar(px + i, n - i, lo, hi);
+}
+#endif
+
+#ifdef WATCH_HAVE_NEON
+static unsigned int watch_count_neon(const uint32_t *px, size_t n, uint32_t lo, uint32_t hi) {
+  const uint8x16_t vlo = vreinterpretq_u8_u32(vdupq_n_u32(lo));
+  const uint8x16_t vhi = vreinterpretq_u8_u32(vdupq_n_u32(hi));
+  uint32x4_t acc = vdupq_n_u32(0);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    uint8x16_t p = vreinterpretq_u8_u32(vld1q_u32(px + i));
+    uint8x16_t in = vandq_u8(vcgeq_u8(p, vlo), vcleq_u8(p, vhi));
+    acc = vsubq_u32(acc, vceqq_u32(vreinterpretq_u32_u8(in), vdupq_n_u32(0xffffffffu)));
+  }
+  return vaddvq_u32(acc) + watch_count_scalar(px + i, n - i, lo, hi);
+}
+#endif
+
+typedef struct {
+  const char *name;
+  watch_count_fn fn;
+} watch_kernel;
+
+//the kernels this CPU runs, best last; filled by watch_kernel_init
+static watch_kernel g_watch_kernels[4];
+static int g_watch_kernel_count = 0;
+static watch_count_fn g_watch_count = watch_count_scalar;
+
+static void watch_kernel_init(void) {
+  if (g_watch_kernel_count) return;
+  g_watch_kernels[g_watch_kernel_count++] = (watch_kernel){ "scalar", watch_count_scalar };
+#ifdef WATCH_HAVE_SSE2
+  g_watch_kernels[g_watch_kernel_count++] = (watch_kernel){ "SSE2", watch_count_sse2 };
+#endif
+#ifdef WATCH_HAVE_NEON
+  g_watch_kernels[g_watch_kernel_count++] = (watch_kernel){ "NEON", watch_count_neon };
+#endif
+#ifdef WATCH_HAVE_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    g_watch_kernels[g_watch_kernel_count++] = (watch_kernel){ "AVX2", watch_count_avx2 };
+#endif
+  g_watch_count = g_watch_kernels[g_watch_kernel_count - 1].fn;
+}
+
+//matching pixels of a captured region, rows pitch bytes apart
+static unsigned int watch_count_region(const uint8_t *px, size_t pitch, const watch_region *r) {
+  unsigned int c = 0;
+  for (int y = 0; y < r->h; ++y)
+    c += g_watch_count((const uint32_t *)(px + (size_t)y * pitch), (size_t)r->w, r->lo, r->hi);
+  return c;
+}
+
+//---- region definitions ----
+
+static int watch_bad(const char *name, const char *why) {
+  fprintf(stderr, "Warning: %s%s: %s, region ignored\n", CONFIG_WATCH_PREFIX, name, why);
+  return 0;
+}
+
+//"<x> <y> <w> <h> [!]#rrggbb[~<tol>] [<n>%] <action>"
+static int watch_parse(const char *name, const char *src, watch_region *r) {
+  memset(r, 0, sizeof(*r));
+  snprintf(r->name, sizeof(r->name), "%s", name);
+  const char *p = src;
+  char *end = NULL;
+  long v[4];
+  for (int i = 0; i < 4; ++i) {
+    v[i] = strtol(p, &end, 10);
+    if (end == p) return watch_bad(name, "expected <x> <y> <w> <h>");
+    p = end;
+  }
+  if (v[0] < INT16_MIN || v[0] > INT16_MAX || v[1] < INT16_MIN || v[1] > INT16_MAX)
+    return watch_bad(name, "position out of range");
+  if (v[2] < 1 || v[3] < 1 || v[2] > WATCH_DIM_MAX || v[3] > WATCH_DIM_MAX) {
+    char why[64];
+    snprintf(why, sizeof(why), "width and height must be 1..%d", WATCH_DIM_MAX);
+    return watch_bad(name, why);
+  }
+  r->x = (int)v[0];
+  r->y = (int)v[1];
+  r->w = (int)v[2];
+  r->h = (int)v[3];
+
+  while (isspace((unsigned char)*p)) ++p;
+  if (*p == '!') {
+    r->invert = 1;
+    ++p;
+  }
+  if (*p == '#') ++p;
+  unsigned long rgb = strtoul(p, &end, 16);
+  if (end - p != 6) return watch_bad(name, "expected a color as #rrggbb");
+  p = end;
+  long tol = 0;
+  if (*p == '~') {
+    tol = strtol(p + 1, &end, 10);
+    if (end == p + 1 || tol < 0 || tol > 255) return watch_bad(name, "tolerance must be 0..255");
+    p = end;
+  }
+  //alpha is not compared: X11 leaves it undefined at depth 24
+  r->lo = 0x00000000u;
+  r->hi = 0xff000000u;
+  for (int s = 0; s < 24; s += 8) {
+    long c = (long)((rgb >> s) & 0xff);
+    r->lo |= (uint32_t)(c - tol < 0 ? 0 : c - tol) << s;
+    r->hi |= (uint32_t)(c + tol > 255 ? 255 : c + tol) << s;
+  }
+
+  long pct = 100;
+  long n = strtol(p, &end, 10);
+  if (end != p && *end == '%') {
+    if (n < 1 || n > 100) return watch_bad(name, "percentage must be 1..100");
+    pct = n;
+    p = end + 1;
+  }
+  unsigned int total = (unsigned int)(r->w * r->h);
+  r->need = (unsigned int)(((unsigned long)total * (unsigned long)pct + 99) / 100);
+
+  while (isspace((unsigned char)*p)) ++p;
+  size_t len = strlen(p);
+  r->action = action_from_name(p, len);
+  if (r->action < 0) r->action = macro_user_action(g_cfg, p, len, 0);
+  if (r->action < 0) return watch_bad(name, "unknown action");
+  return 1;
+}
+
+//the regions of the current config, NULL when there are none (main thread)
+static watch_set *watch_build(void) {
+  if (g_cfg->watch_count == 0) return NULL;
+  watch_set *set = calloc(1, sizeof(*set));
+  if (!set) {
+    fprintf(stderr, "Warning: out of memory, screen watch disabled\n");
+    return NULL;
+  }
+  set->interval_us = g_cfg->watch_interval_us;
+  for (int i = 0; i < g_cfg->watch_count; ++i) {
+    if (watch_parse(g_cfg->watch_names[i], g_cfg->watch_src[i], &set->r[set->n])) ++set->n;
+  }
+  if (set->n == 0) {
+    free(set);
+    return NULL;
+  }
+  return set;
+}
 
-  if (g_overlay_gc) {
-    XFreeGC(dpy, g_overlay_gc);
+//---- capture ----
+//watch_capture_scan fills *matched with a bit per matching region and
+//returns 1, 0 when the screen has not changed since the last scan, or -1
+//when capturing is no longer possible
+
+#ifdef _WIN32
+//every region is captured from the monitor (DXGI output) that contains it;
+//each output in use gets a duplication of its own
+typedef struct {
+  UINT index;                      //EnumOutputs index on the device's adapter
+  IDXGIOutputDuplication *dup;     //NULL while lost (mode change, secure desktop)
+  RECT desk;                       //the output in desktop coordinates
+} watch_output;
+
+typedef struct {
+  ID3D11Device *dev;
+  ID3D11DeviceContext *ctx;
+  watch_output out[WATCH_MAX];
+  int nout;
+  int region_out[WATCH_MAX];       //out[] slot of each region, -1 when on no output
+  uint32_t hit;                    //last compare result per region, before '!'
+  ID3D11Texture2D *stage[WATCH_MAX];
+} watch_capture;
+
+static IDXGIAdapter *watch_adapter(watch_capture *cap) {
+  IDXGIDevice *dxdev = NULL;
+  IDXGIAdapter *adapter = NULL;
+  if (SUCCEEDED(ID3D11Device_QueryInterface(cap->dev, &IID_IDXGIDevice, (void **)&dxdev))) {
+    if (FAILED(IDXGIDevice_GetAdapter(dxdev, &adapter))) adapter = NULL;
+    IDXGIDevice_Release(dxdev);
   }
-  g_overlay_gc = XCreateGC(dpy, g_overlay_win, 0, NULL);
+  return adapter;
+}
 
-  //try to load "Renner" font; if missing, X11 uses a default font
-  if (!g_overlay_font) {
-    g_overlay_font = XLoadQueryFont(dpy, "Renner-12");
-    if (!g_overlay_font) {
-      g_overlay_font = XLoadQueryFont(dpy, "Renner");
-    }
+//duplicate one output of the device's adapter
+static int watch_dup_open(watch_capture *cap, watch_output *o, int verbose) {
+  IDXGIAdapter *adapter = watch_adapter(cap);
+  IDXGIOutput *output = NULL;
+  IDXGIOutput1 *output1 = NULL;
+  HRESULT hr = adapter ? IDXGIAdapter_EnumOutputs(adapter, o->index, &output) : E_FAIL;
+  if (SUCCEEDED(hr)) {
+    DXGI_OUTPUT_DESC desc;
+    hr = IDXGIOutput_GetDesc(output, &desc);
+    o->desk = desc.DesktopCoordinates;
+  }
+  if (SUCCEEDED(hr)) hr = IDXGIOutput_QueryInterface(output, &IID_IDXGIOutput1, (void **)&output1);
+  if (SUCCEEDED(hr)) hr = IDXGIOutput1_DuplicateOutput(output1, (IUnknown *)cap->dev, &o->dup);
+  if (output1) IDXGIOutput1_Release(output1);
+  if (output) IDXGIOutput_Release(output);
+  if (adapter) IDXGIAdapter_Release(adapter);
+  if (FAILED(hr)) {
+    o->dup = NULL;
+    if (verbose) fprintf(stderr, "Warning: desktop duplication failed (0x%08lx)\n", (unsigned long)hr);
+    return 0;
   }
+  return 1;
+}
 
-  //color used for overlay text (usually white)
-  if (g_argb_colormap) {
-    XColor col, dummy;
-    if (XAllocNamedColor(dpy, g_argb_colormap, "white", &col, &dummy)) {
-      g_overlay_white_pixel = col.pixel;
-    } else {
-      g_overlay_white_pixel = WhitePixel(dpy, screen);
+//assign each region the output whose desktop rectangle contains all of it
+static void watch_outputs_map(watch_capture *cap, const watch_set *set) {
+  IDXGIAdapter *adapter = watch_adapter(cap);
+  for (int i = 0; i < set->n; ++i) cap->region_out[i] = -1;
+  IDXGIOutput *output = NULL;
+  for (UINT k = 0; adapter && SUCCEEDED(IDXGIAdapter_EnumOutputs(adapter, k, &output)); ++k) {
+    DXGI_OUTPUT_DESC desc;
+    int ok = SUCCEEDED(IDXGIOutput_GetDesc(output, &desc));
+    IDXGIOutput_Release(output);
+    if (!ok) continue;
+    const RECT *d = &desc.DesktopCoordinates;
+    int slot = -1;
+    for (int i = 0; i < set->n; ++i) {
+      const watch_region *r = &set->r[i];
+      if (cap->region_out[i] >= 0 || r->x < d->left || r->y < d->top ||
+          r->x + r->w > d->right || r->y + r->h > d->bottom)
+        continue;
+      if (slot < 0) {
+        slot = cap->nout++;
+        cap->out[slot].index = k;
+        cap->out[slot].desk = *d;
+      }
+      cap->region_out[i] = slot;
     }
-  } else {
-    g_overlay_white_pixel = WhitePixel(dpy, screen);
   }
+  if (adapter) IDXGIAdapter_Release(adapter);
+  for (int i = 0; i < set->n; ++i) {
+    if (cap->region_out[i] < 0)
+      fprintf(stderr, "Warning: %s%s is not within one monitor, it never matches\n",
+              CONFIG_WATCH_PREFIX, set->r[i].name);
+  }
+}
 
-  XSelectInput(dpy, g_overlay_win, ExposureMask);
+static void watch_capture_close(watch_capture *cap) {
+  for (int i = 0; i < WATCH_MAX; ++i) {
+    if (cap->stage[i]) ID3D11Texture2D_Release(cap->stage[i]);
+  }
+  for (int k = 0; k < cap->nout; ++k) {
+    if (cap->out[k].dup) IDXGIOutputDuplication_Release(cap->out[k].dup);
+  }
+  if (cap->ctx) ID3D11DeviceContext_Release(cap->ctx);
+  if (cap->dev) ID3D11Device_Release(cap->dev);
+  memset(cap, 0, sizeof(*cap));
 }
 
-static void overlay_draw(void) {
-  if (!dpy || !g_overlay_win) return;
-  if (atomic_load(&g_overlay_hidden)) return;
+static int watch_capture_open(watch_capture *cap, const watch_set *set) {
+  memset(cap, 0, sizeof(*cap));
+  HRESULT hr = D3D11CreateDevice(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, 0, NULL, 0,
+                                 D3D11_SDK_VERSION, &cap->dev, NULL, &cap->ctx);
+  if (FAILED(hr)) {
+    fprintf(stderr, "Warning: no Direct3D 11 device (0x%08lx), screen watch disabled\n",
+            (unsigned long)hr);
+    return 0;
+  }
+  watch_outputs_map(cap, set);
+  for (int k = 0; k < cap->nout; ++k) {
+    if (!watch_dup_open(cap, &cap->out[k], 1)) {
+      watch_capture_close(cap);
+      return 0;
+    }
+  }
+  //one small CPU-readable copy target per region: only those pixels leave the GPU
+  for (int i = 0; i < set->n; ++i) {
+    D3D11_TEXTURE2D_DESC d;
+    memset(&d, 0, sizeof(d));
+    d.Width = (UINT)set->r[i].w;
+    d.Height = (UINT)set->r[i].h;
+    d.MipLevels = 1;
+    d.ArraySize = 1;
+    d.Format = DXGI_FORMAT_B8G8R8A8_UNORM;   //what DuplicateOutput always delivers
+    d.SampleDesc.Count = 1;
+    d.Usage = D3D11_USAGE_STAGING;
+    d.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    if (FAILED(ID3D11Device_CreateTexture2D(cap->dev, &d, NULL, &cap->stage[i]))) {
+      fprintf(stderr, "Warning: cannot create capture textures, screen watch disabled\n");
+      watch_capture_close(cap);
+      return 0;
+    }
+  }
+  return 1;
+}
 
-  //use Renner font if it was loaded
-  if (g_overlay_font) {
-    XSetFont(dpy, g_overlay_gc, g_overlay_font->fid);
+//queue the copies of the regions on output o from its next frame; returns
+//their bits, 0 when o has no new frame, -1 when duplication cannot go on
+static int64_t watch_output_copy(watch_capture *cap, const watch_set *set, int slot) {
+  watch_output *o = &cap->out[slot];
+  if (!o->dup && !watch_dup_open(cap, o, 0)) return 0;   //retried every interval
+
+  DXGI_OUTDUPL_FRAME_INFO info;
+  IDXGIResource *res = NULL;
+  HRESULT hr = IDXGIOutputDuplication_AcquireNextFrame(o->dup, 0, &info, &res);
+  if (hr == DXGI_ERROR_WAIT_TIMEOUT) return 0;
+  if (hr == DXGI_ERROR_ACCESS_LOST) {
+    IDXGIOutputDuplication_Release(o->dup);
+    o->dup = NULL;
+    return 0;
+  }
+  if (FAILED(hr)) {
+    fprintf(stderr, "Warning: desktop duplication stopped (0x%08lx), screen watch disabled\n",
+            (unsigned long)hr);
+    return -1;
+  }
+  ID3D11Texture2D *frame = NULL;
+  hr = IDXGIResource_QueryInterface(res, &IID_ID3D11Texture2D, (void **)&frame);
+  IDXGIResource_Release(res);
+  if (FAILED(hr)) {
+    IDXGIOutputDuplication_ReleaseFrame(o->dup);
+    return 0;
   }
 
-  char buf[512];
-  build_overlay_text(buf, sizeof(buf));
+  //a mode change moves or resizes the output: such regions wait for the next config load
+  LONG dw = o->desk.right - o->desk.left, dh = o->desk.bottom - o->desk.top;
+  uint32_t copied = 0;
+  for (int i = 0; i < set->n; ++i) {
+    if (cap->region_out[i] != slot) continue;
+    const watch_region *r = &set->r[i];
+    LONG x = r->x - o->desk.left, y = r->y - o->desk.top;
+    if (x < 0 || y < 0 || x + r->w > dw || y + r->h > dh) continue;
+    D3D11_BOX box = { (UINT)x, (UINT)y, 0, (UINT)(x + r->w), (UINT)(y + r->h), 1 };
+    ID3D11DeviceContext_CopySubresourceRegion(cap->ctx, (ID3D11Resource *)cap->stage[i], 0, 0, 0,
+                                              0, (ID3D11Resource *)frame, 0, &box);
+    copied |= 1u << i;
+  }
+  ID3D11Texture2D_Release(frame);
+  IDXGIOutputDuplication_ReleaseFrame(o->dup);
+  return copied;
+}
 
-  char active[128];
-  active[0] = '\0';
-  if (atomic_load(&g_spam_left)) strcat(active, " Spam");
-  if (atomic_load(&g_hold_w))   strcat(active, " W");
-  if (atomic_load(&g_hold_s))   strcat(active, " S");
-  if (atomic_load(&g_hold_rmb)) strcat(active, " RMB");
-  if (atomic_load(&g_hold_lmb)) strcat(active, " LMB");
-  if (atomic_load(&g_suspended))strcat(active, " [SUSP]");
+static int watch_capture_scan(watch_capture *cap, const watch_set *set, uint32_t *matched) {
+  //queue all copies first, then map: the GPU copies while we wait on the first
+  uint32_t fresh = 0;
+  for (int k = 0; k < cap->nout; ++k) {
+    int64_t c = watch_output_copy(cap, set, k);
+    if (c < 0) return -1;
+    fresh |= (uint32_t)c;
+  }
+  if (!fresh) return 0;
+
+  //regions of outputs without a new frame keep their last result
+  for (int i = 0; i < set->n; ++i) {
+    if (!(fresh & (1u << i))) continue;
+    const watch_region *r = &set->r[i];
+    int hit = 0;
+    D3D11_MAPPED_SUBRESOURCE map;
+    if (SUCCEEDED(ID3D11DeviceContext_Map(cap->ctx, (ID3D11Resource *)cap->stage[i], 0,
+                                          D3D11_MAP_READ, 0, &map))) {
+      hit = watch_count_region((const uint8_t *)map.pData, map.RowPitch, r) >= r->need;
+      ID3D11DeviceContext_Unmap(cap->ctx, (ID3D11Resource *)cap->stage[i], 0);
+    }
+    cap->hit = hit ? (cap->hit | (1u << i)) : (cap->hit & ~(1u << i));
+  }
+  uint32_t m = 0;
+  for (int i = 0; i < set->n; ++i) {
+    if (((cap->hit >> i) & 1u) != (uint32_t)set->r[i].invert) m |= 1u << i;
+  }
+  *matched = m;
+  return 1;
+}
+#else
+typedef struct {
+  Display *d;
+  Window root;
+  int shm;                         //MIT-SHM: the server writes straight into our memory
+  int scr_w, scr_h;
+  unsigned int gen;                //g_screen_gen scr_w/scr_h belong to
+  XImage *img[WATCH_MAX];
+  XShmSegmentInfo seg[WATCH_MAX];
+} watch_capture;
+
+static void watch_capture_close(watch_capture *cap) {
+  for (int i = 0; i < WATCH_MAX; ++i) {
+    if (!cap->img[i]) continue;
+    if (cap->shm) {
+      XShmDetach(cap->d, &cap->seg[i]);
+      shmdt(cap->seg[i].shmaddr);
+      cap->img[i]->data = NULL;
+    }
+    XDestroyImage(cap->img[i]);   //frees the data of a plain image
+  }
+  if (cap->d) XCloseDisplay(cap->d);
+  memset(cap, 0, sizeof(*cap));
+}
 
-  if (active[0] != '\0') {
-    strncat(buf, " | Active:", sizeof(buf) - strlen(buf) - 1);
-    strncat(buf, active, sizeof(buf) - strlen(buf) - 1);
+static void watch_screen_size(watch_capture *cap) {
+  Window r;
+  int x, y;
+  unsigned int w, h, bw, depth;
+  cap->gen = atomic_load_explicit(&g_screen_gen, memory_order_acquire);
+  if (XGetGeometry(cap->d, cap->root, &r, &x, &y, &w, &h, &bw, &depth)) {
+    cap->scr_w = (int)w;
+    cap->scr_h = (int)h;
   }
+}
 
-  //compute text area so we can clear only that part
-  XWindowAttributes wa;
-  XGetWindowAttributes(dpy, g_overlay_win, &wa);
-  int text_width = wa.width;
-  int text_height = OVERLAY_HEIGHT;
-  size_t text_len = strlen(buf);
-  if (g_overlay_font && text_len > 0) {
-    text_width = XTextWidth(g_overlay_font, buf, (int)text_len);
-    text_height = g_overlay_font->ascent + g_overlay_font->descent;
+static int watch_capture_open(watch_capture *cap, const watch_set *set) {
+  memset(cap, 0, sizeof(*cap));
+  cap->d = XOpenDisplay(NULL);
+  if (!cap->d) {
+    fprintf(stderr, "Warning: cannot open a display connection, screen watch disabled\n");
+    return 0;
   }
-  unsigned int clear_w = (unsigned int)(text_width + 8);
-  unsigned int clear_h = (unsigned int)(text_height + 4);
-  if (clear_w > (unsigned int)wa.width)  clear_w = (unsigned int)wa.width;
-  if (clear_h > (unsigned int)wa.height) clear_h = (unsigned int)wa.height;
+  int scr = DefaultScreen(cap->d);
+  Visual *vis = DefaultVisual(cap->d, scr);
+  int depth = DefaultDepth(cap->d, scr);
+  cap->root = RootWindow(cap->d, scr);
+  //the kernels read 0x..RRGGBB words in host byte order
+  const uint32_t one = 1;
+  int host_lsb = *(const uint8_t *)&one == 1;
+  if (vis->class != TrueColor || vis->red_mask != 0xff0000 || vis->green_mask != 0xff00 ||
+      vis->blue_mask != 0xff || ImageByteOrder(cap->d) != (host_lsb ? LSBFirst : MSBFirst)) {
+    fprintf(stderr, "Warning: screen format is not 8-bit RGB, screen watch disabled\n");
+    watch_capture_close(cap);
+    return 0;
+  }
+  //shared memory only works with a local server; a forwarded display
+  //reports the extension and then fails the attach
+  const char *name = DisplayString(cap->d);
+  cap->shm = XShmQueryExtension(cap->d) && (name[0] == ':' || strncmp(name, "unix:", 5) == 0);
+  watch_screen_size(cap);
+
+  for (int i = 0; i < set->n; ++i) {
+    const watch_region *r = &set->r[i];
+    //the root window spans every monitor from 0,0
+    if (r->x < 0 || r->y < 0 || r->x + r->w > cap->scr_w || r->y + r->h > cap->scr_h)
+      fprintf(stderr, "Warning: %s%s is outside the screen, it never matches\n",
+              CONFIG_WATCH_PREFIX, r->name);
+    XImage *img = NULL;
+    if (cap->shm) {
+      XShmSegmentInfo *seg = &cap->seg[i];
+      img = XShmCreateImage(cap->d, vis, (unsigned int)depth, ZPixmap, NULL, seg,
+                            (unsigned int)r->w, (unsigned int)r->h);
+      if (img) {
+        seg->shmid = shmget(IPC_PRIVATE, (size_t)img->bytes_per_line * (size_t)img->height,
+                            IPC_CREAT | 0600);
+        seg->shmaddr = (seg->shmid >= 0) ? shmat(seg->shmid, NULL, 0) : (char *)-1;
+        if (seg->shmaddr == (char *)-1) {
+          if (seg->shmid >= 0) shmctl(seg->shmid, IPC_RMID, NULL);
+          XDestroyImage(img);
+          fprintf(stderr, "Warning: cannot get shared memory, screen watch disabled\n");
+          watch_capture_close(cap);
+          return 0;
+        }
+        img->data = seg->shmaddr;
+        seg->readOnly = False;
+        XShmAttach(cap->d, seg);
+        XSync(cap->d, False);
+        //removed now, freed by the kernel once both sides detach (or exit)
+        shmctl(seg->shmid, IPC_RMID, NULL);
+      }
+    } else {
+      char *data = malloc((size_t)r->w * (size_t)r->h * 4);
+      if (data) {
+        img = XCreateImage(cap->d, vis, (unsigned int)depth, ZPixmap, 0, data,
+                           (unsigned int)r->w, (unsigned int)r->h, 32, 0);
+        if (!img) free(data);
+      }
+    }
+    if (!img || img->bits_per_pixel != 32) {
+      if (img) cap->img[i] = img;
+      fprintf(stderr, "Warning: cannot create capture images, screen watch disabled\n");
+      watch_capture_close(cap);
+      return 0;
+    }
+    cap->img[i] = img;
+  }
+  return 1;
+}
 
-  //clear only the text region to alpha 0 when using ARGB
-  if (g_argb_visual && g_argb_depth > 0 && g_argb_colormap) {
-    XSetForeground(dpy, g_overlay_gc, 0x00000000u);
-    XFillRectangle(dpy, g_overlay_win, g_overlay_gc,
-                   0, 0, clear_w, clear_h);
+static int watch_capture_scan(watch_capture *cap, const watch_set *set, uint32_t *matched) {
+  //a region off the screen would be a BadMatch, which ends the process
+  if (cap->gen != atomic_load_explicit(&g_screen_gen, memory_order_acquire))
+    watch_screen_size(cap);
+  uint32_t m = 0;
+  for (int i = 0; i < set->n; ++i) {
+    const watch_region *r = &set->r[i];
+    XImage *img = cap->img[i];
+    int hit = 0;
+    if (r->x >= 0 && r->y >= 0 && r->x + r->w <= cap->scr_w && r->y + r->h <= cap->scr_h) {
+      int ok = cap->shm ? XShmGetImage(cap->d, cap->root, img, r->x, r->y, AllPlanes)
+                        : XGetSubImage(cap->d, cap->root, r->x, r->y, (unsigned int)r->w,
+                                       (unsigned int)r->h, AllPlanes, ZPixmap, img, 0, 0) != NULL;
+      if (ok) hit = watch_count_region((const uint8_t *)img->data, (size_t)img->bytes_per_line, r) >= r->need;
+    }
+    if (hit != r->invert) m |= 1u << i;
   }
+  *matched = m;
+  return 1;
+}
+#endif
 
-  int screen = DefaultScreen(dpy);
-  unsigned long white_pixel = g_overlay_white_pixel ? g_overlay_white_pixel
-                                                    : WhitePixel(dpy, screen);
+//---- watch thread ----
 
-  XSetForeground(dpy, g_overlay_gc, white_pixel);
-  XDrawString(dpy, g_overlay_win, g_overlay_gc, 4, 18, buf, (int)strlen(buf));
-  XFlush(dpy);
+#ifdef _WIN32
+static HANDLE g_screen_watch_thread = NULL;
+static HANDLE g_screen_watch_stop_event = NULL;   //manual reset
+static HANDLE g_screen_watch_timer = NULL;
+#else
+static pthread_t g_screen_watch_thread;
+static int g_screen_watch_started = 0;
+static int g_screen_watch_stop_pipe[2] = { -1, -1 };
+#endif
+
+//sleep until the absolute now_ns() deadline; 0 when asked to stop
+static int screen_watch_sleep(uint64_t deadline) {
+#ifdef _WIN32
+  uint64_t t = now_ns();
+  if (deadline <= t) return WaitForSingleObject(g_screen_watch_stop_event, 0) != WAIT_OBJECT_0;
+  LARGE_INTEGER due;
+  due.QuadPart = -(LONGLONG)((deadline - t) / 100ull);
+  if (due.QuadPart == 0) due.QuadPart = -1;
+  if (!g_screen_watch_timer || !SetWaitableTimer(g_screen_watch_timer, &due, 0, NULL, NULL, FALSE))
+    return WaitForSingleObject(g_screen_watch_stop_event,
+                               (DWORD)((deadline - t + 999999ull) / 1000000ull)) != WAIT_OBJECT_0;
+  HANDLE handles[2] = { g_screen_watch_stop_event, g_screen_watch_timer };
+  return WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0;
+#else
+  struct pollfd pfd = { g_screen_watch_stop_pipe[0], POLLIN, 0 };
+  for (;;) {
+    uint64_t t = now_ns();
+    if (deadline <= t) deadline = t;
+    struct timespec ts = { (time_t)((deadline - t) / 1000000000ull),
+                           (long)((deadline - t) % 1000000000ull) };
+    int r = ppoll(&pfd, 1, &ts, NULL);
+    if (r >= 0) return r == 0;
+    if (errno != EINTR) return 0;
+  }
+#endif
 }
 
-#endif //!_WIN32
+static void screen_watch_run(const watch_set *set) {
+  trace_thread("screen watch");
+  watch_capture cap;
+  if (!watch_capture_open(&cap, set)) return;
+
+  uint64_t period = (uint64_t)set->interval_us * 1000ull;
+  uint64_t deadline = now_ns();
+  uint32_t matched = 0;
+  int primed = 0;
+  for (;;) {
+    uint64_t t0 = now_ns();
+    uint32_t m = 0;
+    int r = watch_capture_scan(&cap, set, &m);
+    if (r < 0) break;
+    if (r > 0) {
+      hist_record(&g_hist_watch, now_ns() - t0);
+      trace_span("screen_watch", t0, "matched", m);
+      uint32_t rising = m & ~matched;
+      matched = m;
+      if (primed && rising) {
+        atomic_fetch_or_explicit(&g_screen_watch_fired, rising, memory_order_release);
+        ui_notify();
+      }
+      primed = 1;
+    }
+    //a late scan moves the schedule instead of catching up with a burst
+    deadline += period;
+    if (deadline < now_ns()) deadline = now_ns();
+    if (!screen_watch_sleep(deadline)) break;
+  }
+  watch_capture_close(&cap);
+}
 
-//--------------- overlay draw stub for Windows ---
 #ifdef _WIN32
-static void overlay_draw(void) {
-  if (g_overlay_hwnd) {
-    InvalidateRect(g_overlay_hwnd, NULL, TRUE);
-  }
+static DWORD WINAPI screen_watch_thread(LPVOID arg) {
+  screen_watch_run((const watch_set *)arg);
+  return 0;
+}
+#else
+static void *screen_watch_thread(void *arg) {
+  screen_watch_run((const watch_set *)arg);
+  return NULL;
 }
 #endif
 
-//--------------- worker thread -------------------
-static void set_all_up(void) {
-  atomic_store(&g_spam_left, 0);
-  atomic_store(&g_hold_w, 0);
-  atomic_store(&g_hold_s, 0);
-  atomic_store(&g_hold_lmb, 0);
-  atomic_store(&g_hold_rmb, 0);
-
+static void screen_watch_stop(void) {
 #ifdef _WIN32
-  //release in case they were held
-  win_send_key('W', 0);
-  win_send_key('S', 0);
-  win_send_mouse_btn(0, 0);
-  win_send_mouse_btn(1, 0);
+  if (g_screen_watch_thread) {
+    SetEvent(g_screen_watch_stop_event);
+    WaitForSingleObject(g_screen_watch_thread, INFINITE);
+    CloseHandle(g_screen_watch_thread);
+    g_screen_watch_thread = NULL;
+  }
+  if (g_screen_watch_timer) CloseHandle(g_screen_watch_timer);
+  if (g_screen_watch_stop_event) CloseHandle(g_screen_watch_stop_event);
+  g_screen_watch_timer = g_screen_watch_stop_event = NULL;
 #else
-  x11_key(XK_w, 0);
-  x11_key(XK_s, 0);
-  x11_mouse_btn(0, 0);
-  x11_mouse_btn(1, 0);
+  if (g_screen_watch_started) {
+    char c = 1;
+    if (write(g_screen_watch_stop_pipe[1], &c, 1) < 0) { }
+    pthread_join(g_screen_watch_thread, NULL);
+    close(g_screen_watch_stop_pipe[0]);
+    close(g_screen_watch_stop_pipe[1]);
+    g_screen_watch_started = 0;
+  }
 #endif
+  free(g_watch_set);
+  g_watch_set = NULL;
+  //bits of the old regions mean nothing for the new ones
+  atomic_store(&g_screen_watch_fired, 0);
 }
 
+//(re)start the watch thread on the regions of the current config (main thread)
+static void screen_watch_configure(void) {
+  screen_watch_stop();
+  watch_set *set = watch_build();
+  if (!set) return;
+  watch_kernel_init();
+
 #ifdef _WIN32
-static DWORD WINAPI worker_thread(LPVOID unused)   //background loop for actions (Windows)
+  g_screen_watch_stop_event = CreateEventA(NULL, TRUE, FALSE, NULL);
+  g_screen_watch_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                                TIMER_ALL_ACCESS);
+  if (!g_screen_watch_timer) g_screen_watch_timer = CreateWaitableTimerW(NULL, FALSE, NULL);
+  if (g_screen_watch_stop_event)
+    g_screen_watch_thread = CreateThread(NULL, 0, screen_watch_thread, set, 0, NULL);
+  int ok = g_screen_watch_thread != NULL;
 #else
-static void* worker_thread(void* unused)           //background loop for actions (Linux)
+  int ok = pipe(g_screen_watch_stop_pipe) == 0;
+  if (ok && pthread_create(&g_screen_watch_thread, NULL, screen_watch_thread, set) != 0) {
+    close(g_screen_watch_stop_pipe[0]);
+    close(g_screen_watch_stop_pipe[1]);
+    ok = 0;
+  }
+  g_screen_watch_started = ok;
 #endif
-{
-  (void)unused;
+  if (!ok) {
+    fprintf(stderr, "Warning: cannot start the screen watch\n");
+    free(set);
+    screen_watch_stop();
+    return;
+  }
+  g_watch_set = set;
+  printf("Screen watch: %d region%s every %.1f ms (%s)\n", set->n, set->n == 1 ? "" : "s",
+         (double)set->interval_us / 1e3, g_watch_kernels[g_watch_kernel_count - 1].name);
+  fflush(stdout);
+}
+
+//run the actions of regions that started matching (main thread). a trigger
+//starts its action and never stops it: a macro that is still running is
+//left alone, and nothing fires while the tool is paused
+static void screen_watch_poll(void) {
+  uint32_t fired = atomic_exchange_explicit(&g_screen_watch_fired, 0, memory_order_acquire);
+  if (!fired || !g_watch_set) return;
+  for (int i = 0; i < g_watch_set->n; ++i) {
+    if (!(fired & (1u << i))) continue;
+    const watch_region *r = &g_watch_set->r[i];
+    uint32_t flags = st_flags(state_load());
+    const macro_def *def = &g_macro_main->defs[r->action];
+    if ((flags & ST_PAUSED) || (def->len && (flags & def->bit))) continue;
+    printf("Watch %s: %s\n", r->name, g_action_names[r->action]);
+    fflush(stdout);
+    trace_instant("watch", trace_now(), "region", i);
+    handle_action(r->action);
+  }
+}
 
-  int w_is_down = 0, s_is_down = 0, lmb_is_down = 0, rmb_is_down = 0;
-  uint64_t last_click = 0;
+//--------------- config hot reload ---------------
+//a watcher thread sleeps until the config file changes (inotify /
+//ReadDirectoryChangesW, no polling), parses it into a fresh snapshot and
+//publishes that; the main thread swaps it in on its next wakeup, rebuilds
+//the macros and the dispatch table and regrabs the hotkeys. held input and
+//running macros are left alone.
+
+static _Atomic(config_snap *) g_cfg_pending = NULL;
+
+//watcher thread: parse the file and hand the snapshot to the main thread
+static void config_publish(void) {
+  config_snap *c = config_load();
+  if (!c) return;
+  //a snapshot the main thread has not taken yet is superseded
+  free(atomic_exchange_explicit(&g_cfg_pending, c, memory_order_acq_rel));
+  ui_notify();
+}
 
-  while (atomic_load(&g_running)) {
-    if (atomic_load(&g_suspended)) {
-      //ensure nothing is held
-      if (w_is_down) { 
+//make a published snapshot current (main thread)
+static void config_apply_pending(void) {
+  config_snap *c = atomic_exchange_explicit(&g_cfg_pending, NULL, memory_order_acq_rel);
+  if (!c) return;
+  if (memcmp(c, g_cfg, sizeof(*c)) == 0) {   //saved without changes
+    free(c);
+    return;
+  }
+  if (c->uinput != g_cfg->uinput || c->multibox != g_cfg->multibox ||
+      memcmp(&c->worker, &g_cfg->worker, sizeof(c->worker)) != 0)
+    fprintf(stderr, "Warning: Injector, Multibox and Worker settings take effect after a restart\n");
+
+  //release the grabs of the old bindings before the table is rebuilt
 #ifdef _WIN32
-        win_send_key('W', 0);
+  unregister_hotkeys_win();
 #else
-        x11_key(XK_w, 0);
+  unregister_hotkeys_x11();
 #endif
-        w_is_down = 0;
-      }
-      if (s_is_down) { 
+  config_snap *old = g_cfg;
+  g_cfg = c;
+  config_bind_names();
+  if (!macro_publish()) fprintf(stderr, "Warning: out of memory, macros not reloaded\n");
+  send_config_to_worker();
+  screen_watch_configure();
+
+  //macros that no longer exist are switched off; their runs release what they hold
+  uint32_t gone = 0;
+  for (int i = 0; i < MACRO_USER_MAX; ++i) {
+    if (g_macro_main->defs[ACTION_MACRO_FIRST + i].len == 0) gone |= ST_MACRO(i);
+  }
+  if (st_flags(state_load()) & gone) state_update(gone, 0);
+  worker_wake();
+
 #ifdef _WIN32
-        win_send_key('S', 0);
+  register_hotkeys_win();
 #else
-        x11_key(XK_s, 0);
+  register_hotkeys_x11();
 #endif
-        s_is_down = 0;
-      }
-      if (lmb_is_down) { 
+  free(old);
+  focus_apply();
+  state_changed();
+  printf("Config reloaded.\n");
+  fflush(stdout);
+}
+
 #ifdef _WIN32
-        win_send_mouse_btn(0, 0);
+#define CONFIG_SETTLE_MS 50   //editors write in several steps
+
+static HANDLE g_watch_thread = NULL;
+static HANDLE g_watch_stop_event = NULL;
+
+static DWORD WINAPI config_watch_thread(LPVOID arg) {
+  HANDLE dir = (HANDLE)arg;
+  trace_thread("config watch");
+  static const WCHAR name[] = L"" CONFIG_FILE;
+  DWORD buf[2048];   //FILE_NOTIFY_INFORMATION records are DWORD aligned
+  OVERLAPPED ov;
+  memset(&ov, 0, sizeof(ov));
+  ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+  HANDLE waits[2] = { ov.hEvent, g_watch_stop_event };
+
+  while (ov.hEvent) {
+    ResetEvent(ov.hEvent);
+    if (!ReadDirectoryChangesW(dir, buf, sizeof(buf), FALSE,
+                               FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+                               NULL, &ov, NULL))
+      break;
+    DWORD got = 0;
+    if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+      CancelIo(dir);
+      GetOverlappedResult(dir, &ov, &got, TRUE);
+      break;
+    }
+    if (!GetOverlappedResult(dir, &ov, &got, FALSE)) break;
+
+    //got == 0: too many changes for the buffer, the file may be one of them
+    int hit = (got == 0);
+    const BYTE *p = (const BYTE *)buf;
+    while (got) {
+      const FILE_NOTIFY_INFORMATION *e = (const FILE_NOTIFY_INFORMATION *)p;
+      if (CompareStringOrdinal(e->FileName, (int)(e->FileNameLength / sizeof(WCHAR)),
+                               name, -1, TRUE) == CSTR_EQUAL)
+        hit = 1;
+      if (!e->NextEntryOffset) break;
+      p += e->NextEntryOffset;
+    }
+    if (hit && WaitForSingleObject(g_watch_stop_event, CONFIG_SETTLE_MS) == WAIT_TIMEOUT)
+      config_publish();
+  }
+
+  if (ov.hEvent) CloseHandle(ov.hEvent);
+  CloseHandle(dir);
+  return 0;
+}
+
+static void config_watch_start(void) {
+  HANDLE dir = CreateFileA(".", FILE_LIST_DIRECTORY,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                           OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+  if (dir == INVALID_HANDLE_VALUE) {
+    fprintf(stderr, "Warning: cannot watch '%s' for changes (error %lu)\n",
+            CONFIG_FILE, GetLastError());
+    return;
+  }
+  g_watch_stop_event = CreateEventA(NULL, TRUE, FALSE, NULL);
+  if (g_watch_stop_event)
+    g_watch_thread = CreateThread(NULL, 0, config_watch_thread, dir, 0, NULL);
+  if (!g_watch_thread) {
+    fprintf(stderr, "Warning: cannot start the config watcher\n");
+    if (g_watch_stop_event) CloseHandle(g_watch_stop_event);
+    g_watch_stop_event = NULL;
+    CloseHandle(dir);
+  }
+}
+
+static void config_watch_stop(void) {
+  if (g_watch_thread) {
+    SetEvent(g_watch_stop_event);
+    WaitForSingleObject(g_watch_thread, INFINITE);
+    CloseHandle(g_watch_thread);
+    CloseHandle(g_watch_stop_event);
+    g_watch_thread = NULL;
+    g_watch_stop_event = NULL;
+  }
+  free(atomic_exchange(&g_cfg_pending, NULL));
+}
 #else
-        x11_mouse_btn(0, 0);
+static pthread_t g_watch_thread;
+static int g_watch_started = 0;
+static int g_watch_stop_pipe[2] = { -1, -1 };
+
+static void* config_watch_thread(void* arg) {
+  int fd = (int)(intptr_t)arg;
+  trace_thread("config watch");
+  _Alignas(struct inotify_event) char buf[4096];
+  struct pollfd pfd[2] = { { fd, POLLIN, 0 }, { g_watch_stop_pipe[0], POLLIN, 0 } };
+
+  for (;;) {
+    if (poll(pfd, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (pfd[1].revents) break;
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) continue;
+
+    //IN_CLOSE_WRITE / IN_MOVED_TO: the file is complete when we see it
+    int hit = 0;
+    for (char *p = buf; p < buf + n; ) {
+      const struct inotify_event *e = (const struct inotify_event *)p;
+      if (e->len && strcmp(e->name, CONFIG_FILE) == 0) hit = 1;
+      p += sizeof(*e) + e->len;
+    }
+    if (hit) config_publish();
+  }
+  close(fd);
+  return NULL;
+}
+
+static void config_watch_start(void) {
+  //watch the directory: editors often replace the file instead of writing it
+  int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+  if (fd < 0 || inotify_add_watch(fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    fprintf(stderr, "Warning: cannot watch '%s' for changes (%s)\n", CONFIG_FILE, strerror(errno));
+    if (fd >= 0) close(fd);
+    return;
+  }
+  if (pipe(g_watch_stop_pipe) != 0) {
+    fprintf(stderr, "Warning: cannot start the config watcher\n");
+    close(fd);
+    return;
+  }
+  if (pthread_create(&g_watch_thread, NULL, config_watch_thread, (void *)(intptr_t)fd) != 0) {
+    fprintf(stderr, "Warning: cannot start the config watcher\n");
+    close(fd);
+    close(g_watch_stop_pipe[0]);
+    close(g_watch_stop_pipe[1]);
+    return;
+  }
+  g_watch_started = 1;
+}
+
+static void config_watch_stop(void) {
+  if (g_watch_started) {
+    char c = 1;
+    if (write(g_watch_stop_pipe[1], &c, 1) < 0) { }
+    pthread_join(g_watch_thread, NULL);
+    close(g_watch_stop_pipe[0]);
+    close(g_watch_stop_pipe[1]);
+    g_watch_started = 0;
+  }
+  free(atomic_exchange(&g_cfg_pending, NULL));
+}
 #endif
-        lmb_is_down = 0;
-      }
-      if (rmb_is_down) { 
+
+//--------------- benchmarks (--bench) -----------------
+//"--bench" runs every benchmark the session allows, "--bench mock" only the
+//headless ones (CI). injection benchmarks move the pointer to where it
+//already is, so nothing visible happens.
+
+#define BENCH_MOCK_BATCHES       1000000
+#define BENCH_INJECT_EVENTS      20000
+#define BENCH_WORKER_SECS        2
+#define BENCH_WORKER_INTERVAL_US 1000u
+#define BENCH_BURST_CPS          5000u
+#define BENCH_OVERLAY_FRAMES     300
+#define BENCH_HUD_COMPOSES       100000
+#define BENCH_DISCOVERY_RUNS     20
+#define BENCH_WATCH_RUNS         2000
+#define BENCH_WATCH_CAPTURES     200
+
+static hist g_hist_bench = { .name = "bench" };
+
+static void hist_reset(hist *h) {
+  atomic_store(&h->count, 0);
+  atomic_store(&h->sum, 0);
+  atomic_store(&h->max, 0);
+  for (unsigned int i = 0; i < HIST_BUCKETS; ++i) atomic_store(&h->b[i], 0);
+}
+
+static void bench_print_hist(const char *label, const hist *h) {
+  uint64_t n = atomic_load(&h->count);
+  if (n == 0) {
+    printf("%-34s no samples\n", label);
+    return;
+  }
+  printf("%-34s n=%-8llu mean=%9.2f us  p50=%9.2f us  p99=%9.2f us  max=%9.2f us\n", label,
+         (unsigned long long)n, (double)atomic_load(&h->sum) / (double)n / 1e3,
+         (double)hist_percentile(h, n, 0.50) / 1e3, (double)hist_percentile(h, n, 0.99) / 1e3,
+         (double)atomic_load(&h->max) / 1e3);
+}
+
+static void bench_sleep_ms(unsigned int ms) {
 #ifdef _WIN32
-        win_send_mouse_btn(1, 0);
+  Sleep(ms);
 #else
-        x11_mouse_btn(1, 0);
+  struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) { }
 #endif
-        rmb_is_down = 0;
-      }
-
-      msleep(20);
-      continue;
-    }
+}
 
-    //Hold W
-    if (atomic_load(&g_hold_w)) {
-      if (!w_is_down) {
+static uint64_t process_cpu_ns(void) {
 #ifdef _WIN32
-        win_send_key('W', 1);
+  FILETIME created, exited, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) return 0;
+  uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+  uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+  return (k + u) * 100ull;   //100 ns units
 #else
-        x11_key(XK_w, 1);
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
 #endif
-        w_is_down = 1;
-      }
-    } else if (w_is_down) {
+}
+
+//cost of the batching layer itself: one spam tick (move, down, up) per batch
+static void bench_inject_mock(void) {
+  const inj_backend *saved = g_inj_backend;
+  g_inj_backend = &g_inj_mock;
+  atomic_store(&g_inj_mock_events, 0);
+
+  uint64_t t0 = now_ns();
+  for (int i = 0; i < BENCH_MOCK_BATCHES; ++i) {
+    inj_batch b;
+    inj_begin(&b);
+    inj_move(&b, i & 1023, 0);
+    inj_button(&b, 0, 1);
+    inj_button(&b, 0, 0);
+    inj_send(&b);
+  }
+  uint64_t dt = now_ns() - t0;
+  unsigned long long n = atomic_load(&g_inj_mock_events);
+  printf("%-34s %12.0f events/s  %8.1f ns/event\n", "inject: mock backend",
+         (double)n * 1e9 / (double)dt, (double)dt / (double)n);
+  g_inj_backend = saved;
+}
+
+//the real worker loop with a mock backend: scheduling overhead and tick
+//lateness of a spam macro at the given rate and late policy, no display needed
+static void bench_worker_mock(const char *label, uint64_t interval_ns, int late) {
+  const inj_backend *saved = g_inj_backend;
+  g_inj_backend = &g_inj_mock;
+  atomic_store(&g_inj_mock_events, 0);
+  atomic_store(&g_inj_mock_moves, 0);
+  hist_reset(&g_hist_late);
+  rate_counters *rc = &g_rate[ACTION_SPAM_LMB];
+  uint64_t dropped0 = atomic_load(&rc->dropped), caught0 = atomic_load(&rc->caught_up);
+
+  worker_cmd c = { CMD_SET_INTERVAL, ACTION_SPAM_LMB, 0, 0, interval_ns, NULL, 0 };
+  send_worker_cmd(&c);
+  worker_cmd l = { CMD_SET_LATE, ACTION_SPAM_LMB, late, 0, 0, NULL, 0 };
+  send_worker_cmd(&l);
+  atomic_store(&g_running, 1);
+
 #ifdef _WIN32
-      win_send_key('W', 0);
+  HANDLE th = CreateThread(NULL, 0, worker_thread, NULL, 0, NULL);
+  if (!th) {
 #else
-      x11_key(XK_w, 0);
+  pthread_t th;
+  if (pthread_create(&th, NULL, worker_thread, NULL) != 0) {
 #endif
-      w_is_down = 0;
-    }
+    printf("%-34s skipped (cannot start worker)\n", label);
+    g_inj_backend = saved;
+    return;
+  }
 
-    //Hold S
-    if (atomic_load(&g_hold_s)) {
-      if (!s_is_down) {
+  uint64_t cpu0 = process_cpu_ns();
+  uint64_t t0 = now_ns();
+  state_update(0, ST_SPAM);
+  worker_wake();
+  bench_sleep_ms(BENCH_WORKER_SECS * 1000u);
+  state_update(ST_SPAM, 0);
+  atomic_store(&g_running, 0);
+  worker_wake();
 #ifdef _WIN32
-        win_send_key('S', 1);
+  WaitForSingleObject(th, INFINITE);
+  CloseHandle(th);
 #else
-        x11_key(XK_s, 1);
+  pthread_join(th, NULL);
 #endif
-        s_is_down = 1;
-      }
-    } else if (s_is_down) {
+  uint64_t dt = now_ns() - t0;
+  uint64_t cpu = process_cpu_ns() - cpu0;
+
+  //a spam tick is a press and a release, plus a move unless the pointer is still there
+  unsigned long long moves = atomic_load(&g_inj_mock_moves);
+  double ticks = (double)(atomic_load(&g_inj_mock_events) - moves) / 2.0;
+  printf("%-34s %8.1f ticks/s (target %.1f)  %8.2f us CPU/tick  %.2f moves/tick\n",
+         label, ticks * 1e9 / (double)dt, 1e9 / (double)interval_ns,
+         ticks > 0 ? (double)cpu / ticks / 1e3 : 0.0, ticks > 0 ? (double)moves / ticks : 0.0);
+  printf("%-34s %llu dropped, %llu caught up\n", "",
+         (unsigned long long)(atomic_load(&rc->dropped) - dropped0),
+         (unsigned long long)(atomic_load(&rc->caught_up) - caught0));
+  bench_print_hist("worker: tick lateness", &g_hist_late);
+  g_inj_backend = saved;
+}
+
+//sustained rate and per-event cost of a real injection path
+static void bench_inject_backend(const inj_backend *be) {
+  const inj_backend *saved = g_inj_backend;
+  g_inj_backend = be;
+  hist_reset(&g_hist_bench);
+
+  int x = 0, y = 0;
 #ifdef _WIN32
-      win_send_key('S', 0);
+  win_get_cursor(&x, &y);
 #else
-      x11_key(XK_s, 0);
+  x11_get_cursor(&x, &y);
 #endif
-      s_is_down = 0;
-    }
 
-    //Hold LMB
-    if (atomic_load(&g_hold_lmb)) {
-      if (!lmb_is_down) {
+  uint64_t t0 = now_ns();
+  for (int sent = 0; sent < BENCH_INJECT_EVENTS; sent += INJ_BATCH_MAX) {
+    inj_batch b;
+    inj_begin(&b);
+    for (int i = 0; i < INJ_BATCH_MAX; ++i) inj_move(&b, x, y);
+    uint64_t t = now_ns();
+    inj_send(&b);
+    hist_record(&g_hist_bench, (now_ns() - t) / INJ_BATCH_MAX);
+  }
+#ifndef _WIN32
+  XSync(dpy, False);   //count the server side too
+#endif
+  uint64_t dt = now_ns() - t0;
+
+  char label[64];
+  snprintf(label, sizeof(label), "inject: %s", be->name);
+  printf("%-34s %12.0f events/s\n", label, (double)BENCH_INJECT_EVENTS * 1e9 / (double)dt);
+  snprintf(label, sizeof(label), "inject: %s per event", be->name);
+  bench_print_hist(label, &g_hist_bench);
+  g_inj_backend = saved;
+}
+
+//HUD line assembly alone, cycling through every combination of the flags
+static void bench_hud_compose(void) {
+  hist_reset(&g_hist_bench);
+  for (int i = 0; i < BENCH_HUD_COMPOSES; ++i) {
+    uint32_t f = (uint32_t)(i & 0xFF) | ((i & 0x100) ? ST_UNFOCUSED : 0);
+    uint64_t t = now_ns();
+    hud_compose(f);
+    hist_record(&g_hist_bench, now_ns() - t);
+  }
+  bench_print_hist("hud: compose", &g_hist_bench);
+}
+
+static void bench_overlay(void) {
+  hist_reset(&g_hist_bench);
 #ifdef _WIN32
-        win_send_mouse_btn(0, 1);
+  if (!overlay_dib_init()) {
+    printf("%-34s skipped (cannot create DIB)\n", "overlay: render");
+    return;
+  }
+  for (int i = 0; i < BENCH_OVERLAY_FRAMES; ++i) {
+    uint64_t t = now_ns();
+    overlay_render_dib((i & 1) ? ST_SPAM : 0);
+    hist_record(&g_hist_bench, now_ns() - t);
+  }
+  overlay_dib_destroy();
+  bench_print_hist("overlay: render into DIB", &g_hist_bench);
 #else
-        x11_mouse_btn(0, 1);
+  g_overlay_font = overlay_font_load();
+  g_overlay_xft = overlay_xft_load();
+  overlay_init();   //created unmapped
+  for (int i = 0; i < BENCH_OVERLAY_FRAMES; ++i) {
+    state_update(0, ST_SPAM);
+    uint64_t t = now_ns();
+    overlay_draw();
+    XSync(dpy, False);
+    hist_record(&g_hist_bench, now_ns() - t);
+  }
+  state_update(ST_SPAM, 0);
+  bench_print_hist(g_xr_ok ? "overlay: draw (XRender, synced)" : "overlay: draw (core, synced)",
+                   &g_hist_bench);
 #endif
-        lmb_is_down = 1;
-      }
-    } else if (lmb_is_down) {
+}
+
+static void bench_discovery(void) {
+  for (int warm = 0; warm < 2; ++warm) {
+    hist_reset(&g_hist_bench);
+    for (int i = 0; i < BENCH_DISCOVERY_RUNS; ++i) {
+      if (!warm) pid_cache_clear();
+      uint64_t t = now_ns();
 #ifdef _WIN32
-      win_send_mouse_btn(0, 0);
+      HWND found = NULL;
+      find_game_windows_win(&found, 1, 0);
 #else
-      x11_mouse_btn(0, 0);
+      find_target_window(dpy);
 #endif
-      lmb_is_down = 0;
+      hist_record(&g_hist_bench, now_ns() - t);
     }
+    bench_print_hist(warm ? "discovery: warm PID cache" : "discovery: cold PID cache",
+                     &g_hist_bench);
+  }
+}
+
+//every compare kernel on a 64x64 region, half of it matching
+static void bench_watch_compare(void) {
+  static uint32_t px[64 * 64];
+  for (int i = 0; i < 64 * 64; ++i) px[i] = (i & 1) ? 0x003acf4au : 0x00102030u;
+  watch_region r;
+  memset(&r, 0, sizeof(r));
+  r.w = r.h = 64;
+  r.lo = 0x0030c540u;
+  r.hi = 0xff44d954u;
+  watch_count_fn saved = g_watch_count;
+  watch_kernel_init();
+  for (int k = 0; k < g_watch_kernel_count; ++k) {
+    g_watch_count = g_watch_kernels[k].fn;
+    unsigned int c = 0;
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BENCH_WATCH_RUNS; ++i) c += watch_count_region((const uint8_t *)px, 64 * 4, &r);
+    uint64_t dt = now_ns() - t0;
+    char label[64];
+    snprintf(label, sizeof(label), "watch: compare 64x64 (%s)", g_watch_kernels[k].name);
+    printf("%-34s %8.2f us/region  %8.2f Gpixel/s%s\n", label,
+           (double)dt / BENCH_WATCH_RUNS / 1e3, (double)BENCH_WATCH_RUNS * 4096.0 / (double)dt,
+           c == BENCH_WATCH_RUNS * 2048u ? "" : "  WRONG COUNT");
+  }
+  g_watch_count = saved;
+}
 
-    //Hold RMB
-    if (atomic_load(&g_hold_rmb)) {
-      if (!rmb_is_down) {
+//capture and compare of one 64x64 region at the top left of the screen
+static void bench_watch_capture(void) {
+  watch_set set;
+  memset(&set, 0, sizeof(set));
+  set.n = 1;
+  set.r[0].w = set.r[0].h = 64;
+  set.r[0].need = 1;
+  set.r[0].hi = 0xffffffffu;
+  watch_capture cap;
+  if (!watch_capture_open(&cap, &set)) {
+    printf("%-34s skipped (no capture)\n", "watch: capture 64x64");
+    return;
+  }
+  hist_reset(&g_hist_bench);
+  for (int i = 0; i < BENCH_WATCH_CAPTURES; ++i) {
+    uint32_t m = 0;
+    uint64_t t = now_ns();
+    if (watch_capture_scan(&cap, &set, &m) > 0) hist_record(&g_hist_bench, now_ns() - t);
+#ifdef _WIN32
+    bench_sleep_ms(1);   //duplication only delivers changed frames
+#endif
+  }
 #ifdef _WIN32
-        win_send_mouse_btn(1, 1);
+  bench_print_hist("watch: capture + compare (DXGI)", &g_hist_bench);
 #else
-        x11_mouse_btn(1, 1);
+  bench_print_hist(cap.shm ? "watch: capture + compare (XShm)" : "watch: capture + compare (XGetImage)",
+                   &g_hist_bench);
+#endif
+  watch_capture_close(&cap);
+}
+
+static int bench_main(int argc, char **argv) {
+  int mock_only = argc > 0 && strcmp(argv[0], "mock") == 0;
+
+  //benchmarks ignore the config file
+  g_cfg = calloc(1, sizeof(*g_cfg));
+  if (!g_cfg) {
+    fprintf(stderr, "Error: out of memory.\n");
+    return 1;
+  }
+  init_default_hotkeys(g_cfg);
+  g_worker_sched = g_cfg->worker;
+  keytab_init();
+  if (!macro_publish() || !worker_wake_init() || !ui_notify_init()) {
+    fprintf(stderr, "Error: failed to create worker wakeup primitive.\n");
+    return 1;
+  }
+
+  printf("foxholetool benchmarks\n");
+  bench_inject_mock();
+  bench_worker_mock("worker: mock spam", BENCH_WORKER_INTERVAL_US * 1000ull, LATE_COALESCE);
+  bench_worker_mock("worker: mock burst, catchup", 1000000000ull / BENCH_BURST_CPS, LATE_CATCHUP);
+  bench_watch_compare();
+  bench_hud_compose();
+  if (mock_only) return 0;
+
+#ifndef _WIN32
+  XInitThreads();
+  dpy = XOpenDisplay(NULL);
+  if (!dpy) {
+    printf("no X display: injection, overlay and discovery benchmarks skipped\n");
+    return 0;
+  }
+  keytab_refresh();
+#endif
+  bench_inject_backend(&g_inj_single);
+  bench_inject_backend(&g_inj_native);
+#ifndef _WIN32
+  if (inj_conn_open()) {
+    bench_inject_backend(&g_inj_xcb);
+    inj_conn_close();
+  } else {
+    printf("%-34s skipped (no XCB connection with XTEST)\n", "inject: XCB");
+  }
+  if (uinput_init()) {
+    uinput_settle();   //not part of the per-event cost
+    bench_inject_backend(&g_inj_uinput);
+    uinput_destroy();
+  } else {
+    printf("%-34s skipped (no access to /dev/uinput)\n", "inject: uinput");
+  }
 #endif
-        rmb_is_down = 1;
-      }
-    } else if (rmb_is_down) {
-#ifdef _WIN32
-      win_send_mouse_btn(1, 0);
-#else
-      x11_mouse_btn(1, 0);
+  bench_overlay();
+  bench_discovery();
+  bench_watch_capture();
+#ifndef _WIN32
+  XCloseDisplay(dpy);
 #endif
-      rmb_is_down = 0;
-    }
+  return 0;
+}
 
-    //Spam left click at saved location (every 30ms by default)
-    if (atomic_load(&g_spam_left)) {
-      uint64_t t = now_ms();
-      if (t - last_click >= 30) {
-        last_click = t;
+//---------------------- main ---------------------
+
+//the main loop's own deadline passed (ui_timer_set)
+static void ui_timer_expired(void) {
+  g_ui_deadline = WAIT_FOREVER;
+  //timers may fire a little before the deadline on Windows
+  if (g_rate_next != WAIT_FOREVER && g_rate_next <= now_ns() + 1000000ull) rate_views_refresh(1);
+  if (st_flags(state_load()) & ST_RECORDING) state_changed();
+  hud_timer_arm();
+  overlay_draw();
+}
 
-        int x = atomic_load(&g_saved_x);
-        int y = atomic_load(&g_saved_y);
+//--------------- multibox targets ---------------
+//with Multibox=yes the main thread keeps the list of game windows current
+//and hands every new list to the worker (CMD_TARGETS_SET), which delivers
+//to all of them (see targeted delivery). the HUD and PauseUnfocused keep
+//following the first game window, as without Multibox.
 
+static int g_multibox = 0;                 //targeted delivery in use
+static target_set *g_targets_pub = NULL;   //last set handed to the worker, main thread
 #ifdef _WIN32
-        //move -> click -> (optional) move back not needed
-        win_move_mouse_abs(x, y);
-        win_send_mouse_btn(0, 1);
-        win_send_mouse_btn(0, 0);
-#else
-        x11_move_mouse(x, y);
-        x11_mouse_btn(0, 1);
-        x11_mouse_btn(0, 0);
+static HWINEVENTHOOK g_hook_multibox = NULL;
 #endif
-      }
-    }
 
-    msleep(1);
+//pick the targeted backend; before the worker starts
+static void multibox_init(int headless) {
+  if (headless) {
+    fprintf(stderr, "Warning: %s needs the game window search, ignored with --headless\n",
+            CONFIG_MULTIBOX);
+    return;
+  }
+#ifndef _WIN32
+  if (!g_inj_conn) {
+    fprintf(stderr, "Warning: %s needs the injection connection, ignored\n", CONFIG_MULTIBOX);
+    return;
+  }
+  if (g_cfg->uinput) fprintf(stderr, "Warning: %s=uinput is not used with %s\n",
+                             CONFIG_INJECTOR, CONFIG_MULTIBOX);
+#endif
+  g_multibox = 1;
+  g_inj_backend = &g_inj_target;
+}
+
+static int multibox_index(const target_set *t, uintptr_t w) {
+  for (int i = 0; t && i < t->n; ++i) {
+    if ((uintptr_t)t->win[i] == w) return i;
   }
+  return -1;
+}
 
-  //make sure everything is released
-  set_all_up();
+#ifndef _WIN32
+//root coordinates of target i (two round trips); a window that is gone gets size 0
+static void multibox_geometry(target_set *t, int i) {
+  Window child, groot;
+  int x = 0, y = 0, gx, gy;
+  unsigned int w = 0, h = 0, bw, depth;
+  if (!XTranslateCoordinates(dpy, t->win[i], DefaultRootWindow(dpy), 0, 0, &x, &y, &child) ||
+      !XGetGeometry(dpy, t->win[i], &groot, &gx, &gy, &w, &h, &bw, &depth))
+    w = h = 0;
+  atomic_store_explicit(&t->x[i], x, memory_order_relaxed);
+  atomic_store_explicit(&t->y[i], y, memory_order_relaxed);
+  atomic_store_explicit(&t->w[i], (int)w, memory_order_relaxed);
+  atomic_store_explicit(&t->h[i], (int)h, memory_order_relaxed);
+}
+#endif
 
+//search every game window again and hand the worker a new list if it changed
+static void multibox_refresh(void) {
+  if (!g_multibox) return;
 #ifdef _WIN32
-  return 0;
+  HWND found[TARGETS_MAX];
+  int n = find_game_windows_win(found, TARGETS_MAX, 1);
 #else
-  return NULL;
+  //the startup thread owns the PID cache; startup_poll refreshes afterwards
+  if (g_target_search_busy) return;
+  Window found[TARGETS_MAX];
+  int n = find_target_windows(dpy, found, TARGETS_MAX);
 #endif
-}
+  if (g_targets_pub && g_targets_pub->n == n &&
+      memcmp(g_targets_pub->win, found, sizeof(found[0]) * (size_t)n) == 0)
+    return;
 
-//--------------- hotkey handling -----------------
-static void toggle_with_log(const char* name, atomic_int* flag) {
-  int v = atomic_load(flag);
-  v = !v;
-  atomic_store(flag, v);
-  printf("%s: %s\n", name, v ? "ON" : "OFF");
+  target_set *t = calloc(1, sizeof(*t));
+  if (!t) return;
+  t->n = n;
+  memcpy(t->win, found, sizeof(found[0]) * (size_t)n);
+#ifndef _WIN32
+  for (int i = 0; i < n; ++i) {
+    //moves keep the geometry current; a FocusChangeMask the first window needs stays
+    XSelectInput(dpy, t->win[i], StructureNotifyMask |
+                                 (g_atom_active_window == None ? FocusChangeMask : 0));
+    multibox_geometry(t, i);
+  }
+#endif
+  worker_cmd c = { CMD_TARGETS_SET, 0, 0, 0, 0, t, sizeof(*t) };
+  send_worker_cmd(&c);
+  g_targets_pub = t;   //the worker frees the one it replaces
+  printf("Multibox: %d game window%s\n", n, n == 1 ? "" : "s");
   fflush(stdout);
-
-  overlay_draw();
 }
 
-static void save_cursor_pos(void) {
-  int x = 0, y = 0;
 #ifdef _WIN32
-  win_get_cursor(&x, &y);
+//a game window closed or was hidden, or a new one was shown
+static void CALLBACK multibox_event_proc(HWINEVENTHOOK hook, DWORD event, HWND hwnd,
+                                         LONG idObject, LONG idChild,
+                                         DWORD thread, DWORD time) {
+  (void)hook; (void)thread; (void)time;
+  if (!hwnd || idObject != OBJID_WINDOW || idChild != CHILDID_SELF) return;
+  int known = multibox_index(g_targets_pub, (uintptr_t)hwnd) >= 0;
+  if ((event == EVENT_OBJECT_DESTROY || event == EVENT_OBJECT_HIDE) && known) multibox_refresh();
+  else if (event == EVENT_OBJECT_SHOW && !known && GetAncestor(hwnd, GA_ROOT) == hwnd &&
+           !GetWindow(hwnd, GW_OWNER) && window_is_foxhole(hwnd))
+    multibox_refresh();
+}
+
+//first list and the window hooks, once the startup search is done
+static void multibox_start(void) {
+  if (!g_multibox) return;
+  multibox_refresh();
+  g_hook_multibox = SetWinEventHook(EVENT_OBJECT_DESTROY, EVENT_OBJECT_HIDE,
+                                    NULL, multibox_event_proc, 0, 0,
+                                    WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+}
+
+static void multibox_stop(void) {
+  if (g_hook_multibox) UnhookWinEvent(g_hook_multibox);
+  g_hook_multibox = NULL;
+}
 #else
-  x11_get_cursor(&x, &y);
-#endif
-  atomic_store(&g_saved_x, x);
-  atomic_store(&g_saved_y, y);
-  printf("Saved cursor position: (%d, %d)\n", x, y);
-  fflush(stdout);
+static void multibox_start(void) {
+  multibox_refresh();
 }
 
-static void handle_action(int action) {
-  switch (action) {
-    case ACTION_SPAM_LMB:
-      if (!atomic_load(&g_suspended)) save_cursor_pos();
-      toggle_with_log("Spam LMB", &g_spam_left);
-      break;
-    case ACTION_HOLD_W:
-      toggle_with_log("Hold W", &g_hold_w);
-      break;
-    case ACTION_HOLD_S:
-      toggle_with_log("Hold S", &g_hold_s);
+//root and target events that change the list or a window's place
+static void multibox_handle_event(const XEvent *ev) {
+  if (!g_multibox) return;
+  Window root = DefaultRootWindow(dpy);
+  int i;
+  switch (ev->type) {
+    case ConfigureNotify:
+      i = multibox_index(g_targets_pub, (uintptr_t)ev->xconfigure.window);
+      if (i >= 0) multibox_geometry(g_targets_pub, i);
       break;
-    case ACTION_HOLD_RMB:
-      toggle_with_log("Hold RMB", &g_hold_rmb);
+    case DestroyNotify:
+      if (multibox_index(g_targets_pub, (uintptr_t)ev->xdestroywindow.window) >= 0)
+        multibox_refresh();
       break;
-    case ACTION_HOLD_LMB:
-      toggle_with_log("Hold LMB", &g_hold_lmb);
+    case PropertyNotify:
+      if (ev->xproperty.window == root && ev->xproperty.atom == g_atom_client_list)
+        multibox_refresh();
       break;
-    case ACTION_SUSPEND: {
-      int s = atomic_load(&g_suspended);
-      s = !s;
-      atomic_store(&g_suspended, s);
-      printf("Suspended: %s\n", s ? "YES" : "NO");
-      fflush(stdout);
-      overlay_draw();
-    } break;
-    case ACTION_EXIT:
-      atomic_store(&g_running, 0);
+    case MapNotify:
+      if (ev->xmap.event == root) multibox_refresh();
       break;
     default:
       break;
   }
 }
+#endif
 
+//--------------- deferred startup ---------------
+//hotkeys and the worker come up first. the slow part of bringing up the
+//HUD (font lookup, the game window search, each a chain of round trips or
+//an OpenProcess per window) runs on a startup thread while the main loop
+//already serves hotkeys; the thread only fills g_startup and wakes the
+//main loop, which then creates the overlay and starts tracking the game.
+//until then the main thread leaves the overlay and the PID cache alone.
+
+typedef struct {
+  uint64_t t0;          //main() entered
+  uint64_t t_live;      //hotkeys registered and worker running
+  uint64_t font_ns;     //startup thread: font lookup
+  uint64_t lookup_ns;   //startup thread: game window search
+  uint64_t t_ready;     //overlay created, game tracked
 #ifdef _WIN32
+  HFONT font;
+  HWND game;
+#else
+  XFontStruct *font;
+  XftFont *xft;
+  Window game;
+#endif
+} startup_info;
 
-//internal IDs for Windows global hotkeys
-enum {
-  HK_ID_BASE = 1  //base ID offset
-};
-
-//simple overlay window above the "War"/Foxhole game window
-
-static LRESULT CALLBACK overlay_wnd_proc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
-  switch (msg) {
-    case WM_PAINT: {
-      PAINTSTRUCT ps;
-      HDC hdc = BeginPaint(hwnd, &ps);
-
-      //use "Renner" font for overlay text if available
-      if (g_overlay_font) {
-        SelectObject(hdc, g_overlay_font);
-      }
-
-      RECT rc;
-      GetClientRect(hwnd, &rc);
-
-      HBRUSH bg = CreateSolidBrush(RGB(0, 0, 0));
-      FillRect(hdc, &rc, bg);
-      DeleteObject(bg);
-
-      SetBkMode(hdc, TRANSPARENT);
-      SetTextColor(hdc, RGB(255, 255, 255));
-
-      char buf[512];
-      build_overlay_text(buf, sizeof(buf));
-
-      char active[128];
-      active[0] = '\0';
-      if (atomic_load(&g_spam_left)) strcat(active, " Spam");
-      if (atomic_load(&g_hold_w))   strcat(active, " W");
-      if (atomic_load(&g_hold_s))   strcat(active, " S");
-      if (atomic_load(&g_hold_rmb)) strcat(active, " RMB");
-      if (atomic_load(&g_hold_lmb)) strcat(active, " LMB");
-      if (atomic_load(&g_suspended))strcat(active, " [SUSP]");
-
-      if (active[0] != '\0') {
-        strncat(buf, " | Active:", sizeof(buf) - strlen(buf) - 1);
-        strncat(buf, active, sizeof(buf) - strlen(buf) - 1);
-      }
+static startup_info g_startup;
+static atomic_int g_startup_done = 0;   //set by the startup thread when g_startup is filled
+static int g_startup_pending = 0;       //main thread: thread started, results not taken yet
+#ifdef _WIN32
+static HANDLE g_startup_thread = NULL;
+#else
+static pthread_t g_startup_thread;
+static int g_startup_joinable = 0;
+#endif
 
-      DrawTextA(hdc, buf, -1, &rc, DT_LEFT | DT_VCENTER | DT_SINGLELINE);
-      EndPaint(hwnd, &ps);
-      return 0;
-    }
-    default:
-      break;
-  }
-  return DefWindowProc(hwnd, msg, wParam, lParam);
+static double startup_ms(uint64_t ns) {
+  return (double)ns / 1e6;
 }
 
-static BOOL CALLBACK find_foxhole_window_proc(HWND hwnd, LPARAM lParam) {
-  HWND *out = (HWND *)lParam;
-  if (*out) return FALSE;
-
-  DWORD pid = 0;
-  GetWindowThreadProcessId(hwnd, &pid);
-  if (pid) {
-    HANDLE hProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
-    if (hProc) {
-      char path[MAX_PATH];
-      DWORD size = sizeof(path);
-      BOOL ok = QueryFullProcessImageNameA(hProc, 0, path, &size);
-      CloseHandle(hProc);
-
-      if (ok && strcasestr_simple(path, "foxhole")) {
-        *out = hwnd;
-        return FALSE;
-      }
-    }
-  }
-
-  //fallback: if path has no "foxhole", try window title ("War" or containing "foxhole")
-  char title[256];
-  if (GetWindowTextA(hwnd, title, sizeof(title)) > 0) {
-    if (_stricmp(title, "War") == 0 || strcasestr_simple(title, "foxhole")) {
-      *out = hwnd;
-      return FALSE;
-    }
-  }
-
-  return TRUE;
+static void startup_run(void) {
+  uint64_t t = now_ns();
+#ifdef _WIN32
+  g_startup.font = overlay_font_create_win();
+#else
+  g_startup.font = overlay_font_load();
+  g_startup.xft = overlay_xft_load();
+#endif
+  uint64_t t_font = now_ns();
+  trace_span("font_load", t, NULL, 0);
+  g_startup.font_ns = t_font - t;
+#ifdef _WIN32
+  g_startup.game = find_game_window_win();
+#else
+  g_startup.game = find_target_window(dpy);
+#endif
+  g_startup.lookup_ns = now_ns() - t_font;
+  atomic_store_explicit(&g_startup_done, 1, memory_order_release);
 }
 
-static void overlay_init_win(void) {
-  HINSTANCE hInst = GetModuleHandle(NULL);
-
-  WNDCLASSEXA wc;
-  ZeroMemory(&wc, sizeof(wc));
-  wc.cbSize = sizeof(wc);
-  wc.lpfnWndProc = overlay_wnd_proc;
-  wc.hInstance = hInst;
-  wc.lpszClassName = "ClickerOverlayClass";
-  wc.hCursor = LoadCursor(NULL, IDC_ARROW);
-
-  RegisterClassExA(&wc);
+#ifdef _WIN32
+static DWORD WINAPI startup_thread(LPVOID unused)
+#else
+static void *startup_thread(void *unused)
+#endif
+{
+  (void)unused;
+  trace_thread("startup");
+  startup_run();
+  ui_notify();
+#ifdef _WIN32
+  return 0;
+#else
+  return NULL;
+#endif
+}
 
-  //create "Renner" font if installed; GDI will fall back to something else if not
-  if (!g_overlay_font) {
-    g_overlay_font = CreateFontA(
-        -16, 0, 0, 0,
-        FW_NORMAL,
-        FALSE, FALSE, FALSE,
-        DEFAULT_CHARSET,
-        OUT_DEFAULT_PRECIS,
-        CLIP_DEFAULT_PRECIS,
-        CLEARTYPE_QUALITY,
-        DEFAULT_PITCH | FF_DONTCARE,
-        "Renner");
-  }
-
-  g_war_hwnd = NULL;
-  EnumWindows(find_foxhole_window_proc, (LPARAM)&g_war_hwnd);
-
-  //if we do not find the game window, we do not show the overlay
-  if (!g_war_hwnd) {
+//hotkeys are live: report it and hand the HUD to the startup thread
+static void startup_begin(int with_hud) {
+  g_startup.t_live = now_ns();
+  if (!with_hud) {
+    printf("Startup: hotkeys live after %.2f ms\n", startup_ms(g_startup.t_live - g_startup.t0));
+    fflush(stdout);
     return;
   }
-
-  g_overlay_hwnd = CreateWindowExA(
-      WS_EX_TOPMOST | WS_EX_LAYERED | WS_EX_TRANSPARENT | WS_EX_TOOLWINDOW,
-      "ClickerOverlayClass",
-      "",
-      WS_POPUP,
-      0, 0, (int)OVERLAY_WIDTH_FULL, (int)OVERLAY_HEIGHT,
-      NULL, NULL, hInst, NULL);
-
-  if (!g_overlay_hwnd) {
+  g_startup_pending = 1;
+#ifdef _WIN32
+  g_startup_thread = CreateThread(NULL, 0, startup_thread, NULL, 0, NULL);
+  if (g_startup_thread) return;
+#else
+  g_target_search_busy = 1;
+  if (pthread_create(&g_startup_thread, NULL, startup_thread, NULL) == 0) {
+    g_startup_joinable = 1;
     return;
   }
-
-  //make the window text‑only: black is treated as transparent, white text is visible
-  SetLayeredWindowAttributes(g_overlay_hwnd, RGB(0,0,0), (BYTE)255, LWA_COLORKEY | LWA_ALPHA);
-
-  //position and size overlay over the game window
-  overlay_reposition_win();
-
-  ShowWindow(g_overlay_hwnd, SW_SHOWNOACTIVATE);
-  UpdateWindow(g_overlay_hwnd);
-}
-
-static int register_hotkeys_win(void) {
-  const int keys[] = {
-    VK_F2, VK_F3, VK_F4, VK_F6, VK_F7, VK_F9, VK_F10, VK_HIDE_OVERLAY
-  };
-  int count = (int)(sizeof(keys) / sizeof(keys[0]));
-  for (int i = 0; i < count; ++i) {
-    if (!RegisterHotKey(NULL, HK_ID_BASE + i, MOD_NOREPEAT, keys[i]))
-      return 0;
-  }
-  return 1;
-}
-
-static void unregister_hotkeys_win(void) {
-  const int keys[] = {
-    VK_F2, VK_F3, VK_F4, VK_F6, VK_F7, VK_F9, VK_F10, VK_HIDE_OVERLAY
-  };
-  int count = (int)(sizeof(keys) / sizeof(keys[0]));
-  for (int i = 0; i < count; ++i) {
-    UnregisterHotKey(NULL, HK_ID_BASE + i);
-  }
+#endif
+  //no thread: do it here, the main loop picks it up on its first pass
+  fprintf(stderr, "Warning: cannot start the startup thread, setting up the HUD first\n");
+  startup_run();
+  ui_notify();
 }
 
+static void startup_join(void) {
+#ifdef _WIN32
+  if (!g_startup_thread) return;
+  WaitForSingleObject(g_startup_thread, INFINITE);
+  CloseHandle(g_startup_thread);
+  g_startup_thread = NULL;
 #else
-
-//helpers to register global hotkeys on Linux/X11
-static void grab_key(Display* d, int keysym) {
-  Window root = DefaultRootWindow(d);
-  KeyCode kc = XKeysymToKeycode(d, (KeySym)keysym);
-  if (kc == 0) return;
-
-  //grab with common modifier combinations (NumLock/CapsLock)
-  unsigned int mods[] = {0, LockMask, Mod2Mask, LockMask | Mod2Mask};
-  for (size_t i = 0; i < sizeof(mods)/sizeof(mods[0]); i++) {
-    XGrabKey(d, kc, mods[i], root, True, GrabModeAsync, GrabModeAsync);
-  }
+  if (!g_startup_joinable) return;
+  pthread_join(g_startup_thread, NULL);
+  g_startup_joinable = 0;
+#endif
 }
 
-static void ungrab_key(Display* d, int keysym) {
-  Window root = DefaultRootWindow(d);
-  KeyCode kc = XKeysymToKeycode(d, (KeySym)keysym);
-  if (kc == 0) return;
+//main loop wakeup: take the startup thread's results once they are in
+static void startup_poll(void) {
+  if (!g_startup_pending || !atomic_load_explicit(&g_startup_done, memory_order_acquire)) return;
+  startup_join();
+  g_startup_pending = 0;
 
-  unsigned int mods[] = {0, LockMask, Mod2Mask, LockMask | Mod2Mask};
-  for (size_t i = 0; i < sizeof(mods)/sizeof(mods[0]); i++) {
-    XUngrabKey(d, kc, mods[i], root);
+#ifdef _WIN32
+  overlay_init_win(g_startup.font, g_startup.game);
+#else
+  g_target_search_busy = 0;
+  g_overlay_font = g_startup.font;
+  g_overlay_xft = g_startup.xft;
+  overlay_init();
+  target_track(g_startup.game);
+  //the client list changed during the search: look once more
+  if (!g_foxhole_win && g_target_search_missed) target_track(find_target_window(dpy));
+  g_target_search_missed = 0;
+  if (g_foxhole_win) {
+    overlay_position_on_window();
+    if (!atomic_load(&g_overlay_hidden)) XMapRaised(dpy, g_overlay_win);
   }
-}
+#endif
+  multibox_start();
+  g_startup.t_ready = now_ns();
 
-static int register_hotkeys_x11(void) {
-  if (!dpy) return 0;
-  grab_key(dpy, XK_F2);
-  grab_key(dpy, XK_F3);
-  grab_key(dpy, XK_F4);
-  grab_key(dpy, XK_F6);
-  grab_key(dpy, XK_F7);
-//extra key: hide overlay
-  grab_key(dpy, KS_HIDE_OVERLAY);
-  grab_key(dpy, XK_F9);
-  grab_key(dpy, XK_F10);
-
-  XSelectInput(dpy, DefaultRootWindow(dpy), KeyPressMask);
-  XFlush(dpy);
-  return 1;
+  printf("Startup: hotkeys live after %.2f ms, HUD after %.2f ms "
+         "(font %.2f ms, game lookup %.2f ms in the background)\n",
+         startup_ms(g_startup.t_live - g_startup.t0), startup_ms(g_startup.t_ready - g_startup.t0),
+         startup_ms(g_startup.font_ns), startup_ms(g_startup.lookup_ns));
+  fflush(stdout);
 }
 
-static void unregister_hotkeys_x11(void) {
-  if (!dpy) return;
-  ungrab_key(dpy, XK_F2);
-  ungrab_key(dpy, XK_F3);
-  ungrab_key(dpy, XK_F4);
-  ungrab_key(dpy, XK_F6);
-  ungrab_key(dpy, XK_F7);
-  ungrab_key(dpy, KS_HIDE_OVERLAY);
-  ungrab_key(dpy, XK_F9);
-  ungrab_key(dpy, XK_F10);
-  XFlush(dpy);
+//exit before the startup thread reported back: it still uses the display
+static void startup_abandon(void) {
+  if (!g_startup_pending) return;
+  startup_join();
+  g_startup_pending = 0;
+#ifdef _WIN32
+  if (g_startup.font) DeleteObject(g_startup.font);
+#else
+  g_target_search_busy = 0;
+  if (g_startup.font) XFreeFont(dpy, g_startup.font);
+  if (g_startup.xft) XftFontClose(dpy, g_startup.xft);
+#endif
 }
 
-#endif
+int main(int argc, char **argv) {
+  time_init();
+  g_startup.t0 = now_ns();
+  g_inj_backend = &g_inj_native;
+
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    return bench_main(argc - 2, argv + 2);
+  if (argc > 1 && strcmp(argv[1], "--ctl") == 0)
+    return ctl_client_main(argc - 2, argv + 2);
+
+  //--headless: no HUD and no game window lookup, driven by hotkeys and the
+  //control channel; --listen: the control channel next to the HUD;
+  //--trace: timeline written to TRACE_FILE on exit
+  int headless = 0, listen_ctl = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--headless") == 0) headless = listen_ctl = 1;
+    else if (strcmp(argv[i], "--listen") == 0) listen_ctl = 1;
+    else if (strcmp(argv[i], "--trace") == 0) trace_start();
+    else {
+      fprintf(stderr, "Error: unknown option '%s' (--headless, --listen, --trace, --ctl, --bench)\n",
+              argv[i]);
+      return 2;
+    }
+  }
 
-//---------------------- main ---------------------
-int main(void) {
   //init and load the hotkey settings
-  init_default_hotkeys();
-  load_hotkey_config();
-
-  printf("Cross-platform AutoClicker (C)\n");
-  char help[512];
-  build_overlay_text(help, sizeof(help));
-  printf("%s\n", help);
-  printf("(F11: hide/show overlay)\n");
-  fflush(stdout);
+  g_cfg = config_load();
+  if (!g_cfg) {
+    fprintf(stderr, "Error: out of memory.\n");
+    return 1;
+  }
+  config_bind_names();
+  g_worker_sched = g_cfg->worker;
+  if (headless) {
+    //without window tracking the game counts as focused
+    if (g_cfg->pause_unfocused)
+      fprintf(stderr, "Warning: %s has no effect with --headless\n", CONFIG_PAUSE_UNFOCUSED);
+    g_game_focused = 1;
+  }
 
 #ifndef _WIN32
-  //init Xlib in thread-safe mode (needed for redraw loop)
+  //init Xlib in thread-safe mode: the record thread has its own display,
+  //but the Xlib injection fallback shares this one with the worker
   XInitThreads();
   dpy = XOpenDisplay(NULL);
   if (!dpy) {
     fprintf(stderr, "Error: cannot open X display. Are you on X11/Xorg?\n");
     return 1;
   }
+#else
+  keytab_check_layout();
+#endif
+  //key slots resolve against the display/layout, macros refer to slots
+  keytab_init();
+  if (!macro_publish()) {
+    fprintf(stderr, "Error: out of memory.\n");
+    return 1;
+  }
+
+  printf("Cross-platform AutoClicker (C)\n");
+  hud_span help = hud_legend();
+  printf("%.*s\n", (int)help.len, help.s);
+  printf("(F11: hide/show overlay)\n");
+  fflush(stdout);
+
+  if (!worker_wake_init() || !ui_notify_init()) {
+    fprintf(stderr, "Error: failed to create worker wakeup primitive.\n");
+    return 1;
+  }
+  send_config_to_worker();
+
+#ifndef _WIN32
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = stats_signal_handler;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGUSR1, &sa, NULL);
+#endif
+
+  //injection backend, fixed before the worker starts
+#ifdef _WIN32
+  if (g_cfg->uinput) fprintf(stderr, "Warning: Injector=uinput is Linux only\n");
+#else
+  //the worker's own connection: XTest injection and pointer queries
+  if (inj_conn_open()) g_inj_backend = &g_inj_xcb;
+  else fprintf(stderr, "Warning: cannot open an injection connection, sharing the main one\n");
+  if (g_cfg->uinput && !g_cfg->multibox) {
+    if (uinput_init()) g_inj_backend = &g_inj_uinput;
+    else fprintf(stderr, "Warning: falling back to XTest injection\n");
+  }
 #endif
+  if (g_cfg->multibox) multibox_init(headless);
+  printf("Injection: %s\n", g_inj_backend->name);
+  fflush(stdout);
 
 #ifdef _WIN32
   if (!register_hotkeys_win()) {
@@ -1260,50 +7646,86 @@ int main(void) {
     return 1;
   }
 
-  overlay_init_win();
+  if (headless) display_watch_init_win();
+  startup_begin(!headless);
+  if (listen_ctl) ctl_listen_start();
+  config_watch_start();
+  screen_watch_configure();
 
   MSG msg;
-  while (atomic_load(&g_running) && GetMessage(&msg, NULL, 0, 0)) {
+  while (atomic_load(&g_running)) {
+    //block until a message arrives, a control request comes in or, only
+    //while one is set, the deadline passes
+    if (!PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+      HANDLE waits[2];
+      DWORD n = 0, w_timer = MAXDWORD, w_ctl = MAXDWORD;
+      if (g_ui_deadline != WAIT_FOREVER) { w_timer = n; waits[n++] = g_ui_timer; }
+      if (ctl_wait_handle()) { w_ctl = n; waits[n++] = ctl_wait_handle(); }
+      DWORD r = MsgWaitForMultipleObjectsEx(n, waits, INFINITE, QS_ALLINPUT,
+                                            MWMO_INPUTAVAILABLE);
+      if (r == WAIT_OBJECT_0 + w_timer) ui_timer_expired();
+      else if (r == WAIT_OBJECT_0 + w_ctl) ctl_pipe_event();
+      continue;
+    }
+    if (msg.message == WM_QUIT) break;
+    //a macro finished on the worker side, the config changed or a watched
+    //region started matching
+    if (msg.message == WM_APP_STATE && msg.hwnd == NULL) {
+      startup_poll();
+      config_apply_pending();
+      screen_watch_poll();
+      overlay_draw();
+      continue;
+    }
     if (msg.message == WM_HOTKEY) {
-      UINT vk = HIWORD(msg.lParam);
+      uint64_t t_recv = now_ns();
+      //lParam carries the VK and the MOD_* flags the table is indexed by
+      int action = hotkey_lookup(HIWORD(msg.lParam), (int)LOWORD(msg.lParam));
+      keytab_check_layout();
 
       //F11 toggles overlay visibility
-      if (vk == VK_HIDE_OVERLAY) {
+      if (action == HOTKEY_HIDE) {
         int hidden = atomic_load(&g_overlay_hidden);
         hidden = !hidden;
         atomic_store(&g_overlay_hidden, hidden);
         printf("Overlay: %s\n", hidden ? "hidden" : "shown");
         fflush(stdout);
         if (g_overlay_hwnd) {
-          ShowWindow(g_overlay_hwnd, hidden ? SW_HIDE : SW_SHOWNOACTIVATE);
+          ShowWindow(g_overlay_hwnd, (hidden || !g_war_hwnd) ? SW_HIDE : SW_SHOWNOACTIVATE);
+          //state may have changed while hidden
+          if (!hidden) overlay_draw();
         }
         continue;
       }
 
-      //find action bound to this virtual-key
-      int action = -1;
-      for (int i = 0; i < ACTION_COUNT; ++i) {
-        if (g_action_keys[i] == (int)vk) {
-          action = i;
-          break;
-        }
-      }
       if (action < 0) {
         //key not handled
         continue;
       }
 
       //normal mode: handle action
+      stats_hotkey(t_recv);
       handle_action(action);
     }
     TranslateMessage(&msg);
     DispatchMessage(&msg);
   }
 
+  //keep a recording that is still running
+  if (st_flags(state_load()) & ST_RECORDING) record_toggle();
+  config_watch_stop();
+  screen_watch_stop();
+  startup_abandon();
+
   atomic_store(&g_running, 0);
+  worker_wake();
   WaitForSingleObject(th, INFINITE);
   CloseHandle(th);
   unregister_hotkeys_win();
+  target_unhook_win();
+  multibox_stop();
+  overlay_dib_destroy();
+  ctl_listen_stop();
 
 #else
   if (!register_hotkeys_x11()) {
@@ -1312,12 +7734,14 @@ int main(void) {
     return 1;
   }
 
-  //Setup overlay over the War/Foxhole window (if found)
-  g_foxhole_win = find_target_window(dpy);
-
-  overlay_init();
-  if (g_foxhole_win) {
-    overlay_position_on_window();
+  if (headless) {
+    //hotkeys and screen size changes only
+    g_root_event_mask = KeyPressMask | StructureNotifyMask;
+    root_select_input();
+  } else {
+    //game window events from the start; the overlay over the War/Foxhole
+    //window follows once the startup thread is done
+    target_watch_init();
   }
 
   pthread_t th;
@@ -1327,36 +7751,78 @@ int main(void) {
     XCloseDisplay(dpy);
     return 1;
   }
-
-  int xfd = ConnectionNumber(dpy);
+  startup_begin(!headless);
+  if (listen_ctl) ctl_listen_start();
+  config_watch_start();
+  screen_watch_configure();
+
+  //X connection, wakeups from other threads, the main-loop deadline, then
+  //the control socket and its clients
+  struct pollfd pfd[3 + CTL_POLL_FDS] = {
+    { ConnectionNumber(dpy), POLLIN, 0 },
+    { g_ui_fd, POLLIN, 0 },
+    { g_ui_timer_fd, POLLIN, 0 },
+  };
 
   while (atomic_load(&g_running)) {
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(xfd, &fds);
-    struct timeval tv;
-    //faster redraw when overlay is visible or actions are active
-    int wants_fast =
-        !atomic_load(&g_overlay_hidden) ||
-        atomic_load(&g_spam_left) ||
-        atomic_load(&g_hold_w) ||
-        atomic_load(&g_hold_s) ||
-        atomic_load(&g_hold_lmb) ||
-        atomic_load(&g_hold_rmb);
-    tv.tv_sec = 0;
-    tv.tv_usec = wants_fast ? 33000 : 100000; //~30ms or 100ms
-
-    int ret = select(xfd + 1, &fds, NULL, NULL, &tv);
-    if (ret > 0 && FD_ISSET(xfd, &fds)) {
+    //replies read for other requests can leave events queued in Xlib with
+    //nothing left on the socket: only block when the queue is empty.
+    //XPending also flushes requests still in the output buffer
+    int queued = XPending(dpy);
+    ctl_poll_fill(&pfd[3]);
+    //no timeout: idle means asleep until something happens
+    if (poll(pfd, 3 + CTL_POLL_FDS, queued ? 0 : -1) < 0) {
+      if (errno != EINTR) break;
+      continue;
+    }
+    ctl_poll_handle(&pfd[3]);
+    if (pfd[2].revents & POLLIN) {
+      uint64_t n;
+      if (read(g_ui_timer_fd, &n, sizeof(n)) < 0) { }
+      ui_timer_expired();
+    }
+    if (pfd[1].revents & POLLIN) {
+      //a macro finished on the worker side, the config changed, a watched
+      //region started matching, or SIGUSR1 asked for stats
+      ui_notify_drain();
+      startup_poll();
+      config_apply_pending();
+      screen_watch_poll();
+      if (g_stats_requested) {
+        g_stats_requested = 0;
+        stats_dump(stdout);
+      }
+      overlay_draw();
+    }
+    if (queued || (pfd[0].revents & POLLIN)) {
       while (XPending(dpy)) {
         XEvent ev;
         XNextEvent(dpy, &ev);
+        multibox_handle_event(&ev);
         if (ev.type == Expose && ev.xexpose.window == g_overlay_win) {
-          overlay_draw();
+          if (ev.xexpose.count == 0) overlay_paint();
+        } else if (ev.type == ConfigureNotify && ev.xconfigure.window == g_overlay_win) {
+          overlay_configured(&ev.xconfigure);
+        } else if (ev.type == ConfigureNotify &&
+                   ev.xconfigure.window == DefaultRootWindow(dpy)) {
+          //monitors added, removed or resized
+          x11_screen_changed(ev.xconfigure.width, ev.xconfigure.height);
+        } else if (target_handle_event(&ev)) {
+          //game window moved, closed or came back
+        } else if (ev.type == MappingNotify) {
+          //keyboard mapping changed: drop grabs on the old keycodes,
+          //re-resolve the key table and grab again
+          XRefreshKeyboardMapping(&ev.xmapping);
+          if (ev.xmapping.request != MappingPointer) {
+            unregister_hotkeys_x11();
+            keytab_refresh();
+            register_hotkeys_x11();
+          }
         } else if (ev.type == KeyPress) {
-          KeySym ks = XLookupKeysym(&ev.xkey, 0);
+          uint64_t t_recv = now_ns();
+          int action = hotkey_lookup(ev.xkey.keycode, hk_from_xmods(ev.xkey.state));
           //F11 toggles overlay visibility
-          if (ks == KS_HIDE_OVERLAY) {
+          if (action == HOTKEY_HIDE) {
             int hidden = atomic_load(&g_overlay_hidden);
             hidden = !hidden;
             atomic_store(&g_overlay_hidden, hidden);
@@ -1376,33 +7842,37 @@ int main(void) {
             continue;
           }
 
-          //find action bound to this KeySym
-          int action = -1;
-          for (int i = 0;  i < ACTION_COUNT; ++i) {
-            if (g_action_keys[i] == (int)ks) {
-              action = i;
-              break;
-            }
-          }
           if (action < 0) {
             continue;
           }
 
+          stats_hotkey(t_recv);
           handle_action(action);
         }
       }
-    } else if (ret == 0) {
-      //timeout: periodic redraw if overlay is visible
-      overlay_draw();
     }
   }
 
+  //keep a recording that is still running
+  if (st_flags(state_load()) & ST_RECORDING) record_toggle();
+  config_watch_stop();
+  screen_watch_stop();
+  startup_abandon();
+  ctl_listen_stop();
+
   atomic_store(&g_running, 0);
+  worker_wake();
   pthread_join(th, NULL);
+  uinput_destroy();
+  inj_conn_close();
   unregister_hotkeys_x11();
   XCloseDisplay(dpy);
 #endif
 
+  ui_notify_destroy();
+  worker_wake_destroy();
+  if (stats_write_file()) printf("Latency statistics written to %s\n", STATS_FILE);
+  if (trace_write_file()) printf("Trace written to %s\n", TRACE_FILE);
   printf("Bye.\n");
   return 0;
 }